@@ -0,0 +1,105 @@
+// BenchmarkStats.h
+// Timing and statistics helpers shared by the CPU benchmarks.
+#ifndef BENCHMARK_STATS_H
+#define BENCHMARK_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils.h" // TimeMilliseconds
+
+struct BenchmarkStats
+{
+	double min = 0.0;
+	double median = 0.0;
+	double mean = 0.0;
+	double stddev = 0.0;
+	double p95 = 0.0;
+	double max = 0.0;
+	int repetitions = 0;
+};
+
+inline BenchmarkStats CalculateStats(std::vector<double> samples)
+{
+	BenchmarkStats stats;
+	if (samples.empty()) {
+		return stats;
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t count = samples.size();
+	stats.repetitions = (int)count;
+	stats.min = samples.front();
+	stats.max = samples.back();
+	stats.median = count % 2 == 1 ? samples[count / 2] : 0.5 * (samples[count / 2 - 1] + samples[count / 2]);
+	stats.p95 = samples[std::min(count - 1, (size_t)(0.95 * count))];
+
+	double sum = 0.0;
+	for (double sample : samples) {
+		sum += sample;
+	}
+	stats.mean = sum / count;
+	if (count > 1) {
+		double squares = 0.0;
+		for (double sample : samples) {
+			squares += (sample - stats.mean) * (sample - stats.mean);
+		}
+		stats.stddev = sqrt(squares / (count - 1));
+	}
+	return stats;
+}
+
+// Runs function warmup times untimed, then repetitions times timed. Milliseconds per call.
+template <typename F>
+BenchmarkStats MeasureMilliseconds(int warmup, int repetitions, F&& function)
+{
+	for (int i = 0; i < warmup; i++) {
+		function();
+	}
+	std::vector<double> samples;
+	samples.reserve(repetitions);
+	for (int i = 0; i < repetitions; i++) {
+		samples.push_back(TimeMilliseconds(function));
+	}
+	return CalculateStats(samples);
+}
+
+inline void PrintStatsHeader()
+{
+	std::cout << std::left << std::setw(44) << "benchmark" << std::right
+		<< std::setw(11) << "median ms" << std::setw(11) << "mean ms" << std::setw(11) << "stddev"
+		<< std::setw(11) << "min ms" << std::setw(11) << "p95 ms" << std::setw(6) << "reps"
+		<< "  throughput" << std::endl;
+}
+
+// itemsPerCall > 0 adds a throughput column computed from the median, e.g. queries or pixels.
+// The prefix follows the rate, so a few frames per second do not show up as 0.00 Mframe/s.
+inline void PrintStats(const std::string& name, const BenchmarkStats& stats, double itemsPerCall = 0.0, const char* itemName = "")
+{
+	std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(11) << stats.median << std::setw(11) << stats.mean << std::setw(11) << stats.stddev
+		<< std::setw(11) << stats.min << std::setw(11) << stats.p95 << std::setw(6) << stats.repetitions;
+	if (itemsPerCall > 0.0 && stats.median > 0.0) {
+		double rate = itemsPerCall / (stats.median / 1000.0);
+		const char* prefix = "";
+		if (rate >= 1.0e9) {
+			rate /= 1.0e9;
+			prefix = "G";
+		}
+		else if (rate >= 1.0e6) {
+			rate /= 1.0e6;
+			prefix = "M";
+		}
+		else if (rate >= 1.0e3) {
+			rate /= 1.0e3;
+			prefix = "k";
+		}
+		std::cout << "  " << std::setprecision(2) << rate << " " << prefix << itemName << "/s";
+	}
+	std::cout << std::endl;
+}
+
+#endif
@@ -0,0 +1,419 @@
+// CpuBenchmark.cpp
+// Times the CPU side of the renderer on the real assets: HDR decoding, the summed area table,
+// light extraction, the cubemap projection, OBJ loading, transform updates and environment
+// sequences. Also reports the irradiance error of the lights. Needs no GL context.
+//
+// Usage: ./benchmarks/cpuBenchmark [--warmup N] [--repetitions N] [--filter name]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BenchmarkStats.h"
+#include "Texture.h"
+#include "IBLSampler.h"
+#include "ObjParser.h"
+#include "MeshProcessor.h"
+#include "TransformSystem.h"
+
+const char* environmentDirectory = "hdr_equirectengular_maps";
+const char* objDirectory = "obj";
+
+const int areaQueryCount = 10000;
+const int projectionCount = 1 << 20;
+const int maxLightCount = 128;
+const int transformCount = 100000;
+const int transformHierarchyDepth = 4;
+const int sequenceWidth = 2048, sequenceHeight = 1024;
+const int sequenceFrameCount = 16;
+
+struct Options
+{
+	int warmup = 1;
+	int repetitions = 5;
+	std::string filter; // Only benchmarks whose name contains this
+};
+
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for " << argv[i] << std::endl;
+			return false;
+		}
+		const char* value = argv[i + 1];
+		if (strcmp(argv[i], "--warmup") == 0) {
+			options.warmup = std::max(0, atoi(value));
+		}
+		else if (strcmp(argv[i], "--repetitions") == 0) {
+			options.repetitions = std::max(1, atoi(value));
+		}
+		else if (strcmp(argv[i], "--filter") == 0) {
+			options.filter = value;
+		}
+		else {
+			std::cerr << "Unknown argument " << argv[i] << std::endl;
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+std::vector<std::string> ListFiles(const char* directory, const char* extension)
+{
+	std::vector<std::string> paths;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		if (entry.path().extension() == extension) {
+			paths.push_back(entry.path().string());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+std::string FileName(const std::string& path)
+{
+	return std::filesystem::path(path).filename().string();
+}
+
+// Keeps the optimizer from removing work whose result is otherwise unused
+volatile double benchmarkSink = 0.0;
+
+void BenchmarkEnvironment(const std::string& path, const Options& options)
+{
+	std::string map = FileName(path);
+	auto enabled = [&](const std::string& name) {
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	};
+
+	// HDR decode (stbi_loadf plus the CPU side copy)
+	std::string name = "decode " + map;
+	if (enabled(name)) {
+		double pixels = 0.0;
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			Texture texture(path, true, false);
+			pixels = (double)texture.getWidth() * texture.getHeight();
+		});
+		PrintStats(name, stats, pixels, "pixel");
+	}
+
+	Texture texture(path, true, false);
+	if (texture.getWidth() == 0) {
+		std::cerr << "Skipping " << path << ", failed to decode" << std::endl;
+		return;
+	}
+	double pixels = (double)texture.getWidth() * texture.getHeight();
+
+	name = "summed area table " + map;
+	if (enabled(name)) {
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			SummedTextureArea<long double> summedArea(&texture);
+		});
+		PrintStats(name, stats, pixels, "pixel");
+	}
+
+	name = "summed area query " + map;
+	if (enabled(name)) {
+		// Fixed seed, every run queries the same regions
+		std::mt19937 random(469);
+		int width = texture.getWidth();
+		int height = texture.getHeight();
+		std::vector<Region> regions;
+		regions.reserve(areaQueryCount);
+		for (int i = 0; i < areaQueryCount; i++) {
+			int x = std::uniform_int_distribution<int>(0, width - 1)(random);
+			int y = std::uniform_int_distribution<int>(0, height - 1)(random);
+			int w = std::uniform_int_distribution<int>(1, width - x)(random);
+			int h = std::uniform_int_distribution<int>(1, height - y)(random);
+			regions.emplace_back(x, y, w, h);
+		}
+
+		SummedTextureArea<long double> summedArea(&texture);
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			long double sum = 0.0;
+			for (const Region& region : regions) {
+				sum += summedArea.getArea(region);
+			}
+			benchmarkSink = (double)sum;
+		});
+		PrintStats(name, stats, areaQueryCount, "query");
+	}
+
+	// The sampler builds its summed area table once, changeNumLights only reruns the median cut
+	IBLSampler* sampler = nullptr;
+	for (int lightCount = 1; lightCount <= maxLightCount; lightCount *= 2) {
+		name = "median cut " + map + " " + std::to_string(lightCount) + (lightCount == 1 ? " light" : " lights");
+		if (!enabled(name)) {
+			continue;
+		}
+		if (sampler == nullptr) {
+			sampler = new IBLSampler(&texture, 1);
+		}
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			sampler->changeNumLights(lightCount);
+		});
+		PrintStats(name, stats);
+	}
+	delete sampler;
+
+	// The median cut followed by the Lloyd relaxation
+	sampler = nullptr;
+	for (int lightCount = 2; lightCount <= maxLightCount; lightCount *= 2) {
+		name = "lloyd relaxation " + map + " " + std::to_string(lightCount) + " lights";
+		if (!enabled(name)) {
+			continue;
+		}
+		if (sampler == nullptr) {
+			sampler = new IBLSampler(&texture, 1, IBL_RELAXATION_ITERATIONS);
+		}
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			sampler->changeNumLights(lightCount);
+		});
+		PrintStats(name, stats);
+	}
+	delete sampler;
+
+	// Not a timing: the irradiance error of both placements for every light count, and the
+	// fewest relaxed lights that are as close as the median cut ones
+	name = "irradiance error " + map;
+	if (enabled(name)) {
+		IBLSampler cut(&texture, 1);
+		IBLSampler relaxed(&texture, 1, IBL_RELAXATION_ITERATIONS);
+		std::vector<int> lightCounts;
+		std::vector<float> cutErrors, relaxedErrors;
+		for (int lightCount = 1; lightCount <= maxLightCount; lightCount *= 2) {
+			cut.changeNumLights(lightCount);
+			relaxed.changeNumLights(lightCount);
+			lightCounts.push_back(lightCount);
+			cutErrors.push_back(cut.getIrradianceError());
+			relaxedErrors.push_back(relaxed.getIrradianceError());
+		}
+		std::cout << name << " (relative RMS, median cut / relaxed, relaxed lights for the median cut error)" << std::endl;
+		for (size_t i = 0; i < lightCounts.size(); i++) {
+			size_t match = 0;
+			while (match < i && relaxedErrors[match] > cutErrors[i]) {
+				match++;
+			}
+			std::cout << "    " << std::setw(3) << lightCounts[i] << " lights: " << std::fixed << std::setprecision(4)
+				<< cutErrors[i] << " / " << relaxedErrors[i] << ", " << std::setw(3) << lightCounts[match] << " lights" << std::endl;
+		}
+		std::cout.unsetf(std::ios_base::floatfield);
+	}
+}
+
+void BenchmarkProjection(const Options& options)
+{
+	const char* name = "equirectangular to cubemap projection";
+	if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos) {
+		return;
+	}
+
+	const int width = 2048, height = 1024;
+	std::vector<Vector2> points(projectionCount);
+	std::mt19937 random(469);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	for (Vector2& point : points) {
+		point = Vector2(distribution(random) * width, distribution(random) * height);
+	}
+
+	BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+		Vector3 sum(0.0f);
+		for (const Vector2& point : points) {
+			sum += equirectangularToCubemapProjection(point, width, height);
+		}
+		benchmarkSink = sum.x + sum.y + sum.z;
+	});
+	PrintStats(name, stats, projectionCount, "point");
+}
+
+// The CPU part of ParseObjFile: parsing, then the processing UpdateMesh runs before the upload
+void BenchmarkObj(const std::string& path, const Options& options)
+{
+	std::string file = FileName(path);
+	auto enabled = [&](const std::string& name) {
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	};
+
+	ObjData data;
+	if (!LoadObjData(path.c_str(), data)) {
+		std::cerr << "Skipping " << path << ", failed to parse" << std::endl;
+		return;
+	}
+	double triangles = (double)data.triangles.size();
+
+	std::string name = "parse " + file;
+	if (enabled(name)) {
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			ObjData parsed;
+			LoadObjData(path.c_str(), parsed);
+		});
+		PrintStats(name, stats, triangles, "tri");
+	}
+
+	name = "process " + file;
+	if (enabled(name)) {
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			ProcessedMesh processed;
+			ProcessMesh(data.vertices, data.normals, data.textures, data.triangles, processed);
+		});
+		PrintStats(name, stats, triangles, "tri");
+	}
+}
+
+// TransformSystem::Update with a share of the transforms moved before every call
+void BenchmarkTransforms(const Options& options)
+{
+	auto enabled = [&](const std::string& name) {
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	};
+
+	std::mt19937 random(469);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	auto randomVector = [&]() { return Vector3(distribution(random), distribution(random), distribution(random)); };
+
+	auto benchmark = [&](const std::string& name, bool hierarchy, int movedEvery) {
+		if (!enabled(name)) {
+			return;
+		}
+		TransformSystem transforms;
+		std::vector<TransformHandle> handles(transformCount);
+		for (int i = 0; i < transformCount; i++) {
+			// Chains of transformHierarchyDepth transforms, each one the parent of the next
+			TransformHandle parent = hierarchy && i % transformHierarchyDepth != 0 ? handles[i - 1] : INVALID_TRANSFORM;
+			handles[i] = transforms.Create(parent);
+			transforms.SetPosition(handles[i], randomVector());
+			transforms.SetRotation(handles[i], glm::normalize(Quaternion(1.0f, randomVector())));
+			transforms.SetScale(handles[i], Vector3(1.0f) + 0.5f * glm::abs(randomVector()));
+		}
+		transforms.Update();
+
+		BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+			for (int i = 0; i < transformCount; i += movedEvery) {
+				transforms.SetPosition(handles[i], randomVector());
+			}
+			transforms.Update();
+			benchmarkSink = transforms.GetWorldMatrix(handles[transformCount - 1])[3].x;
+		});
+		PrintStats(name, stats, transformCount, "transform");
+	};
+	benchmark("transform update all moved", false, 1);
+	benchmark("transform update 1% moved", false, 100);
+	benchmark("transform update hierarchy all moved", true, 1);
+}
+
+// An HDR video: the first environment resampled to 2048x1024 with a bright sun crossing the sky,
+// one frame after the other. The incremental path (IBLSampler::setTexture) against a new sampler
+// per frame.
+void BenchmarkSequence(const std::string& path, const Options& options)
+{
+	auto enabled = [&](const std::string& name) {
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	};
+	const int lightCounts[] = { 16, maxLightCount };
+	bool any = false;
+	for (int lightCount : lightCounts) {
+		any = any || enabled("environment sequence incremental " + std::to_string(lightCount) + " lights")
+			|| enabled("environment sequence full rebuild " + std::to_string(lightCount) + " lights");
+	}
+	if (!any) {
+		return;
+	}
+
+	Texture source(path, true, false);
+	if (source.getWidth() == 0) {
+		std::cerr << "Skipping the environment sequence, failed to decode " << path << std::endl;
+		return;
+	}
+	int channels = source.getChannels();
+	std::vector<float> pixels((size_t)sequenceWidth * sequenceHeight * channels);
+	std::vector<Texture*> frames;
+	for (int frame = 0; frame < sequenceFrameCount; frame++) {
+		float sunX = (frame + 0.5f) / sequenceFrameCount * sequenceWidth;
+		float sunY = 0.3f * sequenceHeight;
+		for (int y = 0; y < sequenceHeight; y++) {
+			for (int x = 0; x < sequenceWidth; x++) {
+				int sourceX = x * source.getWidth() / sequenceWidth;
+				int sourceY = y * source.getHeight() / sequenceHeight;
+				const float* in = source.getHDRData() + ((size_t)sourceY * source.getWidth() + sourceX) * channels;
+				float* out = pixels.data() + ((size_t)y * sequenceWidth + x) * channels;
+				float distance2 = (x - sunX) * (x - sunX) + (y - sunY) * (y - sunY);
+				float sun = distance2 < 24.0f * 24.0f ? 50.0f : 0.0f;
+				for (int c = 0; c < channels; c++) {
+					out[c] = in[c] + sun;
+				}
+			}
+		}
+		frames.push_back(new Texture(sequenceWidth, sequenceHeight, channels, pixels.data()));
+	}
+
+	for (int lightCount : lightCounts) {
+		std::string lights = std::to_string(lightCount) + " lights";
+		std::string name = "environment sequence incremental " + lights;
+		if (enabled(name)) {
+			IBLSampler sampler(frames[0], lightCount);
+			int changedTiles = 0, reusedSplits = 0;
+			BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+				for (int frame = 1; frame <= sequenceFrameCount; frame++) {
+					sampler.setTexture(frames[frame % sequenceFrameCount]);
+					changedTiles += sampler.getChangedTileCount();
+					reusedSplits += sampler.getReusedSplitCount();
+				}
+			});
+			PrintStats(name, stats, sequenceFrameCount, "frame");
+			int calls = (options.warmup + options.repetitions) * sequenceFrameCount;
+			std::cout << "    " << changedTiles / calls << " of " << (sequenceWidth / SUMMED_AREA_TILE_SIZE) * (sequenceHeight / SUMMED_AREA_TILE_SIZE)
+				<< " tiles rebuilt, " << reusedSplits / calls << " of " << lightCount - 1 << " splits reused per frame" << std::endl;
+		}
+
+		name = "environment sequence full rebuild " + lights;
+		if (enabled(name)) {
+			BenchmarkStats stats = MeasureMilliseconds(options.warmup, options.repetitions, [&]() {
+				for (int frame = 1; frame <= sequenceFrameCount; frame++) {
+					IBLSampler sampler(frames[frame % sequenceFrameCount], lightCount);
+					benchmarkSink = (double)sampler.getLights()->numLights;
+				}
+			});
+			PrintStats(name, stats, sequenceFrameCount, "frame");
+		}
+	}
+
+	for (Texture* frame : frames) {
+		delete frame;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		return EXIT_FAILURE;
+	}
+
+	std::vector<std::string> environments = ListFiles(environmentDirectory, ".hdr");
+	std::vector<std::string> objFiles = ListFiles(objDirectory, ".obj");
+	if (environments.empty() && objFiles.empty()) {
+		std::cerr << "No assets found, run from the repository root" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << options.warmup << " warmup + " << options.repetitions << " timed repetitions per benchmark" << std::endl << std::endl;
+	PrintStatsHeader();
+	for (const std::string& path : environments) {
+		BenchmarkEnvironment(path, options);
+	}
+	BenchmarkProjection(options);
+	for (const std::string& path : objFiles) {
+		BenchmarkObj(path, options);
+	}
+	BenchmarkTransforms(options);
+	if (!environments.empty()) {
+		BenchmarkSequence(environments[0], options);
+	}
+	return 0;
+}
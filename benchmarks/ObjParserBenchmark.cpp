@@ -0,0 +1,146 @@
+// ObjParserBenchmark.cpp
+// Generates a multi-million triangle OBJ and times the OBJ parser against the
+// previous getline/stringstream implementation.
+//
+// Usage: ./benchmarks/objParserBenchmark [triangleCount] [path]
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+#include "ObjParser.h"
+#include "BenchmarkStats.h"
+
+// UV sphere in the same v//vn layout as the files in obj/
+void WriteSphereObj(const std::string& path, size_t triangleCount)
+{
+	int rings = (int)sqrt(triangleCount / 4.0);
+	int segments = (int)(triangleCount / (2.0 * rings));
+
+	std::ofstream file(path);
+	file << "# Benchmark sphere, " << rings << " rings x " << segments << " segments\n";
+	char line[128];
+	for (int r = 0; r <= rings; r++) {
+		float phi = glm::pi<float>() * r / rings;
+		for (int s = 0; s < segments; s++) {
+			float theta = 2.0f * glm::pi<float>() * s / segments;
+			Vector3 p(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+			snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", p.x, p.y, p.z);
+			file << line;
+		}
+	}
+	for (int r = 0; r <= rings; r++) {
+		float phi = glm::pi<float>() * r / rings;
+		for (int s = 0; s < segments; s++) {
+			float theta = 2.0f * glm::pi<float>() * s / segments;
+			Vector3 p(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+			snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", p.x, p.y, p.z);
+			file << line;
+		}
+	}
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			int a = r * segments + s + 1;
+			int b = r * segments + (s + 1) % segments + 1;
+			int c = a + segments;
+			int d = b + segments;
+			snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d\n", a, a, c, c, b, b);
+			file << line;
+			snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d\n", b, b, c, c, d, d);
+			file << line;
+		}
+	}
+}
+
+// The parser ParseObjFile used before: getline, a stringstream per line and per corner
+size_t LegacyParseObj(const char* path)
+{
+	std::vector<Vector3> vertices, normals;
+	std::vector<Triangle> triangles;
+	std::fstream file(path, std::ios::in);
+	std::string line;
+	while (getline(file, line)) {
+		std::stringstream ss(line);
+		std::string prefix;
+		ss >> prefix;
+		if (prefix == "v") {
+			float x, y, z;
+			ss >> x >> y >> z;
+			vertices.emplace_back(x, y, z);
+		}
+		else if (prefix == "vn") {
+			float x, y, z;
+			ss >> x >> y >> z;
+			normals.emplace_back(x, y, z);
+		}
+		else if (prefix == "f") {
+			std::vector<int> vIndices, nIndices;
+			std::string vertex;
+			while (ss >> vertex) {
+				std::replace(vertex.begin(), vertex.end(), '/', ' ');
+				std::stringstream vertexStream(vertex);
+				int v, n;
+				vertexStream >> v >> n;
+				vIndices.push_back(v - 1);
+				nIndices.push_back(n - 1);
+			}
+			int v1[3] = { vIndices[0], vIndices[1], vIndices[2] };
+			int n1[3] = { nIndices[0], nIndices[1], nIndices[2] };
+			triangles.emplace_back(Triangle(v1, v1, n1));
+		}
+	}
+	return triangles.size();
+}
+
+int main(int argc, char** argv)
+{
+	size_t triangleCount = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+	std::string path = argc > 2 ? argv[2] : (std::filesystem::temp_directory_path() / "objParserBenchmark.obj").string();
+
+	if (!std::filesystem::exists(path)) {
+		std::cout << "Generating " << path << "..." << std::endl;
+		WriteSphereObj(path, triangleCount);
+	}
+	double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+	std::cout << "File: " << path << " (" << std::fixed << std::setprecision(1) << megabytes << " MB)" << std::endl;
+
+	// Warm up the page cache
+	{
+		ObjData data;
+		LoadObjData(path.c_str(), data);
+		triangleCount = data.triangles.size();
+	}
+	std::cout << "Triangles: " << triangleCount << std::endl << std::endl;
+
+	auto report = [&](const char* name, double milliseconds) {
+		std::cout << std::left << std::setw(28) << name << std::right << std::setw(10) << std::setprecision(1) << milliseconds << " ms"
+			<< std::setw(10) << megabytes / (milliseconds / 1000.0) << " MB/s"
+			<< std::setw(10) << std::setprecision(2) << triangleCount / (milliseconds * 1000.0) << " Mtri/s" << std::endl;
+	};
+
+	size_t legacyTriangles = 0;
+	report("getline + stringstream", TimeMilliseconds([&]() { legacyTriangles = LegacyParseObj(path.c_str()); }));
+	if (legacyTriangles != triangleCount) {
+		std::cerr << "Triangle count mismatch: " << legacyTriangles << " vs " << triangleCount << std::endl;
+	}
+
+	std::vector<int> threadCounts;
+	int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (int threads = 1; threads < hardwareThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+	for (int threads : threadCounts) {
+		ObjData data;
+		std::string name = "mmap + from_chars, " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+		report(name.c_str(), TimeMilliseconds([&]() { LoadObjData(path.c_str(), data, true, true, threads); }));
+	}
+	return 0;
+}
@@ -11,8 +11,10 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <math.h> 
 #include <filesystem>
+#include <chrono>
 
 #include <GL/glew.h>
 // #include <GL/gl.h>   // The GL Header File
@@ -28,6 +30,8 @@
 #include "Mesh.h"
 #include "Material.h"
 #include "ShaderProgram.h"
+#include "ShaderLibrary.h"
+#include "ShaderCache.h"
 #include "utils.h"
 #include "constTypes.h"
 #include "printExtensions.h"
@@ -35,15 +39,22 @@
 #include "Framebuffer.h"
 #include "EnvironmentRenderer.h"
 #include "IBLSampler.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "LightBudget.h"
+#include "EnvironmentSequence.h"
+#include "FrameRenderer.h"
+#include "DynamicResolution.h"
+#include "AutoExposure.h"
+#include "Simulation.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "Benchmark.h"
+#include "HeadlessContext.h"
 
 // Paths
 const std::string hdriTestPath = "hdr_equirectengular_maps/Test.hdr";
 const std::string hdriPath = "hdr_equirectengular_maps/Thumersbach.hdr";
+const std::string hdriDirectory = "hdr_equirectengular_maps";
 
-const std::string cubeObjectPath = "obj/cube24.obj";
 const std::string sphereObjectPath = "obj/sphere.obj";
 
 const std::string vertexShaderPath = "shaders/lit.vert";
@@ -55,6 +66,9 @@ const std::string glassFragmentShaderPath = "shaders/glass.frag";
 const std::string glossyFragmentShaderPath = "shaders/glossy.frag";
 const std::string specularDiscoFragmentShaderPath = "shaders/specular_disco.frag";
 
+const std::string profilerTracePath = "profile_trace.json";
+const std::string memoryReportPath = "memory_report.json";
+
 enum DrawMode
 {
 	LIGHT_PROBE = 1,
@@ -65,12 +79,14 @@ enum DrawMode
 };
 DrawMode drawMode = LIGHT_PROBE;
 bool specularEnabled = true;
-std::map<DrawMode, ShaderProgram*> shaderPrograms;
+ShaderLibrary* shaderLibrary;
 
-// Light count
+// Light count, an environment with a light budget (tools/lightBudget) starts with its count and relaxation
 int minDirectLightCount = 1;
 int maxDirectLightCount = 7;
 int directionalLightPow = 2; // 2^n	// 1, 2, 4, 8, 16, 32, 64
+// L toggles the Lloyd relaxation of the median cut lights (IBLSampler::setRelaxationIterations)
+int lightRelaxationIterations = 0;
 
 // Window dimensions
 GLuint WIDTH = 1280, HEIGHT = 720;
@@ -82,31 +98,59 @@ GLFWwindow* window;
 
 // Scene components
 Camera* mainCamera;
-std::vector<Light*> lights;
 MeshRenderer* meshRenderer;
-EnvironmentRenderer* environmentRenderer;
-IBLSampler* iblSampler;
+FrameRenderer* frameRenderer;
+Simulation* simulation;
+EnvironmentRenderer* environmentRenderer = nullptr;
+IBLSampler* iblSampler = nullptr;
 Framebuffer* hdriToCubemapFramebuffer;
-Mesh *cubeMesh, *sphereMesh;
-Texture* hdriTexture;
+Mesh* sphereMesh;
+Texture* hdriTexture = nullptr;
 Texture* skyboxTexture;
 
+// --sequence <directory>: the environment plays the .hdr frames of a directory
+std::string sequenceDirectory;
+EnvironmentSequence* environmentSequence = nullptr;
+double nextSequenceFrameTime = 0.0;
+
+// The scene is drawn at a resolution that keeps its GPU time at --target-frame-time <ms>, V toggles it
+DynamicResolution* dynamicResolution = nullptr;
+float targetFrameTime = DYNAMIC_RESOLUTION_TARGET_MS;
+
+// The exposure follows the rendered frame, Q switches to the W/S exposure and back. While it is on,
+// W/S change the exposure compensation instead.
+AutoExposure* autoExposure = nullptr;
+bool autoExposureEnabled = true;
+
 Material* shinyMaterial;
 
 int rotationDirection = 0; // 0: no rotation, 1: right, -1: left
+int environmentRotationDirection = 0; // Same for the environment turntable
+
+// Set by main, reported once the first frame is drawn
+std::chrono::steady_clock::time_point startupTime;
 
 
 // Game objects (all necessary components for rendering is in here)
 GameObject* sphere;
+// O: smaller spheres orbiting with the sphere, all of them reflecting each other through probes
+std::vector<GameObject*> companionSpheres;
+bool reflectionProbesEnabled = false;
 
 void CreateWindow();
+int RunBenchmark(int argc, char** argv);
 void reshape(GLFWwindow* window, int w, int h);
 void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mainLoop(GLFWwindow* window);
 void init();
+void loadEnvironment(const std::string& path, bool useLightBudget = true);
 void drawObjects();
 void update();
-void rotateCamera(float yaw, float pitch);
+void updateEnvironmentSequence();
+ShaderProgram* getDrawModeShader();
+void updateSphereShader();
+void toggleReflectionProbes();
+void reportStartupTime();
 
 void init()
 {
@@ -115,33 +159,15 @@ void init()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	// glEnable(GL_CULL_FACE);
 
-	// Create skybox texture
-	hdriTexture = new Texture(hdriPath, true);
-	hdriTexture->setTextureUnit(0);
-	assert(glGetError() == GL_NO_ERROR);
-	std::cout << "HDRI texture loaded" << std::endl;
-
-	// Create skybox mesh
-	cubeMesh = ParseObjFile(cubeObjectPath.c_str(), true, true);
-	assert(cubeMesh != nullptr);
-	std::cout << "Cube mesh loaded" << std::endl;
-
-	// Create framebuffer for cubemap creation
-	hdriToCubemapFramebuffer = Framebuffer::CreateFramebuffer(1024, 1024, hdriTexture);
-	assert(glGetError() == GL_NO_ERROR);
-	std::cout << "Framebuffer created" << std::endl;
-
-	// Create environment renderer
-	environmentRenderer = new EnvironmentRenderer(hdriToCubemapFramebuffer, cubeMesh);
-	assert(glGetError() == GL_NO_ERROR);
-	std::cout << "Environment renderer created" << std::endl;
-
-	// Create skybox texture
-	skyboxTexture = environmentRenderer->getCubemapTexture();
+	// Shader permutations are compiled on first use. The first draw mode is requested now so the
+	// driver compiles it while the mesh and the environment load, the others when they are selected.
+	shaderLibrary = ShaderLibrary::GetShared();
+	getDrawModeShader();
 
 	// Load sphere mesh
-	sphereMesh = ParseObjFile(sphereObjectPath.c_str(), true, true);
+	sphereMesh = LoadMesh(sphereObjectPath.c_str());
 	assert(sphereMesh != nullptr);
+	GeometryArena::PrintAllStats();
 
 	// Create materials
 	shinyMaterial = new Material();
@@ -150,16 +176,8 @@ void init()
 	shinyMaterial->specular = Vector3(1);
 	shinyMaterial->shininess = 1;
 
-	// Create shader programs
-	shaderPrograms[LIGHT_PROBE] = new ShaderProgram(vertexShaderPath.c_str(), lightProbeFragmentShaderPath.c_str());
-	shaderPrograms[MIRROR] = new ShaderProgram(vertexShaderPath.c_str(), mirrorFragmentShaderPath.c_str());
-	shaderPrograms[GLASS] = new ShaderProgram(vertexShaderPath.c_str(), glassFragmentShaderPath.c_str());
-	shaderPrograms[GLOSSY] = new ShaderProgram(vertexShaderPath.c_str(), glossyFragmentShaderPath.c_str());
-	shaderPrograms[SPECULAR_DISCO] = new ShaderProgram(vertexShaderPath.c_str(), specularDiscoFragmentShaderPath.c_str());
-
-	// Create game objects
-	sphere = new GameObject();
-	sphere->SetShader(shaderPrograms[drawMode]);
+	// Create game objects, with their program so the default one is never compiled
+	sphere = new GameObject(getDrawModeShader());
 	sphere->SetMesh(sphereMesh);
 	// Rotate upside down
 	sphere->SetRotation(utilsFromAxisAngle(Vector3(1.0f, 0.0f, 0.0f), 180.0f));
@@ -176,70 +194,231 @@ void init()
 	mainCamera->setNearPlane(0.01f);
 	mainCamera->setFarPlane(100.0f);
 
-	// Create IBL sampler for lighting
-	iblSampler = new IBLSampler(hdriTexture, (int) pow(2, directionalLightPow));
-	std::cout << "IBL sampler created" << std::endl;
-
 	// Create mesh renderer
 	meshRenderer = new MeshRenderer();
 	meshRenderer->SetCamera(mainCamera);
+
+	// Opaque objects front to back, then the sky
+	frameRenderer = new FrameRenderer(meshRenderer);
+	frameRenderer->AddObject(sphere);
+
+	dynamicResolution = new DynamicResolution(targetFrameTime);
+}
+void loadEnvironment(const std::string& path, bool useLightBudget)
+{
+	// Release the previous environment, the exposure carries over
+	float exposure = environmentRenderer != nullptr ? environmentRenderer->getExposure() : -1.0f;
+	delete iblSampler;
+	delete environmentRenderer; // Also deletes the cubemap creation framebuffer
+	delete hdriTexture;
+
+	// Create skybox texture
+	hdriTexture = new Texture(path, true);
+	hdriTexture->setTextureUnit(0);
+	// Only a sequence renders the cubemap again, otherwise the GL texture goes after the bake.
+	// The CPU pixels stay, the IBL sampler cuts them again when the light count changes.
+	hdriTexture->setTransient(sequenceDirectory.empty());
+	assert(glGetError() == GL_NO_ERROR);
+	std::cout << "HDRI texture loaded" << std::endl;
+
+	// Create framebuffer for cubemap creation
+	hdriToCubemapFramebuffer = Framebuffer::CreateFramebuffer(1024, 1024, hdriTexture);
+	assert(glGetError() == GL_NO_ERROR);
+	std::cout << "Framebuffer created" << std::endl;
+
+	// Create environment renderer
+	environmentRenderer = new EnvironmentRenderer(hdriToCubemapFramebuffer);
+	assert(glGetError() == GL_NO_ERROR);
+	std::cout << "Environment renderer created" << std::endl;
+	if (exposure >= 0.0f) {
+		environmentRenderer->setExposure(exposure);
+	}
+
+	// Create skybox texture
+	skyboxTexture = environmentRenderer->getCubemapTexture();
+
+	LightBudget budget;
+	if (useLightBudget && LoadLightBudget(LightBudgetPath(path), budget)) {
+		directionalLightPow = 0;
+		while ((1 << (directionalLightPow + 1)) <= budget.lightCount && directionalLightPow < maxDirectLightCount) {
+			directionalLightPow++;
+		}
+		lightRelaxationIterations = budget.relaxationIterations;
+		std::cout << "Light budget: " << (1 << directionalLightPow) << " lights, relaxation " << lightRelaxationIterations
+			<< ", diffuse error " << budget.diffuseError << ", glossy error " << budget.glossyError << std::endl;
+	}
+
+	// Create IBL sampler for lighting
+	iblSampler = new IBLSampler(hdriTexture, (int) pow(2, directionalLightPow), lightRelaxationIterations);
+	std::cout << "IBL sampler created" << std::endl;
+
 	meshRenderer->SetCubemap(skyboxTexture);
 	meshRenderer->SetExposure(environmentRenderer->getExposure());
-	meshRenderer->SetSpecularEnabled(specularEnabled);
 	meshRenderer->SetLights(iblSampler->getLights());
+	frameRenderer->SetEnvironment(environmentRenderer);
 }
-void update()
+// The program variant of the draw mode, specular toggle and light count
+ShaderProgram* getDrawModeShader()
 {
-	// Rotate sphere
-	if (rotationDirection != 0)
+	int lightCount = iblSampler != nullptr ? iblSampler->getLights()->numLights : (int)pow(2, directionalLightPow);
+	std::string lightCountBucket = std::to_string(ShaderLibrary::LightCountBucket(lightCount));
+	std::string specular = specularEnabled ? "1" : "0";
+
+	std::string fragmentPath;
+	ShaderDefines defines;
+	switch (drawMode)
 	{
-		float angle = 0.01f * rotationDirection;
-		rotateCamera(angle, 0.0f);
-		// rotate game object too
-		Quaternion rotation = sphere->GetRotation();
-		Quaternion newRotation = glm::rotate(rotation, angle, Vector3(0.0f, 1.0f, 0.0f));
-		sphere->SetRotation(newRotation);
+		case LIGHT_PROBE:
+			fragmentPath = lightProbeFragmentShaderPath;
+			defines = { { "SPECULAR_ENABLED", specular }, { "LIGHT_COUNT", lightCountBucket } };
+			break;
+		case MIRROR:
+			fragmentPath = mirrorFragmentShaderPath;
+			break;
+		case GLASS:
+			fragmentPath = glassFragmentShaderPath;
+			break;
+		case GLOSSY:
+			fragmentPath = glossyFragmentShaderPath;
+			defines = { { "SPECULAR_ENABLED", specular }, { "LIGHT_COUNT", lightCountBucket } };
+			break;
+		case SPECULAR_DISCO:
+			fragmentPath = specularDiscoFragmentShaderPath;
+			defines = { { "LIGHT_COUNT", lightCountBucket } };
+			break;
 	}
+	return shaderLibrary->Get(vertexShaderPath, fragmentPath, defines);
 }
-
-void drawObjects()
+void updateSphereShader()
 {
-	// Draw environment
-	environmentRenderer->render(*mainCamera);
-
-	// Draw game objects
-	meshRenderer->Draw(sphere);
-	assert(glGetError() == GL_NO_ERROR);
+	sphere->SetShader(getDrawModeShader());
+	for (GameObject* companion : companionSpheres) {
+		companion->SetShader(sphere->shader);
+	}
+	// The spheres look different in each other's reflections now
+	if (frameRenderer != nullptr) {
+		frameRenderer->InvalidateReflectionProbes();
+	}
 }
-void rotateCamera(float yaw, float pitch)
+void toggleReflectionProbes()
 {
-	// Move and rotate camera on a sphere centered around 0,0,0 with radius 10
-	// Calculate spherical coordinates
-	Vector3 position = mainCamera->getPosition();
-	float radius = glm::length(position);
-	float theta = atan2(position.z, position.x);
-	float phi = acos(position.y / radius);
+	reflectionProbesEnabled = !reflectionProbesEnabled;
+	if (companionSpheres.empty()) {
+		for (float x : { -2.2f, 2.2f }) {
+			GameObject* companion = new GameObject(sphere->shader);
+			companion->SetMesh(sphereMesh);
+			companion->SetMaterial(shinyMaterial);
+			companion->SetParent(sphere);
+			companion->SetPosition(Vector3(x, 0.0f, 0.0f));
+			companion->SetScale(Vector3(0.6f));
+			companionSpheres.push_back(companion);
+		}
+	}
 
-	theta += yaw;
-	phi += pitch;
+	if (reflectionProbesEnabled) {
+		frameRenderer->AddReflectionProbe(sphere);
+		for (GameObject* companion : companionSpheres) {
+			frameRenderer->AddObject(companion);
+			frameRenderer->AddReflectionProbe(companion);
+		}
+	}
+	else {
+		frameRenderer->RemoveReflectionProbe(sphere);
+		for (GameObject* companion : companionSpheres) {
+			frameRenderer->RemoveObject(companion);
+		}
+	}
+	std::cout << "Reflection probes: " << (reflectionProbesEnabled ? "on" : "off") << std::endl;
+}
+void reportStartupTime()
+{
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count();
+	const ShaderCacheStats& cacheStats = GetShaderCacheStats();
+	std::cout << "Startup: " << milliseconds << " ms to the first frame, shader cache "
+		<< cacheStats.hits << " hits, " << cacheStats.misses << " misses"
+		<< (IsShaderCacheSupported() ? "" : " (no program binary support)") << std::endl;
+}
+void update()
+{
+	PROFILE_CPU_SCOPE("Update");
 
-	// Clamp phi
-	phi = glm::clamp(phi, 0.1f, glm::pi<float>() - 0.1f);
+	// Camera orbit and sphere rotation run on the simulation thread, interpolated to this frame
+	SimulationState state = simulation->GetInterpolatedState();
+	mainCamera->setPosition(state.cameraPosition);
+	mainCamera->setTarget(Vector3(0.0f, 0.0f, 0.0f));
+	sphere->SetRotation(state.sphereRotation);
 
-	// Convert back to cartesian
-	position.x = radius * sin(phi) * cos(theta);
-	position.y = radius * cos(phi);
-	position.z = radius * sin(phi) * sin(theta);
+	// Environment turntable, only the light directions are re-uploaded when it moves
+	Quaternion environmentRotation = glm::angleAxis(state.environmentYaw, Vector3(0.0f, 1.0f, 0.0f));
+	environmentRenderer->setRotation(environmentRotation);
+	meshRenderer->SetEnvironmentRotation(environmentRotation);
 
-	mainCamera->setPosition(position);
-	mainCamera->setTarget(Vector3(0.0f, 0.0f, 0.0f));
+	if (environmentSequence != nullptr) {
+		updateEnvironmentSequence();
+	}
 
 	// Update camera UBO
 	meshRenderer->UpdateCameraUBO();
 }
+// Shows the next frame of the sequence once it is due and decoded. Only the tiles of the summed
+// area table that changed are rebuilt and the light splits start from the last frame's.
+void updateEnvironmentSequence()
+{
+	PROFILE_CPU_SCOPE("EnvironmentSequence");
 
+	double now = glfwGetTime();
+	if (now < nextSequenceFrameTime) {
+		return;
+	}
+	Texture* frame = environmentSequence->Advance();
+	if (frame == nullptr) {
+		return; // Still decoding, the current frame stays up
+	}
+	nextSequenceFrameTime = now + 1.0 / ENVIRONMENT_SEQUENCE_FRAME_RATE;
+
+	if (frame->getWidth() != hdriTexture->getWidth() || frame->getHeight() != hdriTexture->getHeight()) {
+		// The cubemap source is sized once, the sampler goes back to it before the frame is released
+		std::cerr << "Environment sequence: frame " << environmentSequence->GetCurrentIndex()
+			<< " is not " << hdriTexture->getWidth() << "x" << hdriTexture->getHeight() << ", playback stopped" << std::endl;
+		iblSampler->setTexture(hdriTexture);
+		meshRenderer->SetLights(iblSampler->getLights());
+		delete environmentSequence;
+		environmentSequence = nullptr;
+		return;
+	}
+
+	iblSampler->setTexture(frame);
+	hdriTexture->uploadHDR(frame->getHDRData());
+	environmentRenderer->updateCubemap();
+	meshRenderer->SetLights(iblSampler->getLights());
+	frameRenderer->InvalidateReflectionProbes();
+}
+
+void drawObjects()
+{
+	// Clears depth, draws the game objects and then the environment behind them
+	frameRenderer->Render(*mainCamera);
+	assert(glGetError() == GL_NO_ERROR);
+}
 int main(int argc, char** argv)
 {
+	startupTime = std::chrono::steady_clock::now();
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark") == 0)
+			return RunBenchmark(argc, argv);
+		if (strcmp(argv[i], "--sequence") == 0 && i + 1 < argc)
+			sequenceDirectory = argv[++i];
+		if (strcmp(argv[i], "--target-frame-time") == 0 && i + 1 < argc)
+		{
+			targetFrameTime = (float)atof(argv[++i]);
+			if (targetFrameTime <= 0.0f)
+			{
+				std::cerr << "--target-frame-time needs a positive number of milliseconds" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
 	CreateWindow();
 	return 0;
 }
@@ -256,12 +435,19 @@ void reshape(GLFWwindow* window, int w, int h)
 }
 void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	PROFILE_CPU_SCOPE("Input");
+
 	if(action == GLFW_PRESS)
 	{
 		if (key == GLFW_KEY_ESCAPE) glfwSetWindowShouldClose(window, GL_TRUE);
 
 		// W to double exposure
-		if (key == GLFW_KEY_W)
+		if (key == GLFW_KEY_W && autoExposureEnabled)
+		{
+			autoExposure->SetCompensation(autoExposure->GetCompensation() * 2.0f);
+			std::cout << "Exposure compensation: " << autoExposure->GetCompensation() << std::endl;
+		}
+		else if (key == GLFW_KEY_W)
 		{
 			float exposure = environmentRenderer->getExposure();
 			if (exposure == 0.0f) exposure = 0.01f;
@@ -270,7 +456,12 @@ void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 			std::cout << "Exposure: " << environmentRenderer->getExposure() << std::endl;
 		}
 		// S to half exposure
-		if (key == GLFW_KEY_S)
+		if (key == GLFW_KEY_S && autoExposureEnabled)
+		{
+			autoExposure->SetCompensation(autoExposure->GetCompensation() * 0.5f);
+			std::cout << "Exposure compensation: " << autoExposure->GetCompensation() << std::endl;
+		}
+		else if (key == GLFW_KEY_S)
 		{
 			float exposure = environmentRenderer->getExposure();
 			environmentRenderer->setExposure(exposure * 0.5f);
@@ -279,16 +470,61 @@ void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 		}
 		// A to rotate left
 		if (key == GLFW_KEY_A)
-			rotationDirection += -1;
+			simulation->SetRotationDirection(rotationDirection += -1);
 		// D to rotate right
 		if (key == GLFW_KEY_D)
-			rotationDirection += 1;
+			simulation->SetRotationDirection(rotationDirection += 1);
+		// Z and X to turn the environment
+		if (key == GLFW_KEY_Z)
+			simulation->SetEnvironmentRotationDirection(environmentRotationDirection += -1);
+		if (key == GLFW_KEY_X)
+			simulation->SetEnvironmentRotationDirection(environmentRotationDirection += 1);
+		// P to capture a Chrome trace of the next frames
+		if (key == GLFW_KEY_P && !Profiler::Get()->IsCapturing())
+			Profiler::Get()->StartCapture(profilerTracePath);
+		// M to print the memory report and write it as JSON
+		if (key == GLFW_KEY_M)
+		{
+			ResourceRegistry::Get()->PrintReport(std::cout);
+			ResourceRegistry::Get()->WriteJson(memoryReportPath);
+		}
+		// J and K to half and double the LOD bias, a larger bias keeps finer levels longer
+		if (key == GLFW_KEY_J || key == GLFW_KEY_K)
+		{
+			meshRenderer->SetLodBias(key == GLFW_KEY_K ? meshRenderer->GetLodBias() * 2.0f : meshRenderer->GetLodBias() * 0.5f);
+			std::cout << "LOD bias: " << meshRenderer->GetLodBias() << std::endl;
+		}
+		// O to toggle the companion spheres and their reflection probes
+		if (key == GLFW_KEY_O)
+			toggleReflectionProbes();
+		// B and N to double and half the GPU time the reflection probes may take per frame
+		if (key == GLFW_KEY_B || key == GLFW_KEY_N)
+		{
+			float budget = frameRenderer->GetReflectionProbeBudget();
+			frameRenderer->SetReflectionProbeBudget(key == GLFW_KEY_B ? budget * 2.0f : budget * 0.5f);
+			std::cout << "Reflection probe budget: " << frameRenderer->GetReflectionProbeBudget() << " ms, face: "
+				<< frameRenderer->GetReflectionProbeFaceMilliseconds() << " ms" << std::endl;
+		}
+		// Q to toggle automatic exposure, the manual one starts where it left off
+		if (key == GLFW_KEY_Q)
+		{
+			autoExposureEnabled = !autoExposureEnabled;
+			autoExposure->SetExposure(environmentRenderer->getExposure());
+			frameRenderer->SetAutoExposure(autoExposureEnabled ? autoExposure : nullptr);
+			std::cout << "Auto exposure enabled: " << autoExposureEnabled << std::endl;
+		}
+		// V to toggle dynamic resolution
+		if (key == GLFW_KEY_V)
+		{
+			dynamicResolution->SetEnabled(!dynamicResolution->IsEnabled());
+			std::cout << "Dynamic resolution enabled: " << dynamicResolution->IsEnabled() << std::endl;
+		}
 		// F to toggle specular lightning effect
 		if (key == GLFW_KEY_F)
 		{
 			specularEnabled = !specularEnabled;
 			std::cout << "Specular enabled: " << specularEnabled << std::endl;
-			meshRenderer->SetSpecularEnabled(specularEnabled);
+			updateSphereShader();
 		}
 		// R to multiply direct light count by 2
 		if (key == GLFW_KEY_R)
@@ -298,6 +534,7 @@ void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 			iblSampler->changeNumLights((int) pow(2, directionalLightPow));
 			std::cout << "Direct light count: " << (int) pow(2, directionalLightPow) << std::endl;
 			meshRenderer->SetLights(iblSampler->getLights());
+			updateSphereShader();
 		}
 		// E to multiply direct light count by 0.5
 		if (key == GLFW_KEY_E)
@@ -307,6 +544,17 @@ void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 			iblSampler->changeNumLights((int) pow(2, directionalLightPow));
 			std::cout << "Direct light count: " << (int) pow(2, directionalLightPow) << std::endl;
 			meshRenderer->SetLights(iblSampler->getLights());
+			updateSphereShader();
+		}
+
+		// L to toggle the Lloyd relaxation of the lights
+		if (key == GLFW_KEY_L)
+		{
+			lightRelaxationIterations = lightRelaxationIterations == 0 ? IBL_RELAXATION_ITERATIONS : 0;
+			iblSampler->setRelaxationIterations(lightRelaxationIterations);
+			std::cout << "Light relaxation enabled: " << (lightRelaxationIterations > 0) << std::endl;
+			meshRenderer->SetLights(iblSampler->getLights());
+			frameRenderer->InvalidateReflectionProbes();
 		}
 
 		// 1 -> LIGHT_PROBE
@@ -320,7 +568,7 @@ void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 			if (drawMode == (DrawMode)mode) return;
 
 			drawMode = (DrawMode)mode;
-			sphere->SetShader(shaderPrograms[drawMode]);
+			updateSphereShader();
 			std::cout << "Draw mode: ";
 			switch (drawMode)
 			{
@@ -336,14 +584,20 @@ void inputCallback(GLFWwindow* window, int key, int scancode, int action, int mo
 	else if(action == GLFW_RELEASE)
 	{
 		if (key == GLFW_KEY_A)
-			rotationDirection += 1;
+			simulation->SetRotationDirection(rotationDirection += 1);
 		if (key == GLFW_KEY_D)
-			rotationDirection += -1;
+			simulation->SetRotationDirection(rotationDirection += -1);
+		if (key == GLFW_KEY_Z)
+			simulation->SetEnvironmentRotationDirection(environmentRotationDirection += 1);
+		if (key == GLFW_KEY_X)
+			simulation->SetEnvironmentRotationDirection(environmentRotationDirection += -1);
 	}
 	
 }
 void mousePosInputCallback(GLFWwindow* window, double xpos, double ypos)
 {
+	PROFILE_CPU_SCOPE("Input");
+
 	// Move camera with mouse
 	static bool doRotateCamera = false;
 	static double lastX = 0;
@@ -360,7 +614,7 @@ void mousePosInputCallback(GLFWwindow* window, double xpos, double ypos)
 		xoffset *= sensitivity;
 		yoffset *= sensitivity;
 
-		rotateCamera(xoffset, yoffset);
+		simulation->AddCameraRotation(xoffset, yoffset);
 
 	}
 	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
@@ -378,10 +632,7 @@ void mainLoop(GLFWwindow* window)
 {
 	while (!glfwWindowShouldClose(window))
 	{
-		// Clear the colorbuffer
-		// glClearColor(backgroundColor.x, backgroundColor.y, backgroundColor.z, 1.0f);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Profiler::Get()->BeginFrame();
 
 		// Print avg fps
 		static double previousSeconds = glfwGetTime();
@@ -395,8 +646,18 @@ void mainLoop(GLFWwindow* window)
 
 			std::ostringstream outs;
 			outs.precision(3); // decimal places
+			Profiler* profiler = Profiler::Get();
 			outs << std::fixed
-				<< "FPS: " << fps << " Frame Time: " << msPerFrame << "(ms)";
+				<< "FPS: " << fps << " Frame Time: " << msPerFrame << "(ms)"
+				<< " p50/p95/p99: " << profiler->GetFrameTimePercentile(50) << "/" << profiler->GetFrameTimePercentile(95)
+				<< "/" << profiler->GetFrameTimePercentile(99) << "(ms)"
+				<< " Scale: " << dynamicResolution->GetScale()
+				<< " (" << dynamicResolution->GetRenderWidth() << "x" << dynamicResolution->GetRenderHeight() << ")";
+			if (sphere->mesh->GetLodCount() > 0)
+				outs << " LOD: " << sphere->lodLevel << " (" << sphere->mesh->GetLod(sphere->lodLevel).indexCount / 3 << " tris)";
+			if (reflectionProbesEnabled)
+				outs << " Probe faces: " << frameRenderer->GetReflectionProbeFacesDrawn() << " x "
+					<< frameRenderer->GetReflectionProbeFaceMilliseconds() << "(ms)";
 			// Append fps to window title
 			glfwSetWindowTitle(window, (windowTitle + " - " + outs.str()).c_str());
 
@@ -407,10 +668,24 @@ void mainLoop(GLFWwindow* window)
 		// Update
 		update();
 
-		// Draw game objects
+		// Draw game objects at the dynamic resolution, the tone mapping pass stretches them over the window
+		dynamicResolution->BeginFrame(WIDTH, HEIGHT);
+		frameRenderer->SetRenderSize(dynamicResolution->GetRenderWidth(), dynamicResolution->GetRenderHeight());
 		drawObjects();
+		dynamicResolution->EndFrame();
+
+		static bool firstFrame = true;
+		if (firstFrame)
+		{
+			glFinish();
+			reportStartupTime();
+			firstFrame = false;
+		}
 
-		glfwSwapBuffers(window);
+		{
+			PROFILE_CPU_SCOPE("SwapBuffers");
+			glfwSwapBuffers(window);
+		}
 		glfwPollEvents();
 	}
 }
@@ -510,10 +785,145 @@ void CreateWindow()
 	EnableGLDebugging();
 
 	init();
+	std::vector<std::string> sequenceFrames;
+	if (!sequenceDirectory.empty()) {
+		sequenceFrames = EnvironmentSequence::ListFrames(sequenceDirectory);
+		if (sequenceFrames.empty()) {
+			std::cerr << "No .hdr frames in " << sequenceDirectory << std::endl;
+		}
+	}
+	loadEnvironment(sequenceFrames.empty() ? hdriPath : sequenceFrames[0]);
+	if (!sequenceFrames.empty()) {
+		// Frame 0 is loaded already, it comes around again after the last one
+		std::rotate(sequenceFrames.begin(), sequenceFrames.begin() + 1, sequenceFrames.end());
+		environmentSequence = new EnvironmentSequence(sequenceFrames);
+		std::cout << "Environment sequence: " << sequenceFrames.size() << " frames at "
+			<< ENVIRONMENT_SEQUENCE_FRAME_RATE << " fps" << std::endl;
+	}
+
+	autoExposure = new AutoExposure(environmentRenderer->getExposure());
+	frameRenderer->SetAutoExposure(autoExposure);
+
+	// Fixed-timestep simulation, the main loop renders its interpolated snapshots
+	SimulationState initialState;
+	initialState.cameraPosition = mainCamera->getPosition();
+	initialState.sphereRotation = sphere->GetRotation();
+	simulation = new Simulation(initialState);
+	simulation->Start();
 
 	reshape(window, WIDTH, HEIGHT); // need to call this once ourselves
 	mainLoop(window); // this does not return unless the window is closed
 
+	simulation->Stop();
+	delete simulation;
+	delete environmentSequence;
+	delete dynamicResolution;
+	frameRenderer->SetAutoExposure(nullptr);
+	delete autoExposure;
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 }
+int RunBenchmark(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	if (!settings.parseArguments(argc, argv))
+		return EXIT_FAILURE;
+	for (int mode : settings.drawModes)
+	{
+		if (mode < LIGHT_PROBE || mode > SPECULAR_DISCO)
+		{
+			std::cerr << "Benchmark: draw modes are 1 to 5, got " << mode << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Sweep every environment map by default
+	if (settings.environmentPaths.empty())
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(hdriDirectory))
+		{
+			if (entry.path().extension() == ".hdr")
+				settings.environmentPaths.push_back(entry.path().string());
+		}
+		std::sort(settings.environmentPaths.begin(), settings.environmentPaths.end());
+	}
+
+	// EGL surfaceless first so it runs without a display server, hidden window otherwise
+	bool headless = CreateHeadlessContext();
+	if (!headless)
+	{
+		if (!glfwInit())
+		{
+			std::cout << "Failed to initialize GLFW" << std::endl;
+			return EXIT_FAILURE;
+		}
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		window = glfwCreateWindow(WIDTH, HEIGHT, windowTitle.c_str(), NULL, NULL);
+		if (!window)
+		{
+			glfwTerminate();
+			std::cout << "Failed to create window" << std::endl;
+			return EXIT_FAILURE;
+		}
+		glfwMakeContextCurrent(window);
+		glfwSwapInterval(0);
+	}
+
+	// GLEW looks for a GLX display first, which an EGL context does not have
+	glewExperimental = GL_TRUE;
+	int initState = glewInit();
+	if (initState != GLEW_OK && !(headless && initState == GLEW_ERROR_NO_GLX_DISPLAY))
+	{
+		std::cerr << "Error initializing GLEW: " << glewGetErrorString(initState) << ". Enum:" << initState << std::endl;
+		return EXIT_FAILURE;
+	}
+	glGetError(); // glewInit may leave an error behind
+	std::cout << "OpenGL renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+	init();
+
+	BenchmarkRunner runner;
+	runner.loadEnvironment = [](const std::string& path) {
+		// The configurations set the light count, the budget would only turn on the relaxation
+		loadEnvironment(path, false);
+	};
+	runner.applyConfig = [](int mode, int lightCount) {
+		drawMode = (DrawMode)mode;
+		iblSampler->changeNumLights(lightCount);
+		meshRenderer->SetLights(iblSampler->getLights());
+		updateSphereShader();
+	};
+	runner.renderFrame = [](int width, int height, float orbitAngle) {
+		// Orbit around the sphere at the starting camera distance
+		mainCamera->setAspectRatio((float)width / (float)height);
+		mainCamera->setPosition(Vector3(5.0f * sin(orbitAngle), 0.0f, 5.0f * cos(orbitAngle)));
+		mainCamera->setTarget(Vector3(0.0f, 0.0f, 0.0f));
+		meshRenderer->UpdateCameraUBO();
+
+		drawObjects();
+
+		static bool firstFrame = true;
+		if (firstFrame)
+		{
+			glFinish();
+			reportStartupTime();
+			firstFrame = false;
+		}
+	};
+	bool succeeded = runner.run(settings);
+
+	if (headless)
+	{
+		DestroyHeadlessContext();
+	}
+	else
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+	return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
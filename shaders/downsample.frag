@@ -0,0 +1,18 @@
+// Fragment Shader averaging 2x2 texels of the level above, AutoExposure's reduction, glsl
+
+#version 330 core
+
+uniform sampler2D source; // Twice the size of the target
+
+out vec4 fragColor;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    float sum = texelFetch(source, texel, 0).r
+        + texelFetch(source, texel + ivec2(1, 0), 0).r
+        + texelFetch(source, texel + ivec2(0, 1), 0).r
+        + texelFetch(source, texel + ivec2(1, 1), 0).r;
+
+    fragColor = vec4(sum * 0.25, 0.0, 0.0, 1.0);
+}
@@ -1,93 +1,52 @@
 #version 330 core
 
-#define MAX_LIGHTS 128
-
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-}; 
-
-struct LightSource {
-	vec3 position;
-	vec3 color;
-	float intensity;
-};
-
-layout (std140) uniform Lights
-{
-	int numLights;
-	LightSource lights[MAX_LIGHTS];
-};
+#include "include/lighting.glsl"
 
-uniform mat4 model;
-uniform samplerCube skybox;
-uniform Material material;
+uniform samplerCube irradianceMap; // Lambertian sum of the lights per normal, see IrradianceMap.h
 uniform float exposure;
-uniform bool specularEnabled;
 
 in vec3 fragEyePos;
 in vec4 fragWorldPos;
 in vec3 fragWorldNor;
 
-out vec4 fragColor;
+out vec4 fragColor; // Scene radiance, FrameRenderer tone maps it
 
-float km = 0.05; // Reflection coefficient
+const float km = 0.05; // Reflection coefficient
 
-float kd = 0.1; // Diffuse coefficient
-float ks = 0.5; // Specular coefficient
-int shininess = 32; // Shininess
+const float kd = 0.1; // Diffuse coefficient
+const float ks = 0.5; // Specular coefficient
+const int shininess = 32; // Shininess
 
 vec3 calculateLighting(vec3 normal, vec3 viewDir)
 {
-	vec3 result = vec3(0.0);
-	for (int i = 0; i < numLights; i++)
+	// The lambertian term of all lights only depends on the normal, it is baked
+	vec3 result = texture(irradianceMap, worldToEnvironment * normal).rgb * kd;
+#if SPECULAR_ENABLED
+	// Constant bound so the loop can be unrolled, numLights only ends it early
+	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
-		// Calculate the light direction
-		vec3 lightDir = normalize(fragWorldPos.xyz - lights[i].position);
-		vec3 halfDir = normalize(lightDir + viewDir);
-
-		// Calculate the lambertian factor
-		float lambertian = max(dot(lightDir, normal), 0.0);
-
-		// Calculate the specular factor, if enabled
-		float specular = 0.0;
-		if (specularEnabled)
+		if (i >= numLights)
 		{
-			specular = pow(max(dot(halfDir, normal), 0.0), shininess);
+			break;
 		}
 
+		// Distant light, it arrives from -position like in the baked irradiance
+		vec3 lightDir = normalize(-lights[i].position);
+		vec3 halfDir = normalize(lightDir + viewDir);
+
+		// Calculate the specular factor
+		float specular = pow(max(dot(halfDir, normal), 0.0), shininess);
+
 		// Calculate the light intensity
-		vec3 lightIntensity = lights[i].color * lights[i].intensity;
+		vec3 lightIntensity = lights[i].color;
 
 		// Calculate the final color
-		result += lambertian * lightIntensity * kd;
 		result += specular * lightIntensity * ks;
 	}
+#endif
 	
 	return result;
 }
-float luminance(vec3 color)
-{
-    return dot(color, vec3(0.2126, 0.7152, 0.0722));
-}
-vec3 tonemap(vec3 hdrColor, float exposure)
-{
-    vec3 meanColor = textureLod(skybox, vec3(0.5), 100.0).rgb;
-	// Calculate the luminance
-    float luminanceHdr = luminance(hdrColor);
-    float luminanceMean = luminance(meanColor);
-    float scaledLuminance = (luminanceHdr / luminanceMean) * exposure;
-
-    // Exposure tone mapping
-    vec3 mapped = vec3(1.0) - exp(-hdrColor * scaledLuminance);
-
-    // Gamma correction
-    mapped = pow(mapped, vec3(1.0/2.2));
-
-    return mapped;
-}
 
 void main(void)
 {
@@ -104,11 +63,8 @@ void main(void)
 	vec3 color = normalize(lightning) * exposure;
 
 	vec3 reflectionVector = reflect(viewDir, normal);
-	vec3 glossy = texture(skybox, reflectionVector).rgb * km;
-
-	// Tone mapping
-	vec3 finalColor = tonemap(color + glossy, exposure);
+	vec3 glossy = sampleReflection(reflectionVector) * km;
 
 	// Set the final color
-	fragColor = vec4(finalColor, 1.0);
+	fragColor = vec4(color + glossy, 1.0);
 }
@@ -0,0 +1,55 @@
+// Light and material declarations shared by the lit shaders, see ShaderProgram::preprocess
+// Permutation defines (ShaderLibrary):
+//   LIGHT_COUNT       upper bound of the light loops, the light count rounded up to a power of two
+//   SPECULAR_ENABLED  0 leaves only the baked lambertian term
+
+#define MAX_LIGHTS 128
+#define MAX_MATERIALS 256 // MeshRenderer.h
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT MAX_LIGHTS
+#endif
+
+#ifndef SPECULAR_ENABLED
+#define SPECULAR_ENABLED 1
+#endif
+
+// std140, shininess fills the padding after ambient (__material in MeshRenderer.h)
+struct Material {
+    vec3 ambient;
+    float shininess;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Inverse of the environment rotation. The cubemap, the irradiance map and the light extraction
+// are in environment space, world directions are turned into it before every lookup.
+uniform mat3 worldToEnvironment;
+
+// What reflections and refractions see: the object's reflection probe (rendered in world space,
+// worldToReflection is the identity) or the environment cubemap again (worldToEnvironment)
+uniform samplerCube reflectionMap;
+uniform mat3 worldToReflection;
+
+vec3 sampleReflection(vec3 direction)
+{
+    return texture(reflectionMap, worldToReflection * direction).rgb;
+}
+
+// The materials of the frame, lit.vert passes the index of the instance's one
+layout (std140) uniform Materials
+{
+	Material materials[MAX_MATERIALS];
+};
+
+// std140, the same layout as Light (Light.h), so the lights are uploaded with one copy
+struct LightSource {
+	vec3 position; // Unit vector, the direction is -position
+	vec3 color; // Intensity premultiplied
+};
+
+layout (std140) uniform Lights
+{
+	int numLights;
+	LightSource lights[MAX_LIGHTS];
+};
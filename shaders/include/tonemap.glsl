@@ -0,0 +1,38 @@
+// Tone mapping of the HDR scene, applied once per pixel by shaders/tonemap.frag (FrameRenderer)
+// Expects uniform samplerCube skybox to be declared before the include.
+// TONEMAP selects the variant:
+//   TONEMAP_NONE            hdrColor (displayColor) is returned unchanged
+//   TONEMAP_MEAN_LUMINANCE  exposure scaled by the luminance relative to the mean of the environment
+
+#define TONEMAP_NONE 0
+#define TONEMAP_MEAN_LUMINANCE 1
+
+#ifndef TONEMAP
+#define TONEMAP TONEMAP_MEAN_LUMINANCE
+#endif
+
+float luminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 tonemap(vec3 hdrColor, float exposure)
+{
+#if TONEMAP == TONEMAP_MEAN_LUMINANCE
+    vec3 meanColor = textureLod(skybox, vec3(0.5), 100.0).rgb;
+	// Calculate the luminance
+    float luminanceHdr = luminance(hdrColor);
+    float luminanceMean = luminance(meanColor);
+    float scaledLuminance = (luminanceHdr / luminanceMean) * exposure;
+
+    // Exposure tone mapping
+    vec3 mapped = vec3(1.0) - exp(-hdrColor * scaledLuminance);
+
+    // Gamma correction
+    mapped = pow(mapped, vec3(1.0/2.2));
+
+    return mapped;
+#else
+    return hdrColor;
+#endif
+}
@@ -1,40 +1,22 @@
 #version 330 core
 
-#define MAX_LIGHTS 128
-
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-}; 
-
-struct LightSource {
-	vec3 position;
-	vec3 color;
-	float intensity;
-};
-
-layout (std140) uniform Lights
-{
-	int numLights;
-	LightSource lights[MAX_LIGHTS];
-};
+#include "include/lighting.glsl"
 
-uniform mat4 model;
 uniform samplerCube skybox;
-uniform Material material;
+uniform samplerCube irradianceMap; // Lambertian sum of the lights per normal, see IrradianceMap.h
+uniform vec3 ambientLight; // Sum of the light colors, see MeshRenderer::SetLights
 
 in vec3 fragEyePos;
 in vec4 fragWorldPos;
 in vec3 fragWorldNor;
+flat in int fragMaterial;
 
 out vec4 fragColor;
 
 vec3 samleFromCubeMap(vec3 direction)
 {
 	// irradiance map
-	vec3 irradiance = texture(skybox, direction).rgb;
+	vec3 irradiance = texture(skybox, worldToEnvironment * direction).rgb;
 
 	// scale to keep the colors consistent
 	irradiance = irradiance * 0.1;
@@ -44,23 +26,34 @@ vec3 samleFromCubeMap(vec3 direction)
 
 vec3 calculateLighting(vec3 normal, vec3 viewDir)
 {
-	vec3 result = vec3(0.0);
-	for (int i = 0; i < numLights; i++)
+	Material material = materials[fragMaterial];
+
+	// The lambertian term only depends on the normal and the ambient one on nothing, both are
+	// computed once per light change
+	vec3 result = material.diffuse * texture(irradianceMap, worldToEnvironment * normal).rgb;
+	result += material.ambient * ambientLight;
+#if SPECULAR_ENABLED
+	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
-		// Calculate the light direction
-		vec3 lightDir = normalize(lights[i].position - fragWorldPos.xyz);
+		if (i >= numLights)
+		{
+			break;
+		}
+
+		// Distant light, it arrives from -position like in the baked irradiance
+		vec3 lightDir = normalize(-lights[i].position);
 		vec3 halfDir = normalize(lightDir + viewDir);
 
-		// Calculate the lambertian factor
-		float lambertian = max(dot(lightDir, normal), 0.0);
+		// Calculate the specular factor
 		float specular = pow(max(dot(halfDir, normal), 0.0), material.shininess);
 
 		// Calculate the light intensity
-		vec3 lightIntensity = lights[i].color * lights[i].intensity;
+		vec3 lightIntensity = lights[i].color;
 
 		// Calculate the final color
-		result += (material.ambient + material.diffuse * lambertian + material.specular * specular) * lightIntensity;
+		result += material.specular * specular * lightIntensity;
 	}
+#endif
 	
 	return result;
 }
@@ -77,9 +70,9 @@ void main(void)
 	vec3 lightning = calculateLighting(normal, viewDir);
 
 	// Calculate the final color
-	vec3 color = normalize(lightning);
+	vec3 color = lightning;
 
-	// Set the final color
+	// Set the final color, radiance for FrameRenderer's tone mapping
 	fragColor = vec4(color, 1.0);
 
 }
@@ -7,27 +7,33 @@ layout (std140) uniform CameraMatrices
 	vec3 eyePos;
 }; 
 
-uniform mat4 model;
-
 layout(location=0) in vec3 inVertex; // the position of the fragment in world space
 layout(location=1) in vec3 inNormal; // normal in world space
 layout(location=2) in vec2 inTexCoords; // texture coordinates
+// Per instance, from the transform system
+layout(location=3) in mat4 instanceModel; // locations 3-6
+layout(location=7) in mat3 instanceNormal; // transpose(inverse(mat3(model))), locations 7-9
+layout(location=10) in int instanceMaterial; // index into the Materials block
 
 out vec3 fragEyePos; // the position of the eye in world space
 out vec4 fragWorldPos; // the position of the fragment in world space
 out vec3 fragWorldNor; // the normal of the fragment in world space
+flat out int fragMaterial; // index of the material in the Materials block
 
 void main(void)
 {
 	// Pass the eye position
 	fragEyePos = eyePos;
 
+	// Pass the material
+	fragMaterial = instanceMaterial;
+
 	// Pass the world position
-	fragWorldPos = model * vec4(inVertex, 1.0);
+	fragWorldPos = instanceModel * vec4(inVertex, 1.0);
 
 	// Pass the vertex position to the fragment shader
 	gl_Position = projection * view * fragWorldPos;
 
 	// Pass the world normal
-	fragWorldNor = normalize(mat3(transpose(inverse(model))) * inNormal);
+	fragWorldNor = normalize(instanceNormal * inNormal);
 }
\ No newline at end of file
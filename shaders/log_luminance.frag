@@ -0,0 +1,28 @@
+// Fragment Shader writing the log luminance of the HDR scene for AutoExposure, glsl
+
+#version 330 core
+
+uniform sampler2D scene; // RGBA16F radiance, the bottom left sceneSize texels are the frame
+uniform samplerCube skybox; // Environment cubemap, the mean luminance of the tone mapping
+uniform vec2 sceneSize;
+
+in vec2 TexCoords;
+out vec4 fragColor;
+
+#include "include/tonemap.glsl"
+
+const float MIN_ARGUMENT = 1.0e-4; // Black pixels would pull the average down without bound
+
+void main()
+{
+    vec4 hdrColor = texelFetch(scene, ivec2(TexCoords * sceneSize), 0);
+    vec3 color = mix(min(hdrColor.rgb, vec3(65504.0)), vec3(0.0), isnan(hdrColor.rgb));
+
+    // tonemap() takes exp() of -color * exposure * luminance / mean, per unit exposure the
+    // argument at the pixel's luminance is luminance * luminance / mean
+    float luminanceHdr = luminance(color);
+    float luminanceMean = luminance(textureLod(skybox, vec3(0.5), 100.0).rgb);
+    float argument = luminanceHdr * luminanceHdr / luminanceMean;
+
+    fragColor = vec4(log(max(argument, MIN_ARGUMENT)), 0.0, 0.0, 1.0);
+}
@@ -1,23 +1,24 @@
 // Vertex Shader for skybox with cubemap, glsl
+// One fullscreen triangle at the far plane (drawn with glDrawArrays(GL_TRIANGLES, 0, 3), no vertex buffer).
+// The view direction of each corner comes from the inverse view-projection without translation.
 
 #version 330 core
 
-layout(location = 0) in vec3 inVertex;
-
-uniform mat4 projection;
-uniform mat4 view;
-uniform vec3 eyePos;
+uniform mat4 inverseViewProjection;
 
 out vec3 texCoord;
 
 void main()
 {
-    // calculate model matrix from eyePos
-    mat4 modeling = mat4(1.0);
-    modeling[3] = vec4(eyePos, 1.0);
-    
-    texCoord = inVertex;
-    gl_Position = projection * view * modeling * vec4(inVertex, 1.0);
+    float x = float((gl_VertexID & 1) << 2) - 1.0;
+    float y = float((gl_VertexID & 2) << 1) - 1.0;
+
+    // Directions on the far plane are linear in screen space, so interpolating them is exact
+    vec4 farPoint = inverseViewProjection * vec4(x, y, 1.0, 1.0);
+    texCoord = farPoint.xyz / farPoint.w;
+
+    // z = w puts the triangle at depth 1.0, the GL_LEQUAL test keeps it behind all geometry
+    gl_Position = vec4(x, y, 1.0, 1.0);
 }
 
-// Path: /shaders/skybox.vert
\ No newline at end of file
+// Path: /shaders/skybox.vert
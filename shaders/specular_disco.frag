@@ -1,66 +1,29 @@
 #version 330 core
 
-#define MAX_LIGHTS 128
-
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-}; 
-
-struct LightSource {
-	vec3 position; // Direction is -position
-	vec3 color;
-	float intensity;
-};
-
-layout (std140) uniform Lights
-{
-	int numLights;
-	LightSource lights[MAX_LIGHTS];
-};
+#include "include/lighting.glsl"
 
-uniform mat4 model;
 uniform samplerCube skybox;
-uniform Material material;
-uniform float exposure;
 
 in vec3 fragEyePos;
 in vec4 fragWorldPos;
 in vec3 fragWorldNor;
 
+// Radiance of the highlights, FrameRenderer's tone mapping pass maps it to the display
 out vec4 fragColor;
 
-float ks = 1; // Specular coefficient
-int shininess = 16000; // Shininess
-
-float luminance(vec3 color)
-{
-    return dot(color, vec3(0.2126, 0.7152, 0.0722));
-}
-vec3 tonemap(vec3 hdrColor, float exposure)
-{
-    vec3 meanColor = textureLod(skybox, vec3(0.5), 100.0).rgb;
-	// Calculate the luminance
-    float luminanceHdr = luminance(hdrColor);
-    float luminanceMean = luminance(meanColor);
-    float scaledLuminance = (luminanceHdr / luminanceMean) * exposure;
-
-    // Exposure tone mapping
-    vec3 mapped = vec3(1.0) - exp(-hdrColor * scaledLuminance);
-
-    // Gamma correction
-    mapped = pow(mapped, vec3(1.0/2.2));
-
-    return mapped;
-}
+const float ks = 1.0; // Specular coefficient
+const int shininess = 16000; // Shininess
 
 vec3 calculateLighting(vec3 normal, vec3 viewDir)
 {
 	vec3 result = vec3(0.0);
-	for (int i = 0; i < numLights; i++)
+	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
+		if (i >= numLights)
+		{
+			break;
+		}
+
 		// Calculate the light direction
 		vec3 lightDir = normalize(-lights[i].position);
 		vec3 halfDir = normalize(lightDir + viewDir);
@@ -69,7 +32,7 @@ vec3 calculateLighting(vec3 normal, vec3 viewDir)
 		if(specular == 0.0) continue;
 
 		// Calculate the light intensity
-		vec3 lightIntensity = lights[i].color * lights[i].intensity;
+		vec3 lightIntensity = lights[i].color;
 		// lightIntensity /= (vec3(1) + lightIntensity); // Normalize the light intensity
 		// lightIntensity = tonemap(lightIntensity, exposure);
 		
@@ -94,8 +57,7 @@ void main(void)
 	vec3 lightning = calculateLighting(normal, viewDir);
 
 	// Calculate the final color
-	vec3 color = normalize(lightning) * exposure;
-	// color = tonemap(color, exposure);
+	vec3 color = lightning;
 
 	// vec3 reflectionVector = reflect(normalize(-viewDir), normalize(fragWorldNor));
 
@@ -0,0 +1,62 @@
+// Fragment Shader that tone maps the HDR scene once per pixel, glsl
+
+#version 330 core
+
+uniform sampler2D scene; // RGBA16F radiance
+uniform samplerCube skybox; // Environment cubemap, its smallest mip is the mean color
+uniform float exposure;
+uniform vec2 uvScale; // Rendered part of the scene target / target size
+uniform vec2 uvMax;   // Center of the last rendered texel, the bilinear filter stays inside the rendered part
+#ifdef UPSCALE
+uniform vec2 texelSize;  // 1 / scene target size
+uniform float sharpness; // 0: plain bilinear stretch, 1: the full unsharp mask
+#endif
+
+in vec2 TexCoords;
+out vec4 fragColor;
+/*
+    The tone mapping is done per fragment as follows:
+        – exp() of the HDR RGB texture color is first calculated after getting it from the texture.
+        – The scene’s mean HDR RGB value is found by calling textureLod() function
+            with a high number as the argument so that a 1x1 mipmap (mean HDR RGB)
+            of the image is looked-up by this call automatically in shader (of course, we take
+            exp() of this looked-up value, too). We should generate mipmaps of the rendered scene’s texture by calling glGenerateMipmap(GL TEXTURE 2D) and
+            glTextureBarrier() before rendering the quad.
+        – A scaled luminance is calculated by dividing the luminance of the exp()-applied
+            HDR RGB texture value by the mean luminance and then multiplying with
+            the exposure uniform. Luminances are found by interpolating the RGB’s by
+            (0.2126, 0.7152, 0.0722).
+        – The rest of the tone map code lines are the same as the code in the slides.
+*/
+#include "include/tonemap.glsl"
+
+vec3 sceneRadiance(vec2 uv)
+{
+    vec3 radiance = texture(scene, clamp(uv, vec2(0.0), uvMax)).rgb;
+    // Radiance above the half float range was stored as infinity. NaN (normalize() of no light at
+    // all) comes out black, as it did when the shaders wrote to the 8 bit framebuffer.
+    return mix(min(radiance, vec3(65504.0)), vec3(0.0), isnan(radiance));
+}
+
+void main()
+{
+    // One scene texel per pixel at full resolution
+    vec2 uv = TexCoords * uvScale;
+    vec3 color = sceneRadiance(uv);
+#ifdef UPSCALE
+    // Dynamic resolution: the bilinear stretch blurs edges over the stretched texels. An unsharp
+    // mask on the four neighbours one texel away restores them, clamped to the neighbourhood so
+    // edges do not ring.
+    vec3 north = sceneRadiance(uv + vec2(0.0, texelSize.y));
+    vec3 south = sceneRadiance(uv - vec2(0.0, texelSize.y));
+    vec3 east = sceneRadiance(uv + vec2(texelSize.x, 0.0));
+    vec3 west = sceneRadiance(uv - vec2(texelSize.x, 0.0));
+    vec3 low = min(color, min(min(north, south), min(east, west)));
+    vec3 high = max(color, max(max(north, south), max(east, west)));
+    vec3 sharpened = color + sharpness * (color - 0.25 * (north + south + east + west));
+    color = clamp(sharpened, low, high);
+#endif
+    color = tonemap(color, exposure);
+
+    fragColor = vec4(color, 1.0);
+}
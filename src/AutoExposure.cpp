@@ -0,0 +1,154 @@
+// AutoExposure.cpp
+#include "AutoExposure.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include <cassert>
+#include <cmath>
+
+AutoExposure::AutoExposure(float exposure)
+	: exposure(exposure)
+{
+	for (int size = AUTO_EXPOSURE_SIZE; size >= 1; size /= 2) {
+		Texture* level = Texture::CreateRenderTexture(size, size, GL_R32F);
+		level->setName("auto exposure level");
+		levels.push_back(level);
+		levelFramebuffers.push_back(Framebuffer::CreateFramebuffer(size, size, level));
+	}
+	luminanceShader = new ShaderProgram("shaders/fullscreen.vert", "shaders/log_luminance.frag");
+	downsampleShader = new ShaderProgram("shaders/fullscreen.vert", "shaders/downsample.frag");
+	glGenVertexArrays(1, &fullscreenVAO);
+
+	glGenBuffers(AUTO_EXPOSURE_READBACK_FRAMES, pixelBuffers);
+	for (int i = 0; i < AUTO_EXPOSURE_READBACK_FRAMES; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), nullptr, GL_STREAM_READ);
+		ResourceRegistry::Get()->Track(RESOURCE_BUFFER, pixelBuffers[i], "auto exposure readback", sizeof(float));
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+AutoExposure::~AutoExposure()
+{
+	for (int i = 0; i < AUTO_EXPOSURE_READBACK_FRAMES; i++) {
+		if (fences[i] != nullptr) {
+			glDeleteSync(fences[i]);
+		}
+	}
+	for (int i = 0; i < AUTO_EXPOSURE_READBACK_FRAMES; i++) {
+		ResourceRegistry::Get()->Release(RESOURCE_BUFFER, pixelBuffers[i]);
+	}
+	glDeleteBuffers(AUTO_EXPOSURE_READBACK_FRAMES, pixelBuffers);
+	for (size_t i = 0; i < levels.size(); i++) {
+		delete levelFramebuffers[i];
+		delete levels[i];
+	}
+	delete luminanceShader;
+	delete downsampleShader;
+	glDeleteVertexArrays(1, &fullscreenVAO);
+}
+
+void AutoExposure::SetExposure(float exposure)
+{
+	this->exposure = glm::clamp(exposure, AUTO_EXPOSURE_MIN, AUTO_EXPOSURE_MAX);
+}
+
+// Takes the measurements whose fences passed, oldest first, without waiting for the others
+void AutoExposure::readBack()
+{
+	while (pendingReadbacks > 0) {
+		int index = (nextReadback - pendingReadbacks + AUTO_EXPOSURE_READBACK_FRAMES) % AUTO_EXPOSURE_READBACK_FRAMES;
+		GLenum status = glClientWaitSync(fences[index], 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(fences[index]);
+		fences[index] = nullptr;
+		pendingReadbacks--;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[index]);
+		const float* value = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float), GL_MAP_READ_BIT);
+		if (value != nullptr && std::isfinite(*value)) {
+			averageLog = *value;
+			measured = true;
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+}
+
+float AutoExposure::Update()
+{
+	PROFILE_CPU_SCOPE("AutoExposure");
+
+	readBack();
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	float seconds = updated ? std::chrono::duration<float>(now - lastUpdate).count() : 0.0f;
+	lastUpdate = now;
+	updated = true;
+	if (!measured) {
+		return exposure;
+	}
+
+	// The tone mapping argument of the geometric mean is exposure * exp(averageLog)
+	float target = glm::clamp(compensation * AUTO_EXPOSURE_KEY / std::exp(averageLog), AUTO_EXPOSURE_MIN, AUTO_EXPOSURE_MAX);
+	float blend = 1.0f - std::exp(-seconds / AUTO_EXPOSURE_ADAPTATION_SECONDS);
+	exposure = std::exp(glm::mix(std::log(exposure), std::log(target), blend));
+	return exposure;
+}
+
+void AutoExposure::Measure(Texture* scene, int width, int height, Texture* environmentCubemap)
+{
+	if (pendingReadbacks == AUTO_EXPOSURE_READBACK_FRAMES) {
+		return; // The GPU is that far behind, this frame is not metered
+	}
+
+	PROFILE_GPU_SCOPE("AutoExposure");
+
+	GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(fullscreenVAO);
+
+	// Log luminance, one scene texel per metering texel
+	levelFramebuffers[0]->bind();
+	glViewport(0, 0, AUTO_EXPOSURE_SIZE, AUTO_EXPOSURE_SIZE);
+	luminanceShader->use();
+	glActiveTexture(GL_TEXTURE0 + AUTO_EXPOSURE_SCENE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, scene->getID());
+	glActiveTexture(GL_TEXTURE0 + AUTO_EXPOSURE_ENVIRONMENT_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, environmentCubemap->getID());
+	luminanceShader->setSampler2D("scene", AUTO_EXPOSURE_SCENE_TEXTURE_UNIT);
+	luminanceShader->setSamplerCube("skybox", AUTO_EXPOSURE_ENVIRONMENT_TEXTURE_UNIT);
+	luminanceShader->setVec2("sceneSize", Vector2((float)width, (float)height));
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	// Every level averages 2x2 texels of the one before
+	downsampleShader->use();
+	glActiveTexture(GL_TEXTURE0 + AUTO_EXPOSURE_SCENE_TEXTURE_UNIT);
+	downsampleShader->setSampler2D("source", AUTO_EXPOSURE_SCENE_TEXTURE_UNIT);
+	for (size_t i = 1; i < levels.size(); i++) {
+		levelFramebuffers[i]->bind();
+		glViewport(0, 0, levels[i]->getWidth(), levels[i]->getHeight());
+		glBindTexture(GL_TEXTURE_2D, levels[i - 1]->getID());
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	downsampleShader->unuse();
+	glBindVertexArray(0);
+
+	// Copy the average into a pixel buffer, Update reads it once the fence passed
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, levelFramebuffers.back()->getID());
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[nextReadback]);
+	glReadPixels(0, 0, 1, 1, GL_RED, GL_FLOAT, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fences[nextReadback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextReadback = (nextReadback + 1) % AUTO_EXPOSURE_READBACK_FRAMES;
+	pendingReadbacks++;
+
+	if (depthTestEnabled) {
+		glEnable(GL_DEPTH_TEST);
+	}
+	assert(glGetError() == GL_NO_ERROR);
+}
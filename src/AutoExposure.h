@@ -0,0 +1,74 @@
+// AutoExposure.h
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include "typedefs.h"
+#include "Texture.h"
+#include "Framebuffer.h"
+#include "ShaderProgram.h"
+#include <GL/glew.h>
+#include <chrono>
+#include <vector>
+
+const int AUTO_EXPOSURE_SIZE = 256; // The scene is metered at this many texels per side, a power of two
+const int AUTO_EXPOSURE_READBACK_FRAMES = 3; // Pixel buffers in flight, a measurement is skipped when all are
+// Tone mapping argument the geometric mean of the scene is brought to, 1 - exp(-0.198) = 0.18 (middle grey)
+const float AUTO_EXPOSURE_KEY = 0.198f;
+const float AUTO_EXPOSURE_ADAPTATION_SECONDS = 0.5f; // Time constant of the adaptation
+const float AUTO_EXPOSURE_MIN = 1.0e-3f;
+const float AUTO_EXPOSURE_MAX = 1.0e3f;
+const int AUTO_EXPOSURE_SCENE_TEXTURE_UNIT = 0;
+const int AUTO_EXPOSURE_ENVIRONMENT_TEXTURE_UNIT = 1;
+
+// Chooses the exposure from the rendered frame instead of the W/S keys.
+//
+// Measure meters the HDR scene with fragment passes: the log of the tone mapping argument per unit
+// exposure (luminance * luminance / mean luminance, see tonemap.glsl) is written into an
+// AUTO_EXPOSURE_SIZE square target, then halved until 1x1, which holds the average log. That
+// texel is copied into a pixel buffer behind a fence and read a frame or more later, once the
+// fence has passed, so the CPU never waits for the GPU.
+//
+// Update adapts the exposure towards the one that maps the geometric mean to AUTO_EXPOSURE_KEY,
+// exponentially in log space with AUTO_EXPOSURE_ADAPTATION_SECONDS.
+class AutoExposure {
+public:
+	AutoExposure(float exposure);
+	~AutoExposure();
+
+	// Multiplies the target exposure, e.g. 2 for one stop brighter
+	void SetCompensation(float compensation) { this->compensation = compensation; }
+	float GetCompensation() const { return compensation; }
+	float GetExposure() const { return exposure; }
+	// Jumps to an exposure, e.g. after a manual change, adaptation goes on from there
+	void SetExposure(float exposure);
+
+	// Reads back the finished measurements and adapts the exposure to the newest one by the time
+	// since the last call. Returns the exposure to render the next frame with.
+	float Update();
+	// Meters the bottom left width x height texels of scene, an RGBA16F radiance texture. The
+	// environment cubemap gives the mean luminance like in the tone mapping pass.
+	void Measure(Texture* scene, int width, int height, Texture* environmentCubemap);
+
+private:
+	float exposure;
+	float compensation = 1.0f;
+	float averageLog = 0.0f; // Newest measurement
+	bool measured = false;
+	std::chrono::steady_clock::time_point lastUpdate;
+	bool updated = false;
+
+	std::vector<Texture*> levels; // AUTO_EXPOSURE_SIZE down to 1, R32F
+	std::vector<Framebuffer*> levelFramebuffers;
+	ShaderProgram* luminanceShader;
+	ShaderProgram* downsampleShader;
+	GLuint fullscreenVAO;
+
+	GLuint pixelBuffers[AUTO_EXPOSURE_READBACK_FRAMES] = {};
+	GLsync fences[AUTO_EXPOSURE_READBACK_FRAMES] = {};
+	int nextReadback = 0; // Pixel buffer the next measurement goes to, they are read in the same order
+	int pendingReadbacks = 0;
+
+	void readBack();
+};
+
+#endif
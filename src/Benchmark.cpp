@@ -0,0 +1,299 @@
+// Benchmark.cpp
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "ResourceRegistry.h"
+#include "utils.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	std::vector<std::string> splitList(const char* text)
+	{
+		std::vector<std::string> items;
+		std::stringstream ss(text);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			if (!item.empty()) {
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+}
+
+double BenchmarkResult::getPercentile(const std::vector<double>& times, double p) const
+{
+	if (times.empty()) {
+		return 0.0;
+	}
+	std::vector<double> sorted(times);
+	size_t index = std::min(sorted.size() - 1, (size_t)(p / 100.0 * sorted.size()));
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+double BenchmarkResult::getMean(const std::vector<double>& times) const
+{
+	if (times.empty()) {
+		return 0.0;
+	}
+	double sum = 0.0;
+	for (double time : times) {
+		sum += time;
+	}
+	return sum / times.size();
+}
+
+double BenchmarkResult::getStandardDeviation(const std::vector<double>& times) const
+{
+	if (times.size() < 2) {
+		return 0.0;
+	}
+	double mean = getMean(times);
+	double sum = 0.0;
+	for (double time : times) {
+		sum += (time - mean) * (time - mean);
+	}
+	return sqrt(sum / (times.size() - 1));
+}
+
+bool BenchmarkSettings::parseArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strcmp(argument, "--benchmark") == 0) {
+			continue;
+		}
+		if (i + 1 >= argc) {
+			std::cerr << "Benchmark: missing value for " << argument << std::endl;
+			return false;
+		}
+		const char* value = argv[++i];
+
+		if (strcmp(argument, "--frames") == 0) {
+			frameCount = std::max(1, atoi(value));
+		}
+		else if (strcmp(argument, "--warmup") == 0) {
+			warmupFrames = std::max(0, atoi(value));
+		}
+		else if (strcmp(argument, "--maps") == 0) {
+			environmentPaths = splitList(value);
+		}
+		else if (strcmp(argument, "--modes") == 0) {
+			drawModes.clear();
+			for (const std::string& mode : splitList(value)) {
+				drawModes.push_back(atoi(mode.c_str()));
+			}
+		}
+		else if (strcmp(argument, "--lights") == 0) {
+			lightCounts.clear();
+			for (const std::string& count : splitList(value)) {
+				lightCounts.push_back(atoi(count.c_str()));
+			}
+		}
+		else if (strcmp(argument, "--resolutions") == 0) {
+			resolutions.clear();
+			for (const std::string& resolution : splitList(value)) {
+				glm::ivec2 size(0);
+				if (sscanf(resolution.c_str(), "%dx%d", &size.x, &size.y) != 2 || size.x <= 0 || size.y <= 0) {
+					std::cerr << "Benchmark: invalid resolution " << resolution << std::endl;
+					return false;
+				}
+				resolutions.push_back(size);
+			}
+		}
+		else if (strcmp(argument, "--output") == 0) {
+			outputPrefix = value;
+		}
+		else {
+			std::cerr << "Benchmark: unknown argument " << argument << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void BenchmarkRunner::createRenderTarget(int width, int height)
+{
+	destroyRenderTarget();
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	ResourceRegistry::Get()->Track(RESOURCE_RENDERBUFFER, colorBuffer, "benchmark color", ResourceRegistry::TextureBytes(GL_RGBA8, width, height));
+	ResourceRegistry::Get()->Track(RESOURCE_RENDERBUFFER, depthBuffer, "benchmark depth", ResourceRegistry::TextureBytes(GL_DEPTH_COMPONENT24, width, height));
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void BenchmarkRunner::destroyRenderTarget()
+{
+	if (framebuffer != 0) {
+		ResourceRegistry::Get()->Release(RESOURCE_RENDERBUFFER, colorBuffer);
+		ResourceRegistry::Get()->Release(RESOURCE_RENDERBUFFER, depthBuffer);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colorBuffer);
+		glDeleteRenderbuffers(1, &depthBuffer);
+		framebuffer = colorBuffer = depthBuffer = 0;
+	}
+}
+
+bool BenchmarkRunner::run(const BenchmarkSettings& settings)
+{
+	assert(loadEnvironment && applyConfig && renderFrame);
+	if (settings.environmentPaths.empty()) {
+		std::cerr << "Benchmark: no environment maps to run with" << std::endl;
+		return false;
+	}
+
+	results.clear();
+	glGenQueries(2, timerQueries);
+
+	size_t configCount = settings.environmentPaths.size() * settings.resolutions.size()
+		* settings.lightCounts.size() * settings.drawModes.size();
+	std::cout << "Benchmark: " << configCount << " configurations, "
+		<< settings.warmupFrames << " warmup + " << settings.frameCount << " frames each" << std::endl;
+
+	// Environment maps are the most expensive to switch, so they are the outermost loop
+	for (const std::string& environmentPath : settings.environmentPaths) {
+		loadEnvironment(environmentPath);
+
+		for (const glm::ivec2& resolution : settings.resolutions) {
+			createRenderTarget(resolution.x, resolution.y);
+
+			for (int lightCount : settings.lightCounts) {
+				for (int drawMode : settings.drawModes) {
+					applyConfig(drawMode, lightCount);
+
+					BenchmarkResult result;
+					result.config = { environmentPath, drawMode, lightCount, resolution.x, resolution.y };
+					result.frameTimes.reserve(settings.frameCount);
+					result.gpuTimes.reserve(settings.frameCount);
+
+					glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+					glViewport(0, 0, resolution.x, resolution.y);
+
+					for (int frame = -settings.warmupFrames; frame < settings.frameCount; frame++) {
+						// The orbit only depends on the frame number, every run sees the same views
+						float orbitAngle = 2.0f * glm::pi<float>() * std::max(frame, 0) / settings.frameCount;
+
+						Profiler::Get()->BeginFrame();
+						auto start = std::chrono::steady_clock::now();
+						glQueryCounter(timerQueries[0], GL_TIMESTAMP);
+						renderFrame(resolution.x, resolution.y, orbitAngle);
+						glQueryCounter(timerQueries[1], GL_TIMESTAMP);
+						glFinish();
+						auto end = std::chrono::steady_clock::now();
+
+						if (frame >= 0) {
+							GLuint64 gpuStart = 0, gpuEnd = 0;
+							glGetQueryObjectui64v(timerQueries[0], GL_QUERY_RESULT, &gpuStart);
+							glGetQueryObjectui64v(timerQueries[1], GL_QUERY_RESULT, &gpuEnd);
+							result.frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+							result.gpuTimes.push_back((gpuEnd - gpuStart) / 1.0e6);
+						}
+					}
+					assert(glGetError() == GL_NO_ERROR);
+
+					std::cout << std::fixed << std::setprecision(3)
+						<< environmentPath << " " << resolution.x << "x" << resolution.y
+						<< " mode " << drawMode << " lights " << std::setw(3) << lightCount
+						<< ": p50 " << result.getPercentile(result.frameTimes, 50)
+						<< " ms, p99 " << result.getPercentile(result.frameTimes, 99) << " ms" << std::endl;
+					results.push_back(result);
+				}
+			}
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	destroyRenderTarget();
+	glDeleteQueries(2, timerQueries);
+
+	bool written = writeCsv(settings.outputPrefix + ".csv") && writeJson(settings.outputPrefix + ".json");
+	if (written) {
+		std::cout << "Benchmark: results written to " << settings.outputPrefix << ".csv/.json" << std::endl;
+	}
+	return written;
+}
+
+bool BenchmarkRunner::writeCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "Benchmark: unable to open " << path << std::endl;
+		return false;
+	}
+
+	file << "environment,mode,lights,width,height,frames,"
+		"min_ms,mean_ms,stddev_ms,p50_ms,p90_ms,p95_ms,p99_ms,max_ms,gpu_mean_ms,gpu_p50_ms,gpu_p99_ms\n";
+	file << std::fixed << std::setprecision(4);
+	for (const BenchmarkResult& result : results) {
+		const std::vector<double>& times = result.frameTimes;
+		file << result.config.environmentPath << "," << result.config.drawMode << "," << result.config.lightCount << ","
+			<< result.config.width << "," << result.config.height << "," << times.size() << ","
+			<< result.getPercentile(times, 0) << "," << result.getMean(times) << "," << result.getStandardDeviation(times) << ","
+			<< result.getPercentile(times, 50) << "," << result.getPercentile(times, 90) << ","
+			<< result.getPercentile(times, 95) << "," << result.getPercentile(times, 99) << ","
+			<< result.getPercentile(times, 100) << ","
+			<< result.getMean(result.gpuTimes) << "," << result.getPercentile(result.gpuTimes, 50) << ","
+			<< result.getPercentile(result.gpuTimes, 99) << "\n";
+	}
+	return file.good();
+}
+
+bool BenchmarkRunner::writeJson(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "Benchmark: unable to open " << path << std::endl;
+		return false;
+	}
+
+	auto writeArray = [&file](const std::vector<double>& values) {
+		file << "[";
+		for (size_t i = 0; i < values.size(); i++) {
+			file << (i > 0 ? "," : "") << values[i];
+		}
+		file << "]";
+	};
+
+	file << std::fixed << std::setprecision(4);
+	file << "{\n\"renderer\": \"" << EscapeJson((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	file << "\"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& result = results[i];
+		file << "{\"environment\": \"" << EscapeJson(result.config.environmentPath) << "\""
+			<< ", \"mode\": " << result.config.drawMode
+			<< ", \"lights\": " << result.config.lightCount
+			<< ", \"width\": " << result.config.width
+			<< ", \"height\": " << result.config.height
+			<< ", \"p50_ms\": " << result.getPercentile(result.frameTimes, 50)
+			<< ", \"p95_ms\": " << result.getPercentile(result.frameTimes, 95)
+			<< ", \"p99_ms\": " << result.getPercentile(result.frameTimes, 99)
+			<< ",\n \"frame_ms\": ";
+		writeArray(result.frameTimes);
+		file << ",\n \"gpu_ms\": ";
+		writeArray(result.gpuTimes);
+		file << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "]\n}\n";
+	return file.good();
+}
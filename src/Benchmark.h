@@ -0,0 +1,73 @@
+// Benchmark.h
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "typedefs.h"
+#include <GL/glew.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// One point of the sweep
+struct BenchmarkConfig
+{
+	std::string environmentPath;
+	int drawMode;
+	int lightCount;
+	int width, height;
+};
+
+struct BenchmarkResult
+{
+	BenchmarkConfig config;
+	std::vector<double> frameTimes; // Milliseconds, CPU submit + glFinish
+	std::vector<double> gpuTimes; // Milliseconds, between two GL_TIMESTAMP queries
+
+	double getPercentile(const std::vector<double>& times, double p) const;
+	double getMean(const std::vector<double>& times) const;
+	double getStandardDeviation(const std::vector<double>& times) const;
+};
+
+struct BenchmarkSettings
+{
+	int warmupFrames = 10;
+	int frameCount = 120; // One full camera orbit
+	std::vector<std::string> environmentPaths; // Every .hdr in the environment directory when empty
+	std::vector<int> drawModes = { 1, 2, 3, 4, 5 };
+	std::vector<int> lightCounts = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	std::vector<glm::ivec2> resolutions = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+	std::string outputPrefix = "benchmark_results"; // Writes <prefix>.csv and <prefix>.json
+
+	// --frames N --warmup N --maps a.hdr,b.hdr --modes 1,2 --lights 1,8,128
+	// --resolutions 640x360,1920x1080 --output prefix
+	bool parseArguments(int argc, char** argv);
+};
+
+// Replays a scripted camera orbit for every configuration of the sweep into an offscreen
+// framebuffer and records per-frame times. The scene is driven through the hooks so the
+// runner does not depend on how the application sets it up.
+class BenchmarkRunner
+{
+public:
+	std::function<void(const std::string& environmentPath)> loadEnvironment;
+	std::function<void(int drawMode, int lightCount)> applyConfig;
+	std::function<void(int width, int height, float orbitAngle)> renderFrame; // orbitAngle in radians
+
+	bool run(const BenchmarkSettings& settings);
+
+	const std::vector<BenchmarkResult>& getResults() const { return results; }
+
+private:
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+	GLuint timerQueries[2] = { 0, 0 }; // Timestamps, so they do not clash with the profiler's elapsed queries
+	std::vector<BenchmarkResult> results;
+
+	void createRenderTarget(int width, int height);
+	void destroyRenderTarget();
+	bool writeCsv(const std::string& path) const;
+	bool writeJson(const std::string& path) const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+// DynamicResolution.cpp
+#include "DynamicResolution.h"
+#include <cassert>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(float targetMilliseconds)
+	: targetMilliseconds(targetMilliseconds)
+{
+	glGenQueries(2 * DYNAMIC_RESOLUTION_QUERY_FRAMES, &timerQueries[0][0]);
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	glDeleteQueries(2 * DYNAMIC_RESOLUTION_QUERY_FRAMES, &timerQueries[0][0]);
+}
+
+void DynamicResolution::SetTargetFrameTime(float milliseconds)
+{
+	assert(milliseconds > 0.0f);
+	targetMilliseconds = milliseconds;
+}
+
+void DynamicResolution::SetEnabled(bool enabled)
+{
+	this->enabled = enabled;
+	// The measurements in flight were taken at the other resolution
+	for (int i = 0; i < DYNAMIC_RESOLUTION_QUERY_FRAMES; i++) {
+		queryIssued[i] = false;
+	}
+	gpuMilliseconds = -1.0f;
+}
+
+// Takes the scene time of a slot once the GPU got to its end, without waiting for it
+void DynamicResolution::readTimings(int slot)
+{
+	if (!queryIssued[slot]) {
+		return;
+	}
+	GLint available = 0;
+	glGetQueryObjectiv(timerQueries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return;
+	}
+	GLuint64 startTime, endTime;
+	glGetQueryObjectui64v(timerQueries[slot][0], GL_QUERY_RESULT, &startTime);
+	glGetQueryObjectui64v(timerQueries[slot][1], GL_QUERY_RESULT, &endTime);
+	queryIssued[slot] = false;
+
+	gpuMilliseconds = (float)((endTime - startTime) / 1.0e6);
+	updateScale();
+}
+
+void DynamicResolution::updateScale()
+{
+	if (gpuMilliseconds <= 0.0f) {
+		return;
+	}
+	float ratio = targetMilliseconds / gpuMilliseconds;
+	if (std::abs(1.0f - ratio) <= DYNAMIC_RESOLUTION_DEADBAND) {
+		return;
+	}
+	// The time goes with the pixel count, the square of the scale
+	float step = glm::clamp(std::sqrt(ratio), 1.0f - DYNAMIC_RESOLUTION_MAX_STEP, 1.0f + DYNAMIC_RESOLUTION_MAX_STEP);
+	scale = glm::clamp(scale * step, DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+}
+
+void DynamicResolution::BeginFrame(int width, int height)
+{
+	glViewport(0, 0, width, height);
+	if (!enabled) {
+		renderWidth = width;
+		renderHeight = height;
+		return;
+	}
+
+	// The slot about to be reused holds the oldest measurement
+	int slot = frameIndex % DYNAMIC_RESOLUTION_QUERY_FRAMES;
+	for (int i = 1; i <= DYNAMIC_RESOLUTION_QUERY_FRAMES; i++) {
+		readTimings((frameIndex + i) % DYNAMIC_RESOLUTION_QUERY_FRAMES);
+	}
+
+	renderWidth = glm::max((int)std::lround(width * scale), 1);
+	renderHeight = glm::max((int)std::lround(height * scale), 1);
+
+	// A slot whose result never arrived is dropped rather than waited for
+	queryIssued[slot] = false;
+	glQueryCounter(timerQueries[slot][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::EndFrame()
+{
+	if (!enabled) {
+		return;
+	}
+
+	int slot = frameIndex % DYNAMIC_RESOLUTION_QUERY_FRAMES;
+	glQueryCounter(timerQueries[slot][1], GL_TIMESTAMP);
+	queryIssued[slot] = true;
+	frameIndex++;
+}
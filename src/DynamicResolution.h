@@ -0,0 +1,64 @@
+// DynamicResolution.h
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "typedefs.h"
+#include <GL/glew.h>
+
+// Scale of the render resolution, per axis
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+const float DYNAMIC_RESOLUTION_TARGET_MS = 1000.0f / 60.0f;
+// GPU times within this fraction of the target leave the scale alone, so it does not hunt
+const float DYNAMIC_RESOLUTION_DEADBAND = 0.1f;
+// The scale changes by at most this fraction per measurement
+const float DYNAMIC_RESOLUTION_MAX_STEP = 0.1f;
+// Timestamp pairs in flight, results are read this many frames later
+const int DYNAMIC_RESOLUTION_QUERY_FRAMES = 4;
+
+// Chooses the fraction of the window resolution the scene is rendered at. It owns no target:
+// FrameRenderer draws the scene at GetRenderWidth x GetRenderHeight into the corner of its radiance
+// target, and its tone mapping pass stretches that over the window with a bilinear filter and
+// sharpens it with an unsharp mask clamped to the neighbouring texels (edges stay crisp without halos).
+//
+// The scale follows the GPU time of the scene, measured with timestamp queries read back a few
+// frames later: fragment cost grows with the pixel count, so the scale moves by the square root
+// of target / measured time.
+class DynamicResolution {
+public:
+	DynamicResolution(float targetMilliseconds = DYNAMIC_RESOLUTION_TARGET_MS);
+	~DynamicResolution();
+
+	void SetTargetFrameTime(float milliseconds);
+	float GetTargetFrameTime() const { return targetMilliseconds; }
+	// Disabled draws straight into the output framebuffer at full resolution
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const { return enabled; }
+
+	float GetScale() const { return enabled ? scale : 1.0f; }
+	int GetRenderWidth() const { return renderWidth; }
+	int GetRenderHeight() const { return renderHeight; }
+	float GetGpuMilliseconds() const { return gpuMilliseconds; } // Last measured scene time, < 0 until known
+
+	// Picks the render size for this frame and starts timing it, the viewport is set to the output
+	void BeginFrame(int outputWidth, int outputHeight);
+	// Ends the timing of the frame drawn since BeginFrame
+	void EndFrame();
+
+private:
+	float targetMilliseconds;
+	bool enabled = true;
+	float scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+	float gpuMilliseconds = -1.0f;
+
+	int renderWidth = 0, renderHeight = 0;
+
+	GLuint timerQueries[DYNAMIC_RESOLUTION_QUERY_FRAMES][2] = {};
+	bool queryIssued[DYNAMIC_RESOLUTION_QUERY_FRAMES] = {};
+	int frameIndex = 0;
+
+	void readTimings(int slot);
+	void updateScale();
+};
+
+#endif
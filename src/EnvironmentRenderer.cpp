@@ -1,38 +1,105 @@
 #include "EnvironmentRenderer.h"
 
-EnvironmentRenderer::EnvironmentRenderer(Framebuffer* cubemapCreationFramebuffer, Mesh* cube)
-    : cubemapCreationFramebuffer(cubemapCreationFramebuffer), cube(cube)
+EnvironmentRenderer::EnvironmentRenderer(Framebuffer* cubemapCreationFramebuffer)
+    : cubemapCreationFramebuffer(cubemapCreationFramebuffer)
 {
     assert(cubemapCreationFramebuffer != nullptr);
-    assert(cube != nullptr);
+
+    // Core profile needs a bound VAO even without vertex attributes
+    glGenVertexArrays(1, &fullscreenVAO);
 
     // Create the cubemap.
     CreateCubemap();
 
+    // Only the cubemap is sampled from here on, a transient input goes with its framebuffer
+    Texture* inputTexture = cubemapCreationFramebuffer->getColorTexture();
+    if (inputTexture->isTransient()) {
+        delete cubemapCreationFramebuffer;
+        cubemapCreationFramebuffer = nullptr;
+        delete equirectengularToCubemapShader;
+        equirectengularToCubemapShader = nullptr;
+        inputTexture->releaseGLTexture();
+    }
 }
 
 EnvironmentRenderer::~EnvironmentRenderer()
 {
     delete equirectengularToCubemapShader;
-    delete cube;
     delete skyboxShader;
     delete cubemapCreationFramebuffer;
     delete outputFramebuffer;
     delete cubemapTexture;
     glDeleteSamplers(1, &sampler);
+    glDeleteVertexArrays(1, &fullscreenVAO);
 }
 
 void EnvironmentRenderer::CreateCubemap()
 {
-    // Load shader
+    PROFILE_GPU_SCOPE("CreateCubemap");
+
+    // Load shaders, the skybox one compiles while the faces are rendered
     equirectengularToCubemapShader = new ShaderProgram("shaders/fullscreen.vert", "shaders/panoramicToCubemap.frag");
+    skyboxShader = new ShaderProgram("shaders/skybox.vert", "shaders/skybox.frag");
     assert(glGetError() == GL_NO_ERROR);
 
     // Link the shader
     // Create the cubemap texture
     cubemapTexture = Texture::CreateCubemap(cubemapCreationFramebuffer->getWidth(), cubemapCreationFramebuffer->getHeight());
+    cubemapTexture->setName("environment cubemap");
+    renderCubemapFaces();
+
+    // Create the cubemap sampler
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // Set the cubemap texture to the sampler
+    glBindSampler(0, sampler);
+    glActiveTexture(GL_TEXTURE0 + cubemapTexture->getTextureUnit());
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture->getID());
+    assert(glGetError() == GL_NO_ERROR);
+
+    // Unbind everything
+    glBindSampler(0, sampler);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+
+    // Enable seamless cubemap sampling
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // Create the output framebuffer
+    outputFramebuffer = Framebuffer::CreateCubemapFramebuffer(cubemapTexture);
+    assert(glGetError() == GL_NO_ERROR);
+
+    skyboxShader->use();
 
-    // Create the cubemap texture from the framebuffer
+    skyboxShader->setSamplerCube("skybox", cubemapTexture->getTextureUnit());
+    skyboxShader->unuse();
+    assert(glGetError() == GL_NO_ERROR);
+}
+
+void EnvironmentRenderer::updateCubemap()
+{
+    PROFILE_GPU_SCOPE("UpdateCubemap");
+
+    if (cubemapCreationFramebuffer == nullptr) {
+        std::cerr << "EnvironmentRenderer: the input texture was transient and is released" << std::endl;
+        return;
+    }
+
+    // The faces are rendered at the cubemap size, the frame goes on at the current viewport
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    renderCubemapFaces();
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Renders the equirectangular input texture into the faces of the cubemap and rebuilds its mipmaps
+void EnvironmentRenderer::renderCubemapFaces()
+{
     // In each iteration, another face of the cube is rendered to the cubemap texture.
     // After all faces are rendered, the cubemap texture is complete.
     for (int i = 0; i < 6; i++) {
@@ -66,58 +133,22 @@ void EnvironmentRenderer::CreateCubemap()
         equirectengularToCubemapShader->setSampler2D("panoramicTexture", cubemapCreationFramebuffer->getColorTexture()->getTextureUnit());
         assert(glGetError() == GL_NO_ERROR);
 
-        cube->Draw();
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
         assert(glGetError() == GL_NO_ERROR);
     }
+    glBindVertexArray(0);
     assert(glGetError() == GL_NO_ERROR);
 
     // Unbind the shader
     equirectengularToCubemapShader->unuse();
 
     // Create mipmaps for the cubemap texture
-    cubemapTexture->bind();
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    cubemapTexture->generateMipmap();
     assert(glGetError() == GL_NO_ERROR);
-    
-    // Unbind the cubemap texture
-    cubemapTexture->unbind();
 
     // Unbind the framebuffer
     cubemapCreationFramebuffer->unbind();
-
-    // Create the cubemap sampler
-    glGenSamplers(1, &sampler);
-    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    // Set the cubemap texture to the sampler
-    glBindSampler(0, sampler);
-    glActiveTexture(GL_TEXTURE0 + cubemapTexture->getTextureUnit());
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture->getID());
-    assert(glGetError() == GL_NO_ERROR);
-
-    // Unbind everything
-    glBindSampler(0, sampler);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-
-
-    // Enable seamless cubemap sampling
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
-
-    // Create the output framebuffer
-    outputFramebuffer = Framebuffer::CreateCubemapFramebuffer(cubemapTexture);
-    assert(glGetError() == GL_NO_ERROR);
-
-    skyboxShader = new ShaderProgram("shaders/skybox.vert", "shaders/skybox.frag");
-    assert(glGetError() == GL_NO_ERROR);
-    skyboxShader->use();
-
-    skyboxShader->setSamplerCube("skybox", cubemapTexture->getTextureUnit());
-    skyboxShader->unuse();
-    assert(glGetError() == GL_NO_ERROR);
 }
 
 void EnvironmentRenderer::bind()
@@ -136,43 +167,53 @@ void EnvironmentRenderer::unbind()
 
 void EnvironmentRenderer::render(Camera& cam)
 {
-    // Disable culling, depth testing and face culling (if enabled)
+    PROFILE_GPU_SCOPE("Skybox");
+
+    // Depth test against the opaque pass without writing, disable face culling and sRGB (if enabled)
     bool cullingEnabled = glIsEnabled(GL_CULL_FACE);
     bool depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
     bool faceCullingEnabled = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+    GLint depthFunc;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
     glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
     glDisable(GL_FRAMEBUFFER_SRGB);
 
     // Render the skybox
-    skyboxShader->use();
+    ShaderProgram* shader = skyboxShader;
+    shader->use();
 
     // Set the cubemap texture
     glActiveTexture(GL_TEXTURE0 + cubemapTexture->getTextureUnit());
     glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture->getID());
 
-    // Set the view, projection and model matrices
-    skyboxShader->setMat4("projection", *cam.getProjectionMatrix());
-    skyboxShader->setMat4("view", *cam.getViewMatrix());
-    skyboxShader->setVec3("eyePos", cam.getPosition());
-    skyboxShader->setFloat("exposure", exposure);
+    // Only the rotation of the view matters for the sky directions. The environment rotation goes
+    // into the same matrix, so the corners come out in cubemap space at no per-pixel cost.
+    Matrix4 rotationView = Matrix4(Matrix3(*cam.getViewMatrix())) * glm::mat4_cast(rotation);
+    shader->setMat4("inverseViewProjection", glm::inverse(*cam.getProjectionMatrix() * rotationView));
 
-    // Draw the cube
-    cube->Draw();
+    // Draw the fullscreen triangle
+    glBindVertexArray(fullscreenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
 
     // Unbind the cubemap texture and the sampler
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
     glBindSampler(cubemapTexture->getTextureUnit(), 0);
 
     // Unbind the shader
-    skyboxShader->unuse();
+    shader->unuse();
     
-    // Re-enable culling, depth testing and face culling (if enabled)
+    // Restore the depth state, culling and sRGB (if enabled)
+    glDepthMask(GL_TRUE);
+    glDepthFunc(depthFunc);
     if (cullingEnabled) {
         glEnable(GL_CULL_FACE);
     }
-    if (depthTestEnabled) {
-        glEnable(GL_DEPTH_TEST);
+    if (!depthTestEnabled) {
+        glDisable(GL_DEPTH_TEST);
     }
     if (faceCullingEnabled) {
         glEnable(GL_FRAMEBUFFER_SRGB);
@@ -12,26 +12,30 @@
 
 #include "Texture.h"
 #include "Framebuffer.h"
-#include "Mesh.h"
 #include "ShaderProgram.h"
 #include "Camera.h"
+#include "Profiler.h"
 
 class EnvironmentRenderer {
 private:
     ShaderProgram* equirectengularToCubemapShader;
     ShaderProgram* skyboxShader;
     Framebuffer* cubemapCreationFramebuffer;
-    float exposure = 0.18;
-    Mesh* cube;
+    float exposure = 0.18; // Of the whole scene, FrameRenderer's tone mapping pass reads it
+    Quaternion rotation = Quaternion(1.0f, 0.0f, 0.0f, 0.0f);
+    GLuint fullscreenVAO; // Empty, fullscreen.vert and skybox.vert build the triangle from gl_VertexID
     Texture* cubemapTexture;
     GLuint sampler;
 
     Framebuffer* outputFramebuffer;
 
     void CreateCubemap();
+    void renderCubemapFaces();
 
 public:
-    EnvironmentRenderer(Framebuffer* cubemapCreationFramebuffer, Mesh* cube);
+    // Takes the framebuffer, whose color texture is the equirectangular input. A transient input
+    // (Texture::setTransient) has its GL texture released and the framebuffer deleted after the bake.
+    EnvironmentRenderer(Framebuffer* cubemapCreationFramebuffer);
     ~EnvironmentRenderer();
     
     void bind();
@@ -40,9 +44,18 @@ public:
     void setExposure(float exposure);
     float getExposure() const { return exposure; }
 
+    // Turntable of the sky, applied to the view directions (MeshRenderer::SetEnvironmentRotation for the objects)
+    void setRotation(const Quaternion& rotation) { this->rotation = rotation; }
+    const Quaternion& getRotation() const { return rotation; }
+
+    // Draws the sky radiance behind everything already in the depth buffer (far plane, GL_LEQUAL)
     void render(Camera& cam);
 
     Texture* getCubemapTexture();
+
+    // Re-renders the cubemap after the pixels of the input texture changed (environment sequences),
+    // the input must not be transient
+    void updateCubemap();
 };
 
 #endif
\ No newline at end of file
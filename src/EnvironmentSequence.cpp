@@ -0,0 +1,82 @@
+// EnvironmentSequence.cpp
+#include "EnvironmentSequence.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace
+{
+	// Runs on a background thread, stb_image and the CPU side Texture need no GL context
+	Texture* decodeFrame(const std::string& path)
+	{
+		Texture* frame = new Texture(path, true, false);
+		if (frame->getWidth() == 0 || frame->getHDRData() == nullptr) {
+			std::cerr << "Environment sequence: failed to decode " << path << std::endl;
+			delete frame;
+			return nullptr;
+		}
+		return frame;
+	}
+}
+
+EnvironmentSequence::EnvironmentSequence(const std::vector<std::string>& framePaths, int prefetchCount)
+	: framePaths(framePaths), prefetchCount(std::max(prefetchCount, 1))
+{
+	prefetch();
+}
+
+EnvironmentSequence::~EnvironmentSequence()
+{
+	for (std::future<Texture*>& frame : decoding) {
+		delete frame.get();
+	}
+	delete current;
+	delete previous;
+}
+
+std::vector<std::string> EnvironmentSequence::ListFrames(const std::string& directory)
+{
+	std::vector<std::string> paths;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		if (entry.path().extension() == ".hdr") {
+			paths.push_back(entry.path().string());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+// Keeps prefetchCount frames decoding, wrapping around at the end of the sequence
+void EnvironmentSequence::prefetch()
+{
+	while ((int)decoding.size() < prefetchCount && !framePaths.empty()) {
+		decoding.push_back(std::async(std::launch::async, decodeFrame, framePaths[nextToDecode]));
+		nextToDecode = (nextToDecode + 1) % framePaths.size();
+	}
+}
+
+Texture* EnvironmentSequence::Advance(bool wait)
+{
+	PROFILE_CPU_SCOPE("AdvanceSequence");
+
+	if (decoding.empty()) {
+		return nullptr;
+	}
+	if (!wait && decoding.front().wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return nullptr; // Late, the current frame stays a little longer
+	}
+	Texture* frame = decoding.front().get();
+	decoding.pop_front();
+	currentIndex = (currentIndex + 1) % framePaths.size();
+	prefetch();
+	if (frame == nullptr) {
+		return nullptr;
+	}
+
+	delete previous;
+	previous = current;
+	current = frame;
+	return current;
+}
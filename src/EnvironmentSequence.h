@@ -0,0 +1,46 @@
+// EnvironmentSequence.h
+#ifndef ENVIRONMENT_SEQUENCE_H
+#define ENVIRONMENT_SEQUENCE_H
+
+#include "Texture.h"
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+const int ENVIRONMENT_SEQUENCE_PREFETCH = 3; // Frames decoding ahead of the current one
+const float ENVIRONMENT_SEQUENCE_FRAME_RATE = 24.0f; // Playback rate of --sequence
+
+// Plays a list of .hdr frames (an HDR video) in a loop. The next ENVIRONMENT_SEQUENCE_PREFETCH
+// frames are decoded on background threads while the current one is shown, the decoded frames
+// are CPU side textures for IBLSampler::setTexture and Texture::uploadHDR.
+class EnvironmentSequence {
+public:
+	EnvironmentSequence(const std::vector<std::string>& framePaths, int prefetchCount = ENVIRONMENT_SEQUENCE_PREFETCH);
+	~EnvironmentSequence(); // Waits for the decodes in flight
+
+	// The .hdr files of a directory in name order
+	static std::vector<std::string> ListFrames(const std::string& directory);
+
+	// The next frame once it is decoded, nullptr while it is not (wait = false) or when it failed
+	// to decode. The returned frame and the one before it stay valid until the next call, so the
+	// sampler can still compare against the previous frame.
+	Texture* Advance(bool wait = false);
+
+	Texture* GetCurrentFrame() const { return current; }
+	int GetCurrentIndex() const { return currentIndex; }
+	int GetFrameCount() const { return (int)framePaths.size(); }
+
+private:
+	std::vector<std::string> framePaths;
+	int prefetchCount;
+	int nextToDecode = 0;
+	int currentIndex = -1;
+	std::deque<std::future<Texture*>> decoding; // Frames after the current one, in order
+	Texture* current = nullptr;
+	Texture* previous = nullptr;
+
+	void prefetch();
+};
+
+#endif
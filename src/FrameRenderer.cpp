@@ -0,0 +1,428 @@
+// FrameRenderer.cpp
+#include "FrameRenderer.h"
+#include <algorithm>
+#include <cmath>
+
+FrameRenderer::FrameRenderer(MeshRenderer* meshRenderer)
+	: meshRenderer(meshRenderer)
+{
+	assert(meshRenderer != nullptr);
+	glGenVertexArrays(1, &fullscreenVAO);
+	tonemapShader = new ShaderProgram("shaders/fullscreen.vert", "shaders/tonemap.frag");
+	upscaleShader = new ShaderProgram("shaders/fullscreen.vert", "shaders/tonemap.frag", { { "UPSCALE", "1" } });
+}
+
+FrameRenderer::~FrameRenderer()
+{
+	for (ReflectionProbe* probe : probes) {
+		probe->GetOwner()->reflectionMap = nullptr;
+		delete probe;
+	}
+	for (const auto& timing : probeTimings) {
+		freeTimerQueries.push_back(timing.first);
+		freeTimerQueries.push_back(timing.second);
+	}
+	if (!freeTimerQueries.empty()) {
+		glDeleteQueries((GLsizei)freeTimerQueries.size(), freeTimerQueries.data());
+	}
+	delete sceneFramebuffer;
+	delete sceneColor;
+	delete tonemapShader;
+	delete upscaleShader;
+	glDeleteVertexArrays(1, &fullscreenVAO);
+}
+
+void FrameRenderer::SetEnvironment(EnvironmentRenderer* environmentRenderer)
+{
+	this->environmentRenderer = environmentRenderer;
+	InvalidateReflectionProbes();
+}
+
+void FrameRenderer::AddObject(GameObject* gameObject)
+{
+	assert(gameObject != nullptr);
+	opaqueObjects.push_back(gameObject);
+}
+
+void FrameRenderer::RemoveObject(GameObject* gameObject)
+{
+	opaqueObjects.erase(std::remove(opaqueObjects.begin(), opaqueObjects.end(), gameObject), opaqueObjects.end());
+	RemoveReflectionProbe(gameObject);
+}
+
+ReflectionProbe* FrameRenderer::AddReflectionProbe(GameObject* gameObject)
+{
+	assert(gameObject != nullptr);
+	for (ReflectionProbe* probe : probes) {
+		if (probe->GetOwner() == gameObject) {
+			return probe;
+		}
+	}
+	ReflectionProbe* probe = new ReflectionProbe(gameObject);
+	probes.push_back(probe);
+	// Until all of its faces are drawn once, the environment is what the object reflects
+	return probe;
+}
+
+void FrameRenderer::RemoveReflectionProbe(GameObject* gameObject)
+{
+	for (size_t i = 0; i < probes.size(); i++) {
+		if (probes[i]->GetOwner() == gameObject) {
+			gameObject->reflectionMap = nullptr;
+			delete probes[i];
+			probes.erase(probes.begin() + i);
+			return;
+		}
+	}
+}
+
+void FrameRenderer::InvalidateReflectionProbes()
+{
+	for (ReflectionProbe* probe : probes) {
+		probe->Invalidate();
+	}
+}
+
+void FrameRenderer::SetReflectionProbeBudget(float milliseconds)
+{
+	probeBudget = milliseconds;
+}
+
+void FrameRenderer::SetAutoExposure(AutoExposure* autoExposure)
+{
+	this->autoExposure = autoExposure;
+}
+
+void FrameRenderer::SetRenderSize(int width, int height)
+{
+	renderWidth = width;
+	renderHeight = height;
+}
+
+void FrameRenderer::Render(Camera& camera)
+{
+	if (autoExposure != nullptr && environmentRenderer != nullptr) {
+		float exposure = autoExposure->Update();
+		environmentRenderer->setExposure(exposure);
+		meshRenderer->SetExposure(exposure);
+	}
+
+	GLint outputFramebuffer;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outputFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+	glDisable(GL_BLEND);
+
+	TransformSystem::Get()->Update();
+	updateReflectionProbes(camera);
+
+	int sceneWidth = renderWidth > 0 ? std::min(renderWidth, (int)viewport[2]) : viewport[2];
+	int sceneHeight = renderHeight > 0 ? std::min(renderHeight, (int)viewport[3]) : viewport[3];
+	bindSceneTarget(sceneWidth, sceneHeight);
+	glDepthMask(GL_TRUE);
+	// Without an environment nothing covers the background
+	glClear(environmentRenderer != nullptr ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	opaquePass(camera);
+	skyPass(camera);
+	if (autoExposure != nullptr && environmentRenderer != nullptr) {
+		autoExposure->Measure(sceneColor, sceneWidth, sceneHeight, environmentRenderer->getCubemapTexture());
+	}
+	tonemapPass(outputFramebuffer, viewport, sceneWidth, sceneHeight);
+
+	if (blendEnabled) {
+		glEnable(GL_BLEND);
+	}
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+void FrameRenderer::bindSceneTarget(int width, int height)
+{
+	// Smaller render sizes (dynamic resolution) draw into the corner of a larger target
+	if (sceneFramebuffer == nullptr || width > sceneFramebuffer->getWidth() || height > sceneFramebuffer->getHeight()) {
+		int targetWidth = sceneFramebuffer != nullptr ? std::max(width, sceneFramebuffer->getWidth()) : width;
+		int targetHeight = sceneFramebuffer != nullptr ? std::max(height, sceneFramebuffer->getHeight()) : height;
+		delete sceneFramebuffer;
+		delete sceneColor;
+		sceneColor = Texture::CreateRenderTexture(targetWidth, targetHeight, GL_RGBA16F);
+		sceneColor->setName("scene color");
+		glBindTexture(GL_TEXTURE_2D, sceneColor->getID());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		sceneFramebuffer = Framebuffer::CreateSceneFramebuffer(sceneColor);
+	}
+	sceneFramebuffer->bind();
+	glViewport(0, 0, width, height);
+}
+
+void FrameRenderer::tonemapPass(GLint outputFramebuffer, const GLint viewport[4], int width, int height)
+{
+	PROFILE_GPU_SCOPE("Tonemap");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// The mean color comes from the environment, without one the radiance is copied as it is
+	if (environmentRenderer == nullptr) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer->getID());
+		glBlitFramebuffer(0, 0, width, height, viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+			GL_COLOR_BUFFER_BIT, width == viewport[2] && height == viewport[3] ? GL_NEAREST : GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+		return;
+	}
+
+	GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	// Stretched scenes are filtered and sharpened. At full resolution every pixel samples a texel
+	// center, and the nearest texel keeps NaN radiance (see tonemap.frag) from spreading into its neighbours.
+	bool stretched = width != viewport[2] || height != viewport[3];
+	ShaderProgram* shader = stretched ? upscaleShader : tonemapShader;
+	shader->use();
+	glActiveTexture(GL_TEXTURE0 + TONEMAP_SCENE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, sceneColor->getID());
+	GLint filter = stretched ? GL_LINEAR : GL_NEAREST;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glActiveTexture(GL_TEXTURE0 + TONEMAP_ENVIRONMENT_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, environmentRenderer->getCubemapTexture()->getID());
+	shader->setSampler2D("scene", TONEMAP_SCENE_TEXTURE_UNIT);
+	shader->setSamplerCube("skybox", TONEMAP_ENVIRONMENT_TEXTURE_UNIT);
+	shader->setFloat("exposure", environmentRenderer->getExposure());
+	// The clamp keeps the filter from reaching the stale texels next to the rendered corner
+	Vector2 targetSize((float)sceneColor->getWidth(), (float)sceneColor->getHeight());
+	Vector2 rendered((float)width, (float)height);
+	shader->setVec2("uvScale", rendered / targetSize);
+	shader->setVec2("uvMax", (rendered - 0.5f) / targetSize);
+	if (stretched) {
+		shader->setVec2("texelSize", 1.0f / targetSize);
+		shader->setFloat("sharpness", UPSCALE_SHARPNESS);
+	}
+
+	glBindVertexArray(fullscreenVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glActiveTexture(GL_TEXTURE0 + TONEMAP_SCENE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	shader->unuse();
+
+	if (depthTestEnabled) {
+		glEnable(GL_DEPTH_TEST);
+	}
+}
+
+void FrameRenderer::opaquePass(Camera& camera, GameObject* excluded, bool probePass)
+{
+	PROFILE_CPU_SCOPE("OpaquePass");
+
+	// Sort by the object origin's view depth, nearest first
+	const Matrix4& view = *camera.getViewMatrix();
+	drawList.clear();
+	for (GameObject* gameObject : opaqueObjects) {
+		if (gameObject == excluded) {
+			continue;
+		}
+		float depth = -(view * gameObject->GetInstance().model[3]).z;
+		int lod = probePass ? gameObject->lodLevel : meshRenderer->SelectLod(gameObject);
+		drawList.push_back({ gameObject, depth, lod });
+	}
+	std::sort(drawList.begin(), drawList.end(), [](const DrawItem& a, const DrawItem& b) {
+		return a.depth < b.depth;
+	});
+
+	instances.clear();
+	instanceMaterials.clear();
+	frameMaterials.clear();
+	materialIndices.clear();
+	for (const DrawItem& item : drawList) {
+		instances.push_back(item.gameObject->GetInstance());
+		instanceMaterials.push_back(getMaterialIndex(item.gameObject->material));
+	}
+	meshRenderer->UpdateMaterialsUBO(frameMaterials);
+	meshRenderer->UploadInstances(instances, instanceMaterials);
+
+	auto sameDraw = [](const DrawItem& a, const DrawItem& b) {
+		return a.gameObject->shader == b.gameObject->shader && a.gameObject->mesh == b.gameObject->mesh && a.lod == b.lod
+			&& a.gameObject->reflectionMap == b.gameObject->reflectionMap;
+	};
+	for (size_t first = 0; first < drawList.size();) {
+		size_t end = first + 1;
+		while (end < drawList.size() && sameDraw(drawList[first], drawList[end])) {
+			end++;
+		}
+		meshRenderer->Draw(drawList[first].gameObject, drawList[first].lod, (int)first, (int)(end - first));
+		first = end;
+	}
+}
+
+void FrameRenderer::updateReflectionProbes(Camera& camera)
+{
+	probeFacesDrawn = 0;
+	if (probes.empty()) {
+		return;
+	}
+	PROFILE_CPU_SCOPE("ReflectionProbes");
+	readProbeTimings();
+
+	// What a probe shows changed: the environment turned, the exposure moved, or objects moved (the
+	// nearer, the more it matters). Auto exposure drifts with the view every frame, so it only
+	// counts once it moved by more stops than a manual change has to.
+	if (environmentRenderer != nullptr && environmentRenderer->getRotation() != probeEnvironmentRotation) {
+		probeEnvironmentRotation = environmentRenderer->getRotation();
+		InvalidateReflectionProbes();
+	}
+	float exposureTolerance = autoExposure != nullptr ? REFLECTION_PROBE_AUTO_EXPOSURE_STOPS : REFLECTION_PROBE_EXPOSURE_STOPS;
+	if (probeExposure <= 0.0f || std::abs(std::log2(meshRenderer->GetExposure() / probeExposure)) > exposureTolerance) {
+		probeExposure = meshRenderer->GetExposure();
+		InvalidateReflectionProbes();
+	}
+	TransformSystem* transforms = TransformSystem::Get();
+	for (ReflectionProbe* probe : probes) {
+		Vector3 position = probe->GetPosition();
+		float motion = 0.0f;
+		for (GameObject* gameObject : opaqueObjects) {
+			if (transforms->HasChanged(gameObject->transform)) {
+				motion += 1.0f / (1.0f + glm::length(Vector3(gameObject->GetInstance().model[3]) - position));
+			}
+		}
+		if (motion > 0.0f) {
+			probe->AddMotion(motion);
+		}
+	}
+
+	// As many faces as the budget pays for, the first one always
+	int faceCount = REFLECTION_PROBE_MAX_FACES_PER_FRAME;
+	if (probeFaceMilliseconds > 0.0f) {
+		faceCount = glm::clamp((int)(probeBudget / probeFaceMilliseconds), 1, REFLECTION_PROBE_MAX_FACES_PER_FRAME);
+	}
+	struct Candidate
+	{
+		float priority;
+		ReflectionProbe* probe;
+		int face;
+	};
+	std::vector<Candidate> candidates;
+	Vector3 viewerPosition = camera.getPosition();
+	for (ReflectionProbe* probe : probes) {
+		for (int face = 0; face < 6; face++) {
+			float priority = probe->GetFacePriority(face, viewerPosition);
+			if (priority > 0.0f) {
+				candidates.push_back({ priority, probe, face });
+			}
+		}
+	}
+	faceCount = std::min(faceCount, (int)candidates.size());
+	probeFacesDrawn = faceCount;
+	std::partial_sort(candidates.begin(), candidates.begin() + faceCount, candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.priority > b.priority;
+	});
+
+	if (faceCount > 0) {
+		PROFILE_GPU_SCOPE("ReflectionProbeFaces");
+		GLint framebuffer;
+		GLint viewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		Camera* viewCamera = meshRenderer->GetCamera();
+
+		for (int i = 0; i < faceCount; i++) {
+			renderProbeFace(candidates[i].probe, candidates[i].face);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		if (viewCamera != nullptr) {
+			meshRenderer->SetCamera(viewCamera);
+		}
+	}
+
+	for (ReflectionProbe* probe : probes) {
+		probe->Age();
+	}
+}
+
+void FrameRenderer::renderProbeFace(ReflectionProbe* probe, int face)
+{
+	if (freeTimerQueries.size() < 2) {
+		GLuint queries[2];
+		glGenQueries(2, queries);
+		freeTimerQueries.push_back(queries[0]);
+		freeTimerQueries.push_back(queries[1]);
+	}
+	GLuint end = freeTimerQueries.back();
+	freeTimerQueries.pop_back();
+	GLuint start = freeTimerQueries.back();
+	freeTimerQueries.pop_back();
+	glQueryCounter(start, GL_TIMESTAMP);
+
+	probe->BindFace(face);
+	probe->SetupFaceCamera(face, probeCamera);
+	meshRenderer->SetCamera(&probeCamera);
+	glDepthMask(GL_TRUE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	opaquePass(probeCamera, probe->GetOwner(), true);
+	if (environmentRenderer != nullptr) {
+		environmentRenderer->render(probeCamera);
+	}
+
+	glQueryCounter(end, GL_TIMESTAMP);
+	probeTimings.emplace_back(start, end);
+
+	probe->FaceUpdated(face);
+	if (probe->IsReady()) {
+		probe->GetOwner()->reflectionMap = probe->GetCubemap();
+	}
+}
+
+// Results of earlier frames, without waiting for the GPU
+void FrameRenderer::readProbeTimings()
+{
+	size_t read = 0;
+	for (; read < probeTimings.size(); read++) {
+		GLuint start = probeTimings[read].first;
+		GLuint end = probeTimings[read].second;
+		GLint available = 0;
+		glGetQueryObjectiv(end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			break;
+		}
+		GLuint64 startTime, endTime;
+		glGetQueryObjectui64v(start, GL_QUERY_RESULT, &startTime);
+		glGetQueryObjectui64v(end, GL_QUERY_RESULT, &endTime);
+		float milliseconds = (float)((endTime - startTime) / 1.0e6);
+		probeFaceMilliseconds = probeFaceMilliseconds < 0.0f ? milliseconds : 0.9f * probeFaceMilliseconds + 0.1f * milliseconds;
+		freeTimerQueries.push_back(start);
+		freeTimerQueries.push_back(end);
+	}
+	probeTimings.erase(probeTimings.begin(), probeTimings.begin() + read);
+}
+
+GLint FrameRenderer::getMaterialIndex(Material* material)
+{
+	auto found = materialIndices.find(material);
+	if (found != materialIndices.end()) {
+		return found->second;
+	}
+	if (frameMaterials.size() == MAX_MATERIALS) {
+		if (!warnedMaterialOverflow) {
+			std::cerr << "FrameRenderer: more than " << MAX_MATERIALS << " materials in a frame, the rest use the first one" << std::endl;
+			warnedMaterialOverflow = true;
+		}
+		return 0;
+	}
+	GLint index = (GLint)frameMaterials.size();
+	frameMaterials.push_back(material);
+	materialIndices[material] = index;
+	return index;
+}
+
+void FrameRenderer::skyPass(Camera& camera)
+{
+	if (environmentRenderer != nullptr) {
+		environmentRenderer->render(camera);
+	}
+}
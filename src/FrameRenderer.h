@@ -0,0 +1,114 @@
+// FrameRenderer.h
+#ifndef FRAME_RENDERER_H
+#define FRAME_RENDERER_H
+
+#include "typedefs.h"
+#include "GameObject.h"
+#include "MeshRenderer.h"
+#include "EnvironmentRenderer.h"
+#include "ReflectionProbe.h"
+#include "AutoExposure.h"
+#include "Framebuffer.h"
+#include "Camera.h"
+#include "Profiler.h"
+#include <unordered_map>
+#include <vector>
+
+const int TONEMAP_SCENE_TEXTURE_UNIT = 0;
+const int TONEMAP_ENVIRONMENT_TEXTURE_UNIT = 1;
+// Strength of the unsharp mask on a scene stretched over the viewport (dynamic resolution)
+const float UPSCALE_SHARPNESS = 0.5f;
+
+// Draws a frame in a fixed pass order:
+//  0. Probes: the stalest, most important reflection probe faces are redrawn (opaque + sky from the
+//     probe, without its object), as many as fit the GPU budget, at most
+//     REFLECTION_PROBE_MAX_FACES_PER_FRAME. The cost of a face is measured with timestamp queries
+//     read back a few frames later.
+//  1. Opaque: game objects sorted front to back, so early-Z rejects the hidden fragments of the light loops.
+//     Neighbours in that order sharing shader, mesh and LOD become one instanced draw, the material
+//     is an index per instance into the materials uploaded for the frame.
+//  2. Sky: one fullscreen triangle at the far plane with GL_LEQUAL, only the pixels no object covered are shaded
+//     Then AutoExposure (if set) meters the radiance, its result picks the exposure of a later frame.
+//  3. Tone mapping: passes 1 and 2 write radiance into an RGBA16F target, one fullscreen pass tone
+//     maps it into the framebuffer and viewport bound when Render was called. With a render size smaller than the viewport
+//     (dynamic resolution) the scene is drawn at that size and this pass stretches it over the
+//     viewport with a bilinear filter, then sharpens it (UPSCALE_SHARPNESS).
+// The sky writes every pixel the opaque pass leaves, so only depth has to be cleared. Blending is
+// off for the whole frame, the passes are opaque.
+class FrameRenderer {
+public:
+	FrameRenderer(MeshRenderer* meshRenderer);
+	~FrameRenderer();
+
+	void SetEnvironment(EnvironmentRenderer* environmentRenderer);
+	void AddObject(GameObject* gameObject);
+	void RemoveObject(GameObject* gameObject); // Also removes its reflection probe
+
+	// The object reflects the scene around it instead of the environment
+	ReflectionProbe* AddReflectionProbe(GameObject* gameObject);
+	void RemoveReflectionProbe(GameObject* gameObject);
+	// Every face is redrawn over the next frames, e.g. after the lights or the environment changed
+	void InvalidateReflectionProbes();
+	// GPU time the probe faces of a frame may take, at least one face is redrawn per frame
+	void SetReflectionProbeBudget(float milliseconds);
+	float GetReflectionProbeBudget() const { return probeBudget; }
+	// Drives the exposure of the environment and mesh renderers, nullptr leaves it to SetExposure
+	void SetAutoExposure(AutoExposure* autoExposure);
+	float GetReflectionProbeFaceMilliseconds() const { return probeFaceMilliseconds; } // Measured, < 0 until known
+	// Faces redrawn in the last frame, 0 once the probes settled in a static scene
+	int GetReflectionProbeFacesDrawn() const { return probeFacesDrawn; }
+	// Size the scene is drawn at, 0 for the viewport size. Larger sizes are clamped to the viewport.
+	void SetRenderSize(int width, int height);
+
+	void Render(Camera& camera);
+
+private:
+	struct DrawItem
+	{
+		GameObject* gameObject;
+		float depth; // View space distance along the camera forward
+		int lod;
+	};
+
+	MeshRenderer* meshRenderer;
+	EnvironmentRenderer* environmentRenderer = nullptr;
+	std::vector<GameObject*> opaqueObjects;
+	std::vector<DrawItem> drawList; // Reused every frame
+	std::vector<InstanceTransform> instances; // Transforms of drawList, in the same order
+	std::vector<GLint> instanceMaterials; // Index into frameMaterials per instance
+	std::vector<Material*> frameMaterials; // Distinct materials of this frame
+	std::unordered_map<Material*, GLint> materialIndices;
+	bool warnedMaterialOverflow = false;
+
+	Texture* sceneColor = nullptr; // RGBA16F radiance, sized to the largest render size so far
+	Framebuffer* sceneFramebuffer = nullptr;
+	ShaderProgram* tonemapShader;
+	ShaderProgram* upscaleShader; // tonemapShader with UPSCALE, for scenes stretched over the viewport
+	GLuint fullscreenVAO;
+	AutoExposure* autoExposure = nullptr;
+	int renderWidth = 0, renderHeight = 0;
+
+	std::vector<ReflectionProbe*> probes;
+	Camera probeCamera;
+	float probeBudget = REFLECTION_PROBE_BUDGET_MS;
+	float probeFaceMilliseconds = -1.0f; // Running average GPU time of one face
+	int probeFacesDrawn = 0;
+	Quaternion probeEnvironmentRotation = Quaternion(1.0f, 0.0f, 0.0f, 0.0f); // Environment the probes show
+	float probeExposure = -1.0f; // The lit shaders scale their radiance with it
+	std::vector<std::pair<GLuint, GLuint>> probeTimings; // Timestamps around faces not read back yet, oldest first
+	std::vector<GLuint> freeTimerQueries;
+
+	// excluded is left out, probe passes keep the LODs the view selected
+	void opaquePass(Camera& camera, GameObject* excluded = nullptr, bool probePass = false);
+	void skyPass(Camera& camera);
+	// Binds the scene target with the viewport at its bottom left corner
+	void bindSceneTarget(int width, int height);
+	// Stretches the width x height corner of the scene target over the viewport
+	void tonemapPass(GLint outputFramebuffer, const GLint viewport[4], int width, int height);
+	void updateReflectionProbes(Camera& camera);
+	void renderProbeFace(ReflectionProbe* probe, int face);
+	void readProbeTimings();
+	GLint getMaterialIndex(Material* material);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "Framebuffer.h"
+#include "ResourceRegistry.h"
 
 Framebuffer* Framebuffer::CreateCubemapFramebuffer(Texture* inputTexture)
 {
@@ -10,6 +11,47 @@ Framebuffer* Framebuffer::CreateFramebuffer(int width, int height, Texture* inpu
     return new Framebuffer(width, height, inputTexture);
 }
 
+Framebuffer* Framebuffer::CreateCubemapFaceFramebuffer(Texture* cubemap)
+{
+    Framebuffer* framebuffer = new Framebuffer(cubemap->getWidth(), cubemap->getHeight(), nullptr);
+    framebuffer->inputTexture = cubemap;
+    framebuffer->width = cubemap->getWidth();
+    framebuffer->height = cubemap->getHeight();
+
+    glGenFramebuffers(1, &framebuffer->id);
+    glGenRenderbuffers(1, &framebuffer->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, framebuffer->width, framebuffer->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    framebuffer->trackDepthBuffer();
+
+    framebuffer->bind();
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer->depthBuffer);
+    framebuffer->attachCubemapFace(0);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    assert(glGetError() == GL_NO_ERROR);
+    framebuffer->unbind();
+    return framebuffer;
+}
+
+Framebuffer* Framebuffer::CreateSceneFramebuffer(Texture* colorTexture)
+{
+    Framebuffer* framebuffer = new Framebuffer(colorTexture->getWidth(), colorTexture->getHeight(), colorTexture);
+
+    glGenRenderbuffers(1, &framebuffer->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, framebuffer->width, framebuffer->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    framebuffer->trackDepthBuffer();
+
+    framebuffer->bind();
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebuffer->depthBuffer);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    assert(glGetError() == GL_NO_ERROR);
+    framebuffer->unbind();
+    return framebuffer;
+}
+
 Framebuffer::Framebuffer(Texture* inputTexture, bool isCubemap)
 {
     if (inputTexture == nullptr) {
@@ -59,6 +101,17 @@ Framebuffer::Framebuffer(int width, int height, Texture* inputTexture)
 Framebuffer::~Framebuffer()
 {
     glDeleteFramebuffers(1, &id);
+    if (depthBuffer != 0) {
+        ResourceRegistry::Get()->Release(RESOURCE_RENDERBUFFER, depthBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+}
+
+void Framebuffer::trackDepthBuffer()
+{
+    std::string name = "depth buffer " + std::to_string(width) + "x" + std::to_string(height);
+    size_t bytes = ResourceRegistry::TextureBytes(GL_DEPTH_COMPONENT24, width, height);
+    ResourceRegistry::Get()->Track(RESOURCE_RENDERBUFFER, depthBuffer, name, bytes);
 }
 
 void Framebuffer::bind()
@@ -69,4 +122,10 @@ void Framebuffer::bind()
 void Framebuffer::unbind()
 {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::attachCubemapFace(int face)
+{
+    bind();
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, inputTexture->getID(), 0);
 }
\ No newline at end of file
@@ -13,16 +13,23 @@ private:
     int width;
     int height;
     Texture* inputTexture; // Input color texture
+    GLuint depthBuffer = 0; // Renderbuffer, only for framebuffers that draw scenes
     Framebuffer(Texture* inputTexture, bool isCubemap);
     Framebuffer(int width, int height, Texture* inputTexture);
+    void trackDepthBuffer(); // In the ResourceRegistry
 
 public:
     static Framebuffer* CreateCubemapFramebuffer(Texture* inputTexture);
     static Framebuffer* CreateFramebuffer(int width, int height, Texture* inputTexture);
+    // One face of the cubemap at a time (attachCubemapFace) plus a depth buffer, for drawing a scene into it
+    static Framebuffer* CreateCubemapFaceFramebuffer(Texture* cubemap);
+    // The 2D texture plus a depth buffer of its size, for drawing a scene into it
+    static Framebuffer* CreateSceneFramebuffer(Texture* colorTexture);
     ~Framebuffer();
 
     void bind();
     void unbind();   
+    void attachCubemapFace(int face); // Binds the framebuffer with GL_TEXTURE_CUBE_MAP_POSITIVE_X + face attached
     bool hasColorTexture() const { return inputTexture != nullptr; }
 
     Texture* getColorTexture() const { return inputTexture; }
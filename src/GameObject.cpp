@@ -1,44 +1,41 @@
 #include "GameObject.h"
+#include "ShaderLibrary.h"
 
 GameObject::GameObject(ShaderProgram* program) {
 	name = "GameObject";
 	shader = program;
 	mesh = nullptr;
-	position = Vector3(0, 0, 0);
-	scale = Vector3(1, 1, 1);
-	rotation = Quaternion(1, 0, 0, 0);
-	updateModelingMatrix();
+	material = nullptr;
+	transform = TransformSystem::Get()->Create();
 }
 
 GameObject::GameObject() {
 	name = "GameObject";
-	shader = ShaderProgram::getDefaultShader();
+	shader = ShaderLibrary::GetShared()->GetDefault();
 	mesh = nullptr;
-	position = Vector3(0, 0, 0);
-	scale = Vector3(1, 1, 1);
-	rotation = Quaternion(1, 0, 0, 0);
-	updateModelingMatrix();
+	material = nullptr;
+	transform = TransformSystem::Get()->Create();
+}
+
+GameObject::~GameObject() {
+	TransformSystem::Get()->Destroy(transform);
 }
 
 Matrix4 GameObject::getModelingMatrix() {
-	if (modelingMatrixDirty) {
-		updateModelingMatrix();
+	return GetInstance().model;
+}
+
+const InstanceTransform& GameObject::GetInstance() {
+	TransformSystem* transforms = TransformSystem::Get();
+	if (transforms->IsDirty()) {
+		transforms->Update();
 	}
-	return modelingMatrix;
+	return transforms->GetInstance(transform);
 }
 
+// The renderer uploads the materials of every frame, nothing is written to the shader here
 void GameObject::SetMaterial(Material* material) {
 	this->material = material;
-
-	// Set the material
-	if (material != nullptr && shader != nullptr) {
-		shader->use();
-		shader->setVec3("material.ambient", material->ambient);
-		shader->setVec3("material.diffuse", material->diffuse);
-		shader->setVec3("material.specular", material->specular);
-		// shader->setFloat("material.shininess", material->shininess);
-		shader->unuse();
-	}
 }
 
 void GameObject::SetMesh(Mesh* mesh) {
@@ -47,40 +44,32 @@ void GameObject::SetMesh(Mesh* mesh) {
 
 void GameObject::SetShader(ShaderProgram* shader) {
 	this->shader = shader;
-	SetMaterial(material);
+}
+
+void GameObject::SetParent(GameObject* parent) {
+	TransformSystem::Get()->SetParent(transform, parent != nullptr ? parent->transform : INVALID_TRANSFORM);
 }
 
 void GameObject::SetPosition(Vector3 position) {
-	this->position = position;
-	modelingMatrixDirty = true;
+	TransformSystem::Get()->SetPosition(transform, position);
 }
 
 void GameObject::SetScale(Vector3 scale) {
-	this->scale = scale;
-	modelingMatrixDirty = true;
+	TransformSystem::Get()->SetScale(transform, scale);
 }
 
 void GameObject::SetRotation(Quaternion rotation) {
-	this->rotation = rotation;
-	modelingMatrixDirty = true;
+	TransformSystem::Get()->SetRotation(transform, rotation);
 }
 
 Quaternion GameObject::GetRotation() {
-	return rotation;
+	return TransformSystem::Get()->GetRotation(transform);
 }
 
 Vector3 GameObject::GetPosition() {
-	return position;
+	return TransformSystem::Get()->GetPosition(transform);
 }
 
 Vector3 GameObject::GetScale() {
-	return scale;
-}
-
-void GameObject::updateModelingMatrix() {
-	modelingMatrixDirty = false;
-	modelingMatrix = glm::mat4(1.0f);
-	modelingMatrix = glm::translate(modelingMatrix, position);
-	modelingMatrix = glm::scale(modelingMatrix, scale);
-	modelingMatrix = modelingMatrix * glm::mat4_cast(rotation);
+	return TransformSystem::Get()->GetScale(transform);
 }
\ No newline at end of file
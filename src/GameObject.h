@@ -7,23 +7,28 @@
 #include "ShaderProgram.h"
 #include "printExtensions.h"
 #include "Material.h"
+#include "Texture.h"
+#include "TransformSystem.h"
 #include <iostream>
 #include <string>
 
 class GameObject {
 public:
 	std::string name;
-	Vector3 position;
-	Vector3 scale;
-	Quaternion rotation;
+	TransformHandle transform; // Position, rotation and scale live in the TransformSystem
 	ShaderProgram* shader;
     Mesh* mesh;
-	Material* material;
+	Material* material; // nullptr draws with the default material
+	int lodLevel = 0; // Level drawn last frame, kept for LOD hysteresis
+	Texture* reflectionMap = nullptr; // Cubemap of the object's ReflectionProbe, nullptr reflects the environment
 
 	GameObject(ShaderProgram* program);
-	GameObject();
+	GameObject(); // Draws with the default program of the shared ShaderLibrary
+	~GameObject();
 
+	// World space, brings the transform system up to date first if anything moved
 	Matrix4 getModelingMatrix();
+	const InstanceTransform& GetInstance();
 	
 	void SetMesh(Mesh* mesh);
 	void SetShader(ShaderProgram* shader);
@@ -31,15 +36,11 @@ public:
 	void SetScale(Vector3 scale);
 	void SetRotation(Quaternion rotation);
 	void SetMaterial(Material* material);
+	void SetParent(GameObject* parent);
 
 	Quaternion GetRotation();
 	Vector3 GetPosition();
 	Vector3 GetScale();
-
-private:
-	bool modelingMatrixDirty;
-	Matrix4 modelingMatrix;
-	void updateModelingMatrix();
 };
 
 #endif
@@ -0,0 +1,305 @@
+// GeometryArena.cpp
+#include "GeometryArena.h"
+#include "MeshProcessor.h"
+#include "ResourceRegistry.h"
+#include <cassert>
+#include <iomanip>
+
+RangeAllocator::RangeAllocator(GLsizeiptr capacity)
+	: capacity(capacity), used(0)
+{
+	freeBlocks[0] = capacity;
+}
+
+bool RangeAllocator::allocate(GLsizeiptr size, GLsizeiptr alignment, ArenaRange& range)
+{
+	if (size <= 0) {
+		return false;
+	}
+
+	// Best fit, the smallest free block that can hold the aligned range
+	auto best = freeBlocks.end();
+	GLsizeiptr bestPadding = 0;
+	for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+		GLsizeiptr padding = (alignment - it->first % alignment) % alignment;
+		if (it->second < size + padding) {
+			continue;
+		}
+		if (best == freeBlocks.end() || it->second < best->second) {
+			best = it;
+			bestPadding = padding;
+		}
+	}
+	if (best == freeBlocks.end()) {
+		return false;
+	}
+
+	GLsizeiptr blockOffset = best->first;
+	GLsizeiptr blockSize = best->second;
+	freeBlocks.erase(best);
+
+	// Give the alignment padding and the remainder back to the free list
+	if (bestPadding > 0) {
+		freeBlocks[blockOffset] = bestPadding;
+	}
+	GLsizeiptr remainder = blockSize - bestPadding - size;
+	if (remainder > 0) {
+		freeBlocks[blockOffset + bestPadding + size] = remainder;
+	}
+
+	range.offset = blockOffset + bestPadding;
+	range.size = size;
+	used += size;
+	return true;
+}
+
+void RangeAllocator::free(const ArenaRange& range)
+{
+	if (!range.isValid()) {
+		return;
+	}
+
+	GLsizeiptr offset = range.offset;
+	GLsizeiptr size = range.size;
+	used -= size;
+
+	// Coalesce with the next block
+	auto next = freeBlocks.lower_bound(offset);
+	if (next != freeBlocks.end() && next->first == offset + size) {
+		size += next->second;
+		next = freeBlocks.erase(next);
+	}
+	// Coalesce with the previous block
+	if (next != freeBlocks.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += size;
+			return;
+		}
+	}
+	freeBlocks[offset] = size;
+}
+
+void RangeAllocator::grow(GLsizeiptr newCapacity)
+{
+	assert(newCapacity > capacity);
+	ArenaRange tail;
+	tail.offset = capacity;
+	tail.size = newCapacity - capacity;
+	capacity = newCapacity;
+	used += tail.size; // free() subtracts it again
+	free(tail);
+}
+
+GLsizeiptr RangeAllocator::getLargestFreeBlock() const
+{
+	GLsizeiptr largest = 0;
+	for (const auto& block : freeBlocks) {
+		largest = std::max(largest, block.second);
+	}
+	return largest;
+}
+
+float RangeAllocator::getFragmentation() const
+{
+	GLsizeiptr freeBytes = capacity - used;
+	if (freeBytes == 0) {
+		return 0.0f;
+	}
+	return 1.0f - (float)getLargestFreeBlock() / freeBytes;
+}
+
+GeometryArena* GeometryArena::arenas[VERTEX_FORMAT_COUNT] = { nullptr };
+
+GeometryArena* GeometryArena::GetArena(VertexFormat format)
+{
+	assert(format < VERTEX_FORMAT_COUNT);
+	if (arenas[format] == nullptr) {
+		arenas[format] = new GeometryArena(format, DEFAULT_ARENA_VERTEX_CAPACITY, DEFAULT_ARENA_INDEX_CAPACITY);
+	}
+	return arenas[format];
+}
+
+GeometryArena::GeometryArena(VertexFormat format, GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity)
+	: format(format), vertexAllocator(vertexCapacity), indexAllocator(indexCapacity)
+{
+	switch (format) {
+		case VERTEX_FORMAT_PACKED: stride = sizeof(PackedVertex); break;
+		default: assert(false); break;
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	ResourceRegistry::Get()->Track(RESOURCE_BUFFER, VBO, "geometry arena vertices", vertexCapacity);
+	ResourceRegistry::Get()->Track(RESOURCE_BUFFER, EBO, "geometry arena indices", indexCapacity);
+
+	setupVertexAttributes();
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+GeometryArena::~GeometryArena()
+{
+	ResourceRegistry::Get()->Release(RESOURCE_BUFFER, VBO);
+	ResourceRegistry::Get()->Release(RESOURCE_BUFFER, EBO);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+void GeometryArena::setupVertexAttributes()
+{
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+	switch (format) {
+		case VERTEX_FORMAT_PACKED:
+			// Position attribute
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, position));
+			glEnableVertexAttribArray(0);
+			// Normal attribute (10:10:10:2 signed normalized)
+			glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offsetof(PackedVertex, normal));
+			glEnableVertexAttribArray(1);
+			// Texture attribute (half float)
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offsetof(PackedVertex, texCoord));
+			glEnableVertexAttribArray(2);
+			break;
+		default:
+			assert(false);
+			break;
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::growBuffer(GLenum target, GLuint& buffer, RangeAllocator& allocator, GLsizeiptr minimumFree)
+{
+	GLsizeiptr oldCapacity = allocator.getCapacity();
+	GLsizeiptr newCapacity = std::max(oldCapacity * 2, oldCapacity + minimumFree);
+
+	// Copy the old contents over to a bigger buffer
+	GLuint newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	ResourceRegistry::Get()->Release(RESOURCE_BUFFER, buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = newBuffer;
+	ResourceRegistry::Get()->Track(RESOURCE_BUFFER, buffer, target == GL_ARRAY_BUFFER ? "geometry arena vertices" : "geometry arena indices", newCapacity);
+
+	allocator.grow(newCapacity);
+	std::cout << "Geometry arena: grew " << (target == GL_ARRAY_BUFFER ? "vertex" : "index") << " buffer to " << newCapacity / 1024 << " KB" << std::endl;
+
+	// The VAO references the old buffers
+	setupVertexAttributes();
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+bool GeometryArena::allocate(GLsizeiptr vertexBytes, GLsizeiptr indexBytes, ArenaRange& vertexRange, ArenaRange& indexRange)
+{
+	// Vertex ranges are stride aligned so every mesh starts at an integral base vertex
+	if (!vertexAllocator.allocate(vertexBytes, stride, vertexRange)) {
+		growBuffer(GL_ARRAY_BUFFER, VBO, vertexAllocator, vertexBytes + stride);
+		if (!vertexAllocator.allocate(vertexBytes, stride, vertexRange)) {
+			return false;
+		}
+	}
+	// Index ranges are 4 byte aligned, 16 and 32 bit indices share the buffer
+	if (!indexAllocator.allocate(indexBytes, sizeof(GLuint), indexRange)) {
+		growBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO, indexAllocator, indexBytes + sizeof(GLuint));
+		if (!indexAllocator.allocate(indexBytes, sizeof(GLuint), indexRange)) {
+			vertexAllocator.free(vertexRange);
+			vertexRange = ArenaRange();
+			return false;
+		}
+	}
+	return true;
+}
+
+void GeometryArena::free(ArenaRange& vertexRange, ArenaRange& indexRange)
+{
+	vertexAllocator.free(vertexRange);
+	indexAllocator.free(indexRange);
+	vertexRange = ArenaRange();
+	indexRange = ArenaRange();
+}
+
+void GeometryArena::uploadVertices(const ArenaRange& range, const void* data)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, range.offset, range.size, data);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::uploadIndices(const ArenaRange& range, const void* data)
+{
+	// Uploaded through the copy target, so the element binding of whatever VAO is bound stays intact
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset, range.size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+bool GeometryArena::duplicate(const ArenaRange& vertexRange, const ArenaRange& indexRange, ArenaRange& copyVertexRange, ArenaRange& copyIndexRange)
+{
+	if (!allocate(vertexRange.size, indexRange.size, copyVertexRange, copyIndexRange)) {
+		return false;
+	}
+	copyRange(VBO, vertexRange, copyVertexRange);
+	copyRange(EBO, indexRange, copyIndexRange);
+	assert(glGetError() == GL_NO_ERROR);
+	return true;
+}
+
+void GeometryArena::copyRange(GLuint buffer, const ArenaRange& source, const ArenaRange& destination)
+{
+	// Reading and writing the same buffer is fine as long as the ranges do not overlap
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source.offset, destination.offset, source.size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryArena::bind()
+{
+	glBindVertexArray(VAO);
+}
+
+void GeometryArena::printStats() const
+{
+	const RangeAllocator* allocators[2] = { &vertexAllocator, &indexAllocator };
+	const char* names[2] = { "vertex", "index" };
+	for (int i = 0; i < 2; i++) {
+		const RangeAllocator* allocator = allocators[i];
+		std::cout << "Geometry arena (" << names[i] << "): "
+			<< std::fixed << std::setprecision(1)
+			<< allocator->getUsed() / 1024.0f << " KB / " << allocator->getCapacity() / 1024.0f << " KB used ("
+			<< 100.0f * allocator->getUsed() / allocator->getCapacity() << "%), "
+			<< allocator->getFreeBlockCount() << " free blocks, "
+			<< "fragmentation " << 100.0f * allocator->getFragmentation() << "%" << std::endl;
+	}
+}
+
+void GeometryArena::PrintAllStats()
+{
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++) {
+		if (arenas[i] != nullptr) {
+			arenas[i]->printStats();
+		}
+	}
+}
@@ -0,0 +1,91 @@
+// GeometryArena.h
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include "typedefs.h"
+#include <GL/glew.h>
+#include <map>
+#include <vector>
+#include <iostream>
+
+#define DEFAULT_ARENA_VERTEX_CAPACITY (4 * 1024 * 1024)
+#define DEFAULT_ARENA_INDEX_CAPACITY (2 * 1024 * 1024)
+
+// Vertex layouts that have their own arena (and VAO)
+enum VertexFormat
+{
+	VERTEX_FORMAT_PACKED, // PackedVertex: float3 position, 10:10:10:2 normal, half2 uv
+	VERTEX_FORMAT_COUNT
+};
+
+struct ArenaRange
+{
+	GLsizeiptr offset = 0;
+	GLsizeiptr size = 0;
+	bool isValid() const { return size > 0; }
+};
+
+// Hands out byte ranges of a linear buffer, freed ranges are coalesced and recycled (best fit)
+class RangeAllocator
+{
+public:
+	RangeAllocator(GLsizeiptr capacity);
+
+	bool allocate(GLsizeiptr size, GLsizeiptr alignment, ArenaRange& range);
+	void free(const ArenaRange& range);
+	void grow(GLsizeiptr newCapacity);
+
+	GLsizeiptr getCapacity() const { return capacity; }
+	GLsizeiptr getUsed() const { return used; }
+	GLsizeiptr getLargestFreeBlock() const;
+	size_t getFreeBlockCount() const { return freeBlocks.size(); }
+	float getFragmentation() const; // 0: all free space is one block, ->1: free space is scattered
+
+private:
+	GLsizeiptr capacity;
+	GLsizeiptr used;
+	std::map<GLsizeiptr, GLsizeiptr> freeBlocks; // offset -> size
+};
+
+// One large vertex and index buffer shared by every mesh of a vertex format,
+// drawn with glDrawElementsBaseVertex through a single VAO.
+class GeometryArena
+{
+public:
+	static GeometryArena* GetArena(VertexFormat format);
+	~GeometryArena();
+
+	bool allocate(GLsizeiptr vertexBytes, GLsizeiptr indexBytes, ArenaRange& vertexRange, ArenaRange& indexRange);
+	void free(ArenaRange& vertexRange, ArenaRange& indexRange);
+	void uploadVertices(const ArenaRange& range, const void* data);
+	void uploadIndices(const ArenaRange& range, const void* data);
+	// New ranges holding a copy of the given ones, the data never leaves the GPU
+	bool duplicate(const ArenaRange& vertexRange, const ArenaRange& indexRange, ArenaRange& copyVertexRange, ArenaRange& copyIndexRange);
+
+	void bind();
+
+	GLsizei getStride() const { return stride; }
+	GLuint getVAO() const { return VAO; }
+	const RangeAllocator& getVertexAllocator() const { return vertexAllocator; }
+	const RangeAllocator& getIndexAllocator() const { return indexAllocator; }
+
+	void printStats() const;
+	static void PrintAllStats();
+
+private:
+	GeometryArena(VertexFormat format, GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity);
+
+	VertexFormat format;
+	GLsizei stride;
+	GLuint VAO, VBO, EBO;
+	RangeAllocator vertexAllocator;
+	RangeAllocator indexAllocator;
+
+	static GeometryArena* arenas[VERTEX_FORMAT_COUNT];
+
+	void setupVertexAttributes();
+	void growBuffer(GLenum target, GLuint& buffer, RangeAllocator& allocator, GLsizeiptr minimumFree);
+	void copyRange(GLuint buffer, const ArenaRange& source, const ArenaRange& destination);
+};
+
+#endif
@@ -0,0 +1,77 @@
+// HeadlessContext.cpp
+#include "HeadlessContext.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay headlessDisplay = EGL_NO_DISPLAY;
+static EGLContext headlessContext = EGL_NO_CONTEXT;
+
+bool CreateHeadlessContext()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == nullptr) {
+		std::cerr << "Headless context: eglGetPlatformDisplayEXT is not available" << std::endl;
+		return false;
+	}
+
+	headlessDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	EGLint major, minor;
+	if (headlessDisplay == EGL_NO_DISPLAY || !eglInitialize(headlessDisplay, &major, &minor)) {
+		std::cerr << "Headless context: no surfaceless EGL display" << std::endl;
+		headlessDisplay = EGL_NO_DISPLAY;
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cerr << "Headless context: desktop OpenGL is not supported" << std::endl;
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	// Surfaceless contexts need no config (EGL_KHR_no_config_context)
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	headlessContext = eglCreateContext(headlessDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (headlessContext == EGL_NO_CONTEXT || !eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, headlessContext)) {
+		std::cerr << "Headless context: unable to create an OpenGL 3.3 core context" << std::endl;
+		DestroyHeadlessContext();
+		return false;
+	}
+
+	std::cout << "Headless EGL " << major << "." << minor << " context created" << std::endl;
+	return true;
+}
+
+void DestroyHeadlessContext()
+{
+	if (headlessDisplay == EGL_NO_DISPLAY) {
+		return;
+	}
+	eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (headlessContext != EGL_NO_CONTEXT) {
+		eglDestroyContext(headlessDisplay, headlessContext);
+		headlessContext = EGL_NO_CONTEXT;
+	}
+	eglTerminate(headlessDisplay);
+	headlessDisplay = EGL_NO_DISPLAY;
+}
+
+#else
+
+bool CreateHeadlessContext()
+{
+	return false;
+}
+
+void DestroyHeadlessContext()
+{
+}
+
+#endif
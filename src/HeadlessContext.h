@@ -0,0 +1,11 @@
+// HeadlessContext.h
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+// OpenGL 3.3 core context without a window or display server (EGL surfaceless, e.g. Mesa llvmpipe).
+// Everything has to be rendered into framebuffer objects. Only available on Linux,
+// CreateHeadlessContext returns false elsewhere or when the driver does not support it.
+bool CreateHeadlessContext();
+void DestroyHeadlessContext();
+
+#endif
@@ -1,13 +1,19 @@
 #include "IBLSampler.h"
-
-IBLSampler::IBLSampler(Texture* hdrTexture, int numLights)
-    : hdrTexture(hdrTexture), numLights(numLights)
+#include "ResourceRegistry.h"
+#include "IrradianceMap.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+IBLSampler::IBLSampler(Texture* hdrTexture, int numLights, int relaxationIterations)
+    : hdrTexture(hdrTexture), numLights(numLights), relaxationIterations(relaxationIterations)
 {
     summedTextureArea = new SummedTextureArea<long double>(hdrTexture);
     calculateLights();
 }
 
 IBLSampler::~IBLSampler() {
+    delete summedTextureArea;
 }
 
 void IBLSampler::changeNumLights(int numLights) {
@@ -15,7 +21,170 @@ void IBLSampler::changeNumLights(int numLights) {
     calculateLights();
 }
 
+void IBLSampler::setRelaxationIterations(int iterations) {
+    relaxationIterations = std::max(iterations, 0);
+    calculateLights();
+}
+
+float IBLSampler::getIrradianceError() {
+    PROFILE_CPU_SCOPE("IrradianceError");
+    if (referenceIrradiance.empty()) {
+        BakeEnvironmentIrradiance(hdrTexture, IRRADIANCE_ERROR_MAP_SIZE, IRRADIANCE_ERROR_BLOCK_SIZE, referenceIrradiance);
+    }
+    BakeIrradianceCubemap(lights, IRRADIANCE_ERROR_MAP_SIZE, lightIrradiance);
+    return IrradianceError(lightIrradiance, referenceIrradiance);
+}
+
+void IBLSampler::setTexture(Texture* hdrTexture, float changeThreshold) {
+    PROFILE_CPU_SCOPE("UpdateEnvironmentFrame");
+
+    bool sameSize = hdrTexture->getWidth() == this->hdrTexture->getWidth() && hdrTexture->getHeight() == this->hdrTexture->getHeight();
+    int tileCountX = summedTextureArea->getTileCountX();
+    int tileCount = tileCountX * summedTextureArea->getTileCountY();
+    if (sameSize && tileEnergies.empty()) {
+        // First frame of a sequence, the energies and colors of the texture the table was built from
+        for (int i = 0; i < tileCount; i++) {
+            tileEnergies.push_back(sampleTileEnergy(i % tileCountX, i / tileCountX));
+            tileColors.push_back(tileColor(i % tileCountX, i / tileCountX));
+        }
+    }
+    this->hdrTexture = hdrTexture;
+    referenceIrradiance.clear();
+
+    if (!sameSize) {
+        // Nothing carries over but the splits, which are only a starting point
+        delete summedTextureArea;
+        summedTextureArea = new SummedTextureArea<long double>(hdrTexture);
+        tileCountX = summedTextureArea->getTileCountX();
+        tileCount = tileCountX * summedTextureArea->getTileCountY();
+        tileEnergies.clear();
+        tileColors.clear();
+        for (int i = 0; i < tileCount; i++) {
+            tileEnergies.push_back(sampleTileEnergy(i % tileCountX, i / tileCountX));
+            tileColors.push_back(tileColor(i % tileCountX, i / tileCountX));
+        }
+        changedTiles.assign(tileCount, true);
+        changedTileCount = tileCount;
+        lightRegions.clear();
+        lightColors.clear();
+    }
+    else {
+        // The reference energy only moves when a tile is rebuilt, so slow drift still adds up to a rebuild
+        changedTiles.assign(tileCount, false);
+        changedTileCount = 0;
+        for (int i = 0; i < tileCount; i++) {
+            float energy = sampleTileEnergy(i % tileCountX, i / tileCountX);
+            if (fabs(energy - tileEnergies[i]) > changeThreshold * std::max(energy, tileEnergies[i])) {
+                tileEnergies[i] = energy;
+                tileColors[i] = tileColor(i % tileCountX, i / tileCountX);
+                changedTiles[i] = true;
+                changedTileCount++;
+            }
+        }
+        summedTextureArea->updateTiles(hdrTexture, changedTiles);
+    }
+
+    coherentCuts = true;
+    calculateLights();
+}
+
+float IBLSampler::sampleTileEnergy(int tileX, int tileY) {
+    int xStart = tileX * SUMMED_AREA_TILE_SIZE;
+    int yStart = tileY * SUMMED_AREA_TILE_SIZE;
+    int xEnd = std::min(xStart + SUMMED_AREA_TILE_SIZE, (int)hdrTexture->getWidth());
+    int yEnd = std::min(yStart + SUMMED_AREA_TILE_SIZE, (int)hdrTexture->getHeight());
+
+    float energy = 0.0f;
+    for (int y = yStart; y < yEnd; y += IBL_CHANGE_SAMPLE_STRIDE) {
+        for (int x = xStart; x < xEnd; x += IBL_CHANGE_SAMPLE_STRIDE) {
+            energy += glm::dot(hdrTexture->getPixel(x, y), LUMINANCE_WEIGHTS);
+        }
+    }
+    return energy;
+}
+
+bool IBLSampler::isRegionChanged(const Region& region) {
+    if (changedTiles.empty()) {
+        return false;
+    }
+    int tileCountX = summedTextureArea->getTileCountX();
+    for (int tileY = region.y / SUMMED_AREA_TILE_SIZE; tileY <= (region.y + region.height - 1) / SUMMED_AREA_TILE_SIZE; tileY++) {
+        for (int tileX = region.x / SUMMED_AREA_TILE_SIZE; tileX <= (region.x + region.width - 1) / SUMMED_AREA_TILE_SIZE; tileX++) {
+            if (changedTiles[tileY * tileCountX + tileX]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Color is all pixel values added up
+Vector3 IBLSampler::regionColor(const Region& region, int index) {
+    if (!coherentCuts) {
+        return pixelSum(region);
+    }
+    // The same bounds over unchanged tiles as in the last cut, its color still holds
+    if (index < (int)lightRegions.size() && lightRegions[index] == region && !isRegionChanged(region)) {
+        return lightColors[index];
+    }
+
+    // Tiles inside the region from their sums, only the ones on its border pixel by pixel
+    Vector3 lightColor(0.0f);
+    int tileCountX = summedTextureArea->getTileCountX();
+    for (int tileY = region.y / SUMMED_AREA_TILE_SIZE; tileY <= (region.y + region.height - 1) / SUMMED_AREA_TILE_SIZE; tileY++) {
+        for (int tileX = region.x / SUMMED_AREA_TILE_SIZE; tileX <= (region.x + region.width - 1) / SUMMED_AREA_TILE_SIZE; tileX++) {
+            int xStart = std::max(region.x, tileX * SUMMED_AREA_TILE_SIZE);
+            int yStart = std::max(region.y, tileY * SUMMED_AREA_TILE_SIZE);
+            int xEnd = std::min(region.x + region.width, (tileX + 1) * SUMMED_AREA_TILE_SIZE);
+            int yEnd = std::min(region.y + region.height, (tileY + 1) * SUMMED_AREA_TILE_SIZE);
+            bool wholeTile = xStart == tileX * SUMMED_AREA_TILE_SIZE && yStart == tileY * SUMMED_AREA_TILE_SIZE
+                && (xEnd == (tileX + 1) * SUMMED_AREA_TILE_SIZE || xEnd == (int)hdrTexture->getWidth())
+                && (yEnd == (tileY + 1) * SUMMED_AREA_TILE_SIZE || yEnd == (int)hdrTexture->getHeight());
+            if (wholeTile) {
+                lightColor += tileColors[tileY * tileCountX + tileX];
+            }
+            else {
+                lightColor += pixelSum(Region(xStart, yStart, xEnd - xStart, yEnd - yStart));
+            }
+        }
+    }
+    return lightColor;
+}
+
+Vector3 IBLSampler::pixelSum(const Region& region) {
+    Vector3 sum(0.0f);
+    const float* pixels = hdrTexture->getHDRData();
+    if (pixels != nullptr) {
+        // Straight off the rows, same order as getPixel
+        int channels = hdrTexture->getChannels();
+        for (int j = region.y; j < region.y + region.height; ++j) {
+            const float* pixel = pixels + ((size_t)j * hdrTexture->getWidth() + region.x) * channels;
+            for (int i = 0; i < region.width; ++i, pixel += channels) {
+                sum += Vector3(pixel[0], pixel[1], pixel[2]);
+            }
+        }
+        return sum;
+    }
+    for (int j = region.y; j < region.y + region.height; ++j) {
+        for (int i = region.x; i < region.x + region.width; ++i) {
+            Vector3 pixel = hdrTexture->getPixel(i, j);
+            sum += pixel;
+        }
+    }
+    return sum;
+}
+
+Vector3 IBLSampler::tileColor(int tileX, int tileY) {
+    int xStart = tileX * SUMMED_AREA_TILE_SIZE;
+    int yStart = tileY * SUMMED_AREA_TILE_SIZE;
+    int xEnd = std::min(xStart + SUMMED_AREA_TILE_SIZE, (int)hdrTexture->getWidth());
+    int yEnd = std::min(yStart + SUMMED_AREA_TILE_SIZE, (int)hdrTexture->getHeight());
+    return pixelSum(Region(xStart, yStart, xEnd - xStart, yEnd - yStart));
+}
+
 void IBLSampler::calculateLights() {
+    PROFILE_CPU_SCOPE("MedianCut");
+
     // Use median cut algorithm here
     /*  n => log2(numLights)
     1.  Add the entire light probe image to the region list as a single region.
@@ -26,7 +195,13 @@ void IBLSampler::calculateLights() {
     5.  Convert equirectangular light sources to spherical light sources, for cube map rendering.
     */
 
+    assert(numLights <= MAX_LIGHTS);
     int n = log2(numLights);
+    reusedSplitCount = 0;
+    if ((int)splits.size() < (2 << n)) {
+        splits.resize(2 << n, 0);
+        splitImbalances.resize(2 << n, 0.0f);
+    }
 
     // Step 1
     std::vector<Region> regions;
@@ -37,7 +212,8 @@ void IBLSampler::calculateLights() {
     int equatorHeight = hdrTexture->getHeight() / 2;
 
     // Step 4, 5
-    lights.clear();
+    lights.numLights = 0;
+    std::vector<Vector3> regionColors;
     for (const Region& region : regions) {
         int x = region.x;
         int y = region.y;
@@ -47,32 +223,183 @@ void IBLSampler::calculateLights() {
         int width = region.width;
         int inclinedWidth = width * cosInclinationAngle;
         int height = region.height;
-        // Color is all pixel values added up
-        Vector3 lightColor(0.0f);
-        for (int j = y; j < y + height; ++j) {
-            for (int i = x; i < x + width; ++i) {
-                Vector3 pixel = hdrTexture->getPixel(i, j);
-                lightColor += pixel;
-            }
-        }
-        Light* light = new Light();
+        Vector3 lightColor = regionColor(region, (int)regionColors.size());
+        regionColors.push_back(lightColor);
+        Light& light = lights.lights[lights.numLights++];
         Vector2 centroid = Vector2(x + inclinedWidth / 2, y + height / 2);
-        light->position = equirectangularToCubemapProjection(Vector2(x + inclinedWidth / 2, y + height / 2), hdrTexture->getWidth(), hdrTexture->getHeight());
-        light->color = lightColor * Vector3(cosInclinationAngle);
-        light->intensity = 1.0f;
-        lights.push_back(light);
+        light.position = glm::normalize(equirectangularToCubemapProjection(centroid, hdrTexture->getWidth(), hdrTexture->getHeight()));
+        light.color = lightColor * Vector3(cosInclinationAngle); // Intensity 1
 
         // Print the light source
-        // std::cout << "Light source " << lights.size() << ":" << std::endl;
+        // std::cout << "Light source " << lights.numLights << ":" << std::endl;
         // std::cout << "Rect: (" << x << ", " << y << ", " << width << ", " << height << ")" << std::endl;
-        // std::cout << "Position: "; printVector3(light->position);
-        // std::cout << "Color: "; printVector3(light->color);
-        // std::cout << "Intensity: " << light->intensity << std::endl;
+        // std::cout << "Position: "; printVector3(light.position);
+        // std::cout << "Color: "; printVector3(light.color);
+
+    }
+    lightRegions = regions;
+    lightColors = regionColors;
 
+    if (relaxationIterations > 0) {
+        relaxLights();
     }
 }
 
-void IBLSampler::medianCut(Region& region, int depth, std::vector<Region>& regions) {
+// Pixels are weighted by their solid angle, the cosine of the latitude, like the median cut light
+// colors. A light takes the energy (luminance) weighted mean direction of its pixels, projected
+// onto the sphere, and the sum of their colors. The tiles of the summed area table are dealt out
+// to threads, each adding up its own sums, so the assignment needs no locking.
+void IBLSampler::relaxLights() {
+    PROFILE_CPU_SCOPE("LloydRelaxation");
+
+    const float* pixels = hdrTexture->getHDRData();
+    int lightCount = lights.numLights;
+    if (pixels == nullptr || lightCount < 2) {
+        return;
+    }
+    int width = hdrTexture->getWidth();
+    int height = hdrTexture->getHeight();
+    int channels = hdrTexture->getChannels();
+
+    // equirectangularToCubemapProjection at the pixel centers, separated into the cosine and sine
+    // of the azimuth per column and of the polar angle per row
+    std::vector<Vector2> columns(width), rows(height);
+    for (int x = 0; x < width; x++) {
+        float theta = 2.0f * glm::pi<float>() * (x + 0.5f) / width;
+        columns[x] = Vector2(cos(theta), sin(theta));
+    }
+    for (int y = 0; y < height; y++) {
+        float phi = glm::pi<float>() * (y + 0.5f) / height;
+        rows[y] = Vector2(sin(phi), cos(phi)); // The sine is also the solid angle weight
+    }
+
+    struct LightSums {
+        glm::dvec3 direction;
+        glm::dvec3 color;
+    };
+    int tileCountX = summedTextureArea->getTileCountX();
+    int tileCount = tileCountX * summedTextureArea->getTileCountY();
+    int threadCount = (int)std::max(1u, std::min((unsigned)tileCount, std::thread::hardware_concurrency()));
+    std::vector<std::vector<LightSums>> threadSums(threadCount, std::vector<LightSums>(lightCount));
+
+    auto pixelDirection = [&](int x, int y) {
+        return Vector3(-columns[x].x * rows[y].x, rows[y].y, columns[x].y * rows[y].x);
+    };
+
+    auto assignTiles = [&](int thread) {
+        std::vector<LightSums>& sums = threadSums[thread];
+        std::fill(sums.begin(), sums.end(), LightSums{ glm::dvec3(0.0), glm::dvec3(0.0) });
+        std::vector<int> candidates;
+        candidates.reserve(lightCount);
+        std::vector<float> angles(lightCount);
+        for (int tile = thread; tile < tileCount; tile += threadCount) {
+            int xStart = (tile % tileCountX) * SUMMED_AREA_TILE_SIZE;
+            int yStart = (tile / tileCountX) * SUMMED_AREA_TILE_SIZE;
+            int xEnd = std::min(xStart + SUMMED_AREA_TILE_SIZE, width);
+            int yEnd = std::min(yStart + SUMMED_AREA_TILE_SIZE, height);
+
+            // Only a light within the nearest one's angle plus the tile diameter of the tile's
+            // center can be the nearest to one of its pixels. The pixels furthest from the center
+            // of a latitude-longitude tile are its corners.
+            Vector3 center = pixelDirection((xStart + xEnd) / 2, (yStart + yEnd) / 2);
+            float radius = 0.0f;
+            for (int corner = 0; corner < 4; corner++) {
+                Vector3 cornerDirection = pixelDirection(corner & 1 ? xEnd - 1 : xStart, corner & 2 ? yEnd - 1 : yStart);
+                radius = std::max(radius, std::acos(glm::clamp(glm::dot(center, cornerDirection), -1.0f, 1.0f)));
+            }
+            float nearestAngle = glm::pi<float>();
+            for (int i = 0; i < lightCount; i++) {
+                angles[i] = std::acos(glm::clamp(glm::dot(center, lights.lights[i].position), -1.0f, 1.0f));
+                nearestAngle = std::min(nearestAngle, angles[i]);
+            }
+            candidates.clear();
+            for (int i = 0; i < lightCount; i++) {
+                if (angles[i] <= nearestAngle + 2.0f * radius + 1.0e-3f) {
+                    candidates.push_back(i);
+                }
+            }
+
+            for (int y = yStart; y < yEnd; y++) {
+                const float* pixel = pixels + ((size_t)y * width + xStart) * channels;
+                for (int x = xStart; x < xEnd; x++, pixel += channels) {
+                    Vector3 color = Vector3(pixel[0], pixel[1], pixel[2]) * rows[y].x;
+                    float energy = glm::dot(color, LUMINANCE_WEIGHTS);
+                    if (energy <= 0.0f) {
+                        continue;
+                    }
+                    Vector3 direction = pixelDirection(x, y);
+                    int nearest = candidates[0];
+                    float nearestCos = -2.0f;
+                    for (int i : candidates) {
+                        float cosAngle = glm::dot(direction, lights.lights[i].position);
+                        if (cosAngle > nearestCos) {
+                            nearestCos = cosAngle;
+                            nearest = i;
+                        }
+                    }
+                    sums[nearest].direction += glm::dvec3(direction * energy);
+                    sums[nearest].color += glm::dvec3(color);
+                }
+            }
+        }
+    };
+
+    auto moveLights = [&]() {
+        for (int i = 0; i < lightCount; i++) {
+            LightSums total = { glm::dvec3(0.0), glm::dvec3(0.0) };
+            for (const std::vector<LightSums>& sums : threadSums) {
+                total.direction += sums[i].direction;
+                total.color += sums[i].color;
+            }
+            // A light no pixel went to keeps its place, its energy went to its neighbours
+            if (glm::length(total.direction) > 0.0) {
+                lights.lights[i].position = Vector3(glm::normalize(total.direction));
+            }
+            lights.lights[i].color = Vector3(total.color);
+        }
+    };
+
+    // The threads live through every iteration. They meet once their tiles are assigned, and
+    // again once thread 0 moved the lights, before the next iteration reads the new positions.
+    std::mutex barrierMutex;
+    std::condition_variable barrierCondition;
+    int waitingThreads = 0;
+    int barrierGeneration = 0;
+    auto barrier = [&]() {
+        std::unique_lock<std::mutex> lock(barrierMutex);
+        int generation = barrierGeneration;
+        if (++waitingThreads == threadCount) {
+            waitingThreads = 0;
+            barrierGeneration++;
+            barrierCondition.notify_all();
+        }
+        else {
+            barrierCondition.wait(lock, [&] { return barrierGeneration != generation; });
+        }
+    };
+    auto relax = [&](int thread) {
+        for (int iteration = 0; iteration < relaxationIterations; iteration++) {
+            assignTiles(thread);
+            barrier();
+            if (thread == 0) {
+                moveLights();
+            }
+            barrier();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (int thread = 1; thread < threadCount; thread++) {
+        threads.emplace_back(relax, thread);
+    }
+    relax(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void IBLSampler::medianCut(Region& region, int depth, std::vector<Region>& regions, int node) {
     if (depth == 0) {
         regions.push_back(region);
         return;
@@ -95,10 +422,37 @@ void IBLSampler::medianCut(Region& region, int depth, std::vector<Region>& regio
     // Find the median position along the longest dimension
     auto energy = summedTextureArea->getArea(region);
     auto halfEnergy = energy / 2.0f;
+
+    // In a sequence, the split of the previous frame is kept while it divides the energy about as evenly as it did
+    int previous = node < (int)splits.size() ? splits[node] : 0;
+    int length = verticalCut ? width : height;
+    bool reused = false;
+    if (coherentCuts && previous > 0 && previous < length) {
+        Region r1 = region;
+        Region r2 = region;
+        if (verticalCut) {
+            r1.width = previous;
+            r2.width = width - previous;
+            r2.x = x + previous;
+        }
+        else {
+            r1.height = previous;
+            r2.height = height - previous;
+            r2.y = y + previous;
+        }
+        auto imbalance = fabsl(summedTextureArea->getArea(r1) - summedTextureArea->getArea(r2)) / fabsl(energy);
+        reused = imbalance <= splitImbalances[node] + 2.0f * IBL_SPLIT_TOLERANCE;
+    }
+
     // Use binary search to find the median position
     int left = 0.0f;
     int median = 0.0f;
-    int right = verticalCut ? width : height;
+    int right = length;
+    if (reused) {
+        median = previous;
+        left = right + 1; // Skip the search
+        reusedSplitCount++;
+    }
     while (left <= right) {
         median = (left + right) / 2;
         Region r1 = region;
@@ -152,9 +506,15 @@ void IBLSampler::medianCut(Region& region, int depth, std::vector<Region>& regio
     // std::cout << "Rect2: (" << r2.x << ", " << r2.y << ", " << r2.width << ", " << r2.height << ")" << std::endl;
     // std::cout << std::endl;
 
+    if (node < (int)splits.size()) {
+        // The search stops at a whole pixel, so an even split is rarely exact
+        splits[node] = median;
+        splitImbalances[node] = energy != 0.0f ? (float)(fabsl(summedTextureArea->getArea(r1) - summedTextureArea->getArea(r2)) / fabsl(energy)) : 0.0f;
+    }
+
     // Recurse
-    medianCut(r1, depth - 1, regions);
-    if(r1 != r2) medianCut(r2, depth - 1, regions);
+    medianCut(r1, depth - 1, regions, node * 2);
+    if(r1 != r2) medianCut(r2, depth - 1, regions, node * 2 + 1);
 }
 
 void IBLSampler::updateLighting() {
@@ -162,21 +522,52 @@ void IBLSampler::updateLighting() {
 }
 
 template <typename T>
-SummedTextureArea<T>::SummedTextureArea(Texture* texture) {
+SummedTextureArea<T>::SummedTextureArea(Texture* texture, const Vector3& weights)
+    : weights(weights)
+{
+    PROFILE_CPU_SCOPE("SummedAreaTable");
+
     width = texture->getWidth();
     height = texture->getHeight();
+    tileCountX = (width + SUMMED_AREA_TILE_SIZE - 1) / SUMMED_AREA_TILE_SIZE;
+    tileCountY = (height + SUMMED_AREA_TILE_SIZE - 1) / SUMMED_AREA_TILE_SIZE;
     containers = new std::vector<SummedTextureAreaContainer<T>*>();
     calculateSummedAreaTable(texture);
+    calculatePrefixes();
+
+    // Kept for the lifetime of the sampler, changing the light count cuts the environment again
+    size_t bytes = ((size_t)width * height + wholeTiles.size() + rowPrefixes.size() + columnPrefixes.size()) * sizeof(T);
+    std::string name = "summed area table " + std::to_string(width) + "x" + std::to_string(height);
+    ResourceRegistry::Get()->Track(RESOURCE_CPU, (uintptr_t)this, name, bytes);
 }
 
 template <typename T>
 SummedTextureArea<T>::~SummedTextureArea() {
-    for (SummedTextureAreaContainer<T>* container : containers) {
+    ResourceRegistry::Get()->Release(RESOURCE_CPU, (uintptr_t)this);
+    for (SummedTextureAreaContainer<T>* container : *containers) {
         delete container;
     }
     delete containers;
 }
 
+template <typename T>
+void SummedTextureArea<T>::updateTiles(Texture* texture, const std::vector<bool>& changedTiles) {
+    PROFILE_CPU_SCOPE("UpdateSummedAreaTiles");
+    assert((int)texture->getWidth() == width && (int)texture->getHeight() == height);
+    assert(changedTiles.size() == containers->size());
+
+    bool anyChanged = false;
+    for (size_t i = 0; i < containers->size(); i++) {
+        if (changedTiles[i]) {
+            containers->at(i)->calculate(texture, weights);
+            anyChanged = true;
+        }
+    }
+    if (anyChanged) {
+        calculatePrefixes(&changedTiles);
+    }
+}
+
 template <typename T>
 T SummedTextureArea<T>::getArea(const Region& region) {
     int startX = region.x;
@@ -192,60 +583,120 @@ T SummedTextureArea<T>::getArea(const Region& region) {
     return D - B - C + A;
 }
 
+// The sum over every tile whose origin is above and left of (x, y), each read at (x, y) clamped
+// into the tile: the whole tiles before the point's tile row and column, the tiles left of it in
+// its row, the tiles above it in its column and the tile it is in.
 template <typename T>
 T SummedTextureArea<T>::getArea(int x, int y) {
     if (x < 0 || x >= width || y < 0 || y >= height) {
         return 0.0f;
     }
-
-    // Find the containers that contain the needed area
-    bool isRegionOnLeft; // If point is on the left of the region
-    bool isRegionOnTop; // If point is on the top of the region
-    T area = 0.0f;
-    for (SummedTextureAreaContainer<T>* container : *containers) {
-        Region region = container->getRegion();
-        if (x > region.x && y > region.y) {
-
-            int localX = x - region.x;
-            int localY = y - region.y;
-            // Clamp the local coordinates
-            localX = glm::clamp(localX, 0, region.width - 1);
-            localY = glm::clamp(localY, 0, region.height - 1);
-            area += container->getArea(localX, localY);
-        }
+    if (x == 0 || y == 0) {
+        return 0.0f; // No tile origin is strictly above and left of the point
     }
 
+    int tileX = (x - 1) / SUMMED_AREA_TILE_SIZE;
+    int tileY = (y - 1) / SUMMED_AREA_TILE_SIZE;
+    SummedTextureAreaContainer<T>* container = containers->at(tileY * tileCountX + tileX);
+    Region region = container->getRegion();
+    int localX = glm::clamp(x - region.x, 0, region.width - 1);
+    int localY = glm::clamp(y - region.y, 0, region.height - 1);
+
+    T area = wholeTiles[tileY * (tileCountX + 1) + tileX];
+    area += rowPrefixes[(tileY * (tileCountX + 1) + tileX) * SUMMED_AREA_TILE_SIZE + localY];
+    area += columnPrefixes[(tileX * (tileCountY + 1) + tileY) * SUMMED_AREA_TILE_SIZE + localX];
+    area += container->getArea(localX, localY);
     return area;
 }
 
 template <typename T>
 void SummedTextureArea<T>::calculateSummedAreaTable(Texture* texture) {
-    // FORMULA: Y = (0.2125)R + (0.7154)G + 0.0721B
-    float rWeight = 0.2125f;
-    float gWeight = 0.7154f;
-    float bWeight = 0.0721f;
-    
     // Create region containers
-    int regionWidth = 32;
-    int regionHeight = 32;
+    int regionWidth = SUMMED_AREA_TILE_SIZE;
+    int regionHeight = SUMMED_AREA_TILE_SIZE;
     for (int y = 0; y < height; y += regionHeight) {
         for (int x = 0; x < width; x += regionWidth) {
-            Region region(x, y, regionWidth, regionHeight);
-            SummedTextureAreaContainer<T>* container = new SummedTextureAreaContainer<T>(region, texture);
+            // Edge containers are clipped to the texture, the maps are not multiples of the container size
+            Region region(x, y, std::min(regionWidth, width - x), std::min(regionHeight, height - y));
+            SummedTextureAreaContainer<T>* container = new SummedTextureAreaContainer<T>(region, texture, weights);
             containers->push_back(container);
         }
     }
 }
 
+// A tile a query passes completely is read at its clamped corner (width - 1, height - 1). The
+// tiles left of the query in its tile row are read at (width - 1, localY), so their sums are kept
+// per localY; the tiles above it in its tile column likewise per localX.
 template <typename T>
-SummedTextureAreaContainer<T>::SummedTextureAreaContainer(Region region, Texture* texture)
+void SummedTextureArea<T>::calculatePrefixes(const std::vector<bool>* changedTiles) {
+    auto tile = [this](int tileX, int tileY) { return containers->at(tileY * tileCountX + tileX); };
+
+    // The edge sums of a tile row or column only change with one of its tiles
+    std::vector<bool> rowChanged(tileCountY, changedTiles == nullptr);
+    std::vector<bool> columnChanged(tileCountX, changedTiles == nullptr);
+    if (changedTiles != nullptr) {
+        for (int i = 0; i < tileCountX * tileCountY; i++) {
+            if ((*changedTiles)[i]) {
+                rowChanged[i / tileCountX] = true;
+                columnChanged[i % tileCountX] = true;
+            }
+        }
+    }
+
+    wholeTiles.assign((tileCountY + 1) * (tileCountX + 1), 0.0f);
+    for (int tileY = 0; tileY < tileCountY; tileY++) {
+        T rowSum = 0.0f;
+        for (int tileX = 0; tileX < tileCountX; tileX++) {
+            Region region = tile(tileX, tileY)->getRegion();
+            rowSum += tile(tileX, tileY)->getArea(region.width - 1, region.height - 1);
+            wholeTiles[(tileY + 1) * (tileCountX + 1) + tileX + 1] = wholeTiles[tileY * (tileCountX + 1) + tileX + 1] + rowSum;
+        }
+    }
+
+    rowPrefixes.resize(tileCountY * (tileCountX + 1) * SUMMED_AREA_TILE_SIZE, 0.0f);
+    for (int tileY = 0; tileY < tileCountY; tileY++) {
+        if (!rowChanged[tileY]) {
+            continue;
+        }
+        for (int tileX = 0; tileX < tileCountX; tileX++) {
+            Region region = tile(tileX, tileY)->getRegion();
+            const T* previous = &rowPrefixes[(tileY * (tileCountX + 1) + tileX) * SUMMED_AREA_TILE_SIZE];
+            T* next = &rowPrefixes[(tileY * (tileCountX + 1) + tileX + 1) * SUMMED_AREA_TILE_SIZE];
+            for (int localY = 1; localY < region.height; localY++) {
+                next[localY] = previous[localY] + tile(tileX, tileY)->getArea(region.width - 1, localY);
+            }
+        }
+    }
+
+    columnPrefixes.resize(tileCountX * (tileCountY + 1) * SUMMED_AREA_TILE_SIZE, 0.0f);
+    for (int tileX = 0; tileX < tileCountX; tileX++) {
+        if (!columnChanged[tileX]) {
+            continue;
+        }
+        for (int tileY = 0; tileY < tileCountY; tileY++) {
+            Region region = tile(tileX, tileY)->getRegion();
+            const T* previous = &columnPrefixes[(tileX * (tileCountY + 1) + tileY) * SUMMED_AREA_TILE_SIZE];
+            T* next = &columnPrefixes[(tileX * (tileCountY + 1) + tileY + 1) * SUMMED_AREA_TILE_SIZE];
+            for (int localX = 1; localX < region.width; localX++) {
+                next[localX] = previous[localX] + tile(tileX, tileY)->getArea(localX, region.height - 1);
+            }
+        }
+    }
+}
+
+template <typename T>
+SummedTextureAreaContainer<T>::SummedTextureAreaContainer(Region region, Texture* texture, const Vector3& weights)
     : region(region)
 {
-    float rWeight = 0.2125f;
-    float gWeight = 0.7154f;
-    float bWeight = 0.0721f;
     summedAreaTable = new std::vector<T>(region.width * region.height, 0.0f);
+    calculate(texture, weights);
+}
 
+template <typename T>
+void SummedTextureAreaContainer<T>::calculate(Texture* texture, const Vector3& weights) {
+    float rWeight = weights.x;
+    float gWeight = weights.y;
+    float bWeight = weights.z;
 
     // Calculate the summed area table
     int width = region.width;
@@ -300,4 +751,7 @@ Vector3 equirectangularToCubemapProjection(const Vector2& v, int width, int heig
     float z = sin(theta) * sin(phi);
 
     return -Vector3(x, y, z);
-}
\ No newline at end of file
+}
+// The templates are defined here, instantiate the one the sampler (and the benchmarks) use
+template class SummedTextureArea<long double>;
+template class SummedTextureAreaContainer<long double>;
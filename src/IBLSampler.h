@@ -4,6 +4,7 @@
 #include "typedefs.h"
 #include "Texture.h"
 #include "Light.h"
+#include "Profiler.h"
 #include <vector>
 #include <glm/glm.hpp>
 #include <GL/glew.h>
@@ -27,14 +28,20 @@ struct Region {
     }
 };
 
+// Side of the square tiles the summed area table is split into, the last row and column are clipped
+const int SUMMED_AREA_TILE_SIZE = 32;
+// Y = (0.2125)R + (0.7154)G + 0.0721B, the energy the median cut splits evenly
+const Vector3 LUMINANCE_WEIGHTS = Vector3(0.2125f, 0.7154f, 0.0721f);
+
 template <typename T>
 class SummedTextureAreaContainer { // This class will hold parts of the summed area table
 private:
     Region region; // The region of texture spanned by this container
     std::vector<T>* summedAreaTable; // The summed area table
 public:
-    SummedTextureAreaContainer(Region region, Texture* texture);
+    SummedTextureAreaContainer(Region region, Texture* texture, const Vector3& weights);
     ~SummedTextureAreaContainer() { delete summedAreaTable; }
+    void calculate(Texture* texture, const Vector3& weights); // Rebuilds the table from the texture
     T getArea(int x, int y)
     {
         return summedAreaTable->at((y-1) * region.width + x-1);
@@ -43,41 +50,114 @@ public:
     std::vector<T>* getSummedAreaTable() { return summedAreaTable; }
 };
 
+// Each tile keeps its own table. Prefix sums over the tiles (whole tiles above and left of a
+// point, and the edge rows/columns of the tiles in its tile row/column) make a query four
+// lookups no matter how many tiles there are, and let a changed tile be rebuilt on its own.
 template <typename T>
 class SummedTextureArea {
 public:
-    SummedTextureArea(Texture* texture);
+    // weights turn the RGB pixels into the summed value, e.g. (1, 0, 0) for the red channel
+    SummedTextureArea(Texture* texture, const Vector3& weights = LUMINANCE_WEIGHTS);
     T getArea(const Region& region);
     ~SummedTextureArea();
 
+    // Rebuilds the tiles flagged in changedTiles (row major, getTileCountX() per row) from the
+    // texture, which must have the size of the original one. The other tiles keep their sums.
+    void updateTiles(Texture* texture, const std::vector<bool>& changedTiles);
+
+    int getTileCountX() const { return tileCountX; }
+    int getTileCountY() const { return tileCountY; }
+
 private:
     std::vector<SummedTextureAreaContainer<T>*>* containers;
     int width, height;
+    int tileCountX, tileCountY;
+    Vector3 weights;
+
+    // The sums of the tiles a query passes over completely, see calculatePrefixes
+    std::vector<T> wholeTiles; // (tileCountY + 1) x (tileCountX + 1)
+    std::vector<T> rowPrefixes; // tileCountY x (tileCountX + 1) x SUMMED_AREA_TILE_SIZE
+    std::vector<T> columnPrefixes; // tileCountX x (tileCountY + 1) x SUMMED_AREA_TILE_SIZE
+
     void calculateSummedAreaTable(Texture* texture);
+    void calculatePrefixes(const std::vector<bool>* changedTiles = nullptr); // nullptr: all tiles
     T getArea(int x, int y);
 };
 
 Vector3 equirectangularToCubemapProjection(const Vector2& v, int width, int height);
 
+// Environment sequences (setTexture): a summed area tile is rebuilt once the sampled energy of
+// the tile changed by more than this fraction
+const float IBL_TILE_CHANGE_THRESHOLD = 0.02f;
+// Every IBL_CHANGE_SAMPLE_STRIDE-th pixel of a tile in both directions goes into its sampled energy
+const int IBL_CHANGE_SAMPLE_STRIDE = 4;
+// A split of the previous frame is kept while neither half moved further than this fraction of
+// the region energy away from where it was when the split was found
+const float IBL_SPLIT_TOLERANCE = 0.01f;
+// Lloyd iterations after the median cut when the refinement is on (setRelaxationIterations)
+const int IBL_RELAXATION_ITERATIONS = 4;
+
 class IBLSampler {
 public:
-    IBLSampler(Texture* hdrTexture, int numLights);
+    // relaxationIterations > 0 refines the median cut lights, see setRelaxationIterations
+    IBLSampler(Texture* hdrTexture, int numLights, int relaxationIterations = 0);
     ~IBLSampler();
 
     void updateLighting();
 
     void changeNumLights(int numLights);
+    // Weighted k-means (Lloyd) on the sphere after the median cut, seeded by its lights. The cut
+    // splits on energy alone, so at small counts its lights sit off the energy centroids. Every
+    // iteration gives each pixel to the nearest light and moves the lights to the centroids of
+    // their pixels. 0 turns it off. Extracts the lights again.
+    void setRelaxationIterations(int iterations);
+    int getRelaxationIterations() const { return relaxationIterations; }
+
+    // Relative RMS error of the diffuse irradiance of the lights against the environment's own
+    // (IrradianceError). The reference is integrated once per texture by a brute force pass over
+    // the environment, too slow for the render thread, so only the tools (cpuBenchmark) ask for it.
+    float getIrradianceError();
 
-    std::vector<Light*>* getLights() { return &lights; }
+    // Next frame of an environment sequence, the same size as the current texture. Only the tiles
+    // of the summed area table that changed beyond changeThreshold are rebuilt, and the median cut
+    // starts from the previous frame's splits, so lights of a steady environment stay put. The
+    // texture has to stay alive until the next call.
+    void setTexture(Texture* hdrTexture, float changeThreshold = IBL_TILE_CHANGE_THRESHOLD);
+    int getChangedTileCount() const { return changedTileCount; } // In the last setTexture
+    int getReusedSplitCount() const { return reusedSplitCount; } // In the last cut
+
+    // Stored in the std140 layout of the Lights block, MeshRenderer copies them as they are
+    const LightBlock* getLights() const { return &lights; }
 
 private:
     Texture* hdrTexture;
-    std::vector<Light*> lights;
+    LightBlock lights;
     SummedTextureArea<long double>* summedTextureArea;
     int numLights;
+    int relaxationIterations;
+    std::vector<float> referenceIrradiance; // Of hdrTexture, built by the first getIrradianceError
+    std::vector<float> lightIrradiance;
+
+    // Temporal coherence, used once setTexture was called
+    bool coherentCuts = false;
+    std::vector<int> splits; // Median of every node of the last cut in heap order (root 1), 0 if not cut
+    std::vector<float> splitImbalances; // |left - right| / energy of those medians
+    std::vector<float> tileEnergies; // Sampled energy per summed area tile
+    std::vector<bool> changedTiles; // Tiles rebuilt by the last setTexture
+    std::vector<Vector3> tileColors; // Pixel sum per summed area tile, light colors add these up
+    std::vector<Region> lightRegions; // Regions and colors of the last cut, colors are reused
+    std::vector<Vector3> lightColors; // for regions that kept their bounds and tiles
+    int changedTileCount = 0;
+    int reusedSplitCount = 0;
 
     void calculateLights(); // Use the median cut algorithm here
-    void medianCut(Region& region, int depth, std::vector<Region>& regions);
+    void medianCut(Region& region, int depth, std::vector<Region>& regions, int node = 1);
+    void relaxLights();
+    Vector3 regionColor(const Region& region, int index);
+    Vector3 pixelSum(const Region& region);
+    Vector3 tileColor(int tileX, int tileY);
+    bool isRegionChanged(const Region& region);
+    float sampleTileEnergy(int tileX, int tileY);
 };
 
 #endif
@@ -0,0 +1,93 @@
+// IrradianceMap.cpp
+#include "IrradianceMap.h"
+#include "IBLSampler.h"
+#include <cmath>
+
+Vector3 CubemapTexelDirection(int face, int x, int y, int size)
+{
+	float u = 2.0f * (x + 0.5f) / size - 1.0f;
+	float v = 2.0f * (y + 0.5f) / size - 1.0f;
+
+	Vector3 direction;
+	switch (face) {
+		case 0: direction = Vector3(1.0f, -v, -u); break; // +X
+		case 1: direction = Vector3(-1.0f, -v, u); break; // -X
+		case 2: direction = Vector3(u, 1.0f, v); break; // +Y
+		case 3: direction = Vector3(u, -1.0f, -v); break; // -Y
+		case 4: direction = Vector3(u, -v, 1.0f); break; // +Z
+		default: direction = Vector3(-u, -v, -1.0f); break; // -Z
+	}
+	return glm::normalize(direction);
+}
+
+void BakeIrradianceCubemap(const LightBlock& lights, int size, std::vector<float>& texels)
+{
+	BakeIrradianceCubemap(lights.lights, lights.numLights, size, texels);
+}
+
+void BakeIrradianceCubemap(const Light* lights, int lightCount, int size, std::vector<float>& texels)
+{
+	texels.assign((size_t)size * size * 6 * 3, 0.0f);
+	float* texel = texels.data();
+	for (int face = 0; face < 6; face++) {
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				Vector3 normal = CubemapTexelDirection(face, x, y, size);
+				Vector3 irradiance(0.0f);
+				for (int i = 0; i < lightCount; i++) {
+					irradiance += lights[i].color * glm::max(-glm::dot(normal, lights[i].position), 0.0f);
+				}
+				texel[0] = irradiance.x;
+				texel[1] = irradiance.y;
+				texel[2] = irradiance.z;
+				texel += 3;
+			}
+		}
+	}
+}
+
+void EnvironmentBlockLights(Texture* environment, int blockSize, std::vector<Light>& blocks)
+{
+	int width = environment->getWidth();
+	int height = environment->getHeight();
+	blocks.clear();
+	blocks.reserve((size_t)((width + blockSize - 1) / blockSize) * ((height + blockSize - 1) / blockSize));
+	for (int y = 0; y < height; y += blockSize) {
+		int blockHeight = std::min(blockSize, height - y);
+		for (int x = 0; x < width; x += blockSize) {
+			int blockWidth = std::min(blockSize, width - x);
+			Light block = {};
+			Vector2 center(x + blockWidth / 2.0f, y + blockHeight / 2.0f);
+			block.position = glm::normalize(equirectangularToCubemapProjection(center, width, height));
+			for (int j = y; j < y + blockHeight; j++) {
+				float solidAngle = std::sin(glm::pi<float>() * (j + 0.5f) / height);
+				for (int i = x; i < x + blockWidth; i++) {
+					block.color += environment->getPixel(i, j) * solidAngle;
+				}
+			}
+			blocks.push_back(block);
+		}
+	}
+}
+
+void BakeEnvironmentIrradiance(Texture* environment, int size, int blockSize, std::vector<float>& texels)
+{
+	std::vector<Light> blocks;
+	EnvironmentBlockLights(environment, blockSize, blocks);
+	BakeIrradianceCubemap(blocks.data(), (int)blocks.size(), size, texels);
+}
+
+float IrradianceError(const std::vector<float>& texels, const std::vector<float>& reference)
+{
+	assert(texels.size() == reference.size());
+	double error = 0.0, norm = 0.0;
+	for (size_t i = 0; i + 2 < texels.size(); i += 3) {
+		Vector3 texel(texels[i], texels[i + 1], texels[i + 2]);
+		Vector3 expected(reference[i], reference[i + 1], reference[i + 2]);
+		double difference = glm::dot(texel - expected, LUMINANCE_WEIGHTS);
+		double luminance = glm::dot(expected, LUMINANCE_WEIGHTS);
+		error += difference * difference;
+		norm += luminance * luminance;
+	}
+	return norm > 0.0 ? (float)std::sqrt(error / norm) : 0.0f;
+}
@@ -0,0 +1,40 @@
+// IrradianceMap.h
+#ifndef IRRADIANCE_MAP_H
+#define IRRADIANCE_MAP_H
+
+#include "typedefs.h"
+#include "Light.h"
+#include "Texture.h"
+#include <vector>
+
+// Face size of the baked diffuse irradiance cubemap. Irradiance is a sum of clamped cosine
+// lobes, smooth enough that a few texels per face interpolate it well.
+const int IRRADIANCE_MAP_SIZE = 32;
+// Face size and environment block size the irradiance error is measured with (IBLSampler)
+const int IRRADIANCE_ERROR_MAP_SIZE = 16;
+const int IRRADIANCE_ERROR_BLOCK_SIZE = 8;
+
+// Direction through the center of a texel, faces in GL order (+X, -X, +Y, -Y, +Z, -Z)
+Vector3 CubemapTexelDirection(int face, int x, int y, int size);
+
+// Lambertian irradiance of the lights treated as directional (distant) lights for every texel:
+// E(n) = sum(color * max(dot(n, -position), 0)). The median cut light positions
+// are unit directions, the light arrives from -position as in specular_disco.frag.
+// texels receives size * size * 6 RGB floats, face by face.
+void BakeIrradianceCubemap(const LightBlock& lights, int size, std::vector<float>& texels);
+void BakeIrradianceCubemap(const Light* lights, int lightCount, int size, std::vector<float>& texels);
+
+// Every blockSize square of environment pixels as one light at its center, with the pixel sum
+// weighted by solid angle (the cosine of the latitude) like the median cut light colors
+void EnvironmentBlockLights(Texture* environment, int blockSize, std::vector<Light>& blocks);
+
+// The irradiance of the environment itself for the same texels, the reference the lights are
+// measured against. Every blockSize square of pixels is one light at its center, a few degrees
+// the cosine lobe does not resolve. Pixels are weighted by their solid angle (the cosine of the
+// latitude) like the median cut light colors, so the two are in the same units.
+void BakeEnvironmentIrradiance(Texture* environment, int size, int blockSize, std::vector<float>& texels);
+
+// Relative RMS error of the texel luminance: sqrt(sum (Y - Yref)^2 / sum Yref^2)
+float IrradianceError(const std::vector<float>& texels, const std::vector<float>& reference);
+
+#endif
@@ -2,23 +2,30 @@
 #define LIGHT_H
 
 #include <glm/glm.hpp>
+#include <cstddef>
 #include "typedefs.h"
 #include "printExtensions.h"
 
-class Light {
-public:
-	int id;
-	Vector3 position; // position of the light source
-	Vector3 color;
-	float intensity;
+// Upper bound of the light count, MAX_LIGHTS in lighting.glsl
+const int MAX_LIGHTS = 128;
 
-	Light()
-	{
-		id = 0;
-		position = Vector3(0.0f, 0.0f, 0.0f);
-		color = Vector3(1.0f, 1.0f, 1.0f);
-		intensity = 1.0f;
-	}
+// A median cut light in the std140 layout of LightSource (lighting.glsl), so the lights are
+// uploaded as they are stored
+struct Light {
+	Vector3 position; // Unit direction in environment space, the light arrives from -position
+	float padding0;
+	Vector3 color; // Radiance, the intensity is premultiplied
+	float padding1;
+};
+
+// The Lights uniform block (std140), lights past numLights are left as they were
+struct LightBlock {
+	int numLights = 0;
+	int padding[3];
+	Light lights[MAX_LIGHTS];
+
+	// Bytes from the start of the block up to and including the used lights
+	size_t usedSize() const { return offsetof(LightBlock, lights) + numLights * sizeof(Light); }
 };
 
 #endif
\ No newline at end of file
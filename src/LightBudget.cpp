@@ -0,0 +1,146 @@
+// LightBudget.cpp
+#include "LightBudget.h"
+#include "IrradianceMap.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+void ComputeLightResponse(const Light* lights, int lightCount, int gridSize, LightResponse& response, int threadCount)
+{
+	int texelCount = gridSize * gridSize * 6;
+	response.gridSize = gridSize;
+	response.diffuse.assign((size_t)texelCount * 3, 0.0f);
+	response.glossy.assign((size_t)texelCount * 3, 0.0f);
+	if (threadCount <= 0) {
+		threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	}
+	threadCount = std::max(1, std::min(threadCount, texelCount));
+
+	// The grid direction is the normal of the diffuse response and the reflection direction of
+	// the glossy one, so both share the cosine
+	auto computeTexels = [&](int thread) {
+		for (int texel = thread; texel < texelCount; texel += threadCount) {
+			int face = texel / (gridSize * gridSize);
+			int x = texel % gridSize;
+			int y = texel / gridSize % gridSize;
+			Vector3 direction = CubemapTexelDirection(face, x, y, gridSize);
+			Vector3 diffuse(0.0f), glossy(0.0f);
+			for (int i = 0; i < lightCount; i++) {
+				float cosine = -glm::dot(direction, lights[i].position);
+				if (cosine > 0.0f) {
+					diffuse += lights[i].color * cosine;
+					glossy += lights[i].color * std::pow(cosine, LIGHT_BUDGET_GLOSSY_EXPONENT);
+				}
+			}
+			for (int c = 0; c < 3; c++) {
+				response.diffuse[(size_t)texel * 3 + c] = diffuse[c];
+				response.glossy[(size_t)texel * 3 + c] = glossy[c];
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (int thread = 1; thread < threadCount; thread++) {
+		threads.emplace_back(computeTexels, thread);
+	}
+	computeTexels(0);
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void ComputeEnvironmentResponse(Texture* environment, int gridSize, int blockSize, LightResponse& response, int threadCount)
+{
+	PROFILE_CPU_SCOPE("EnvironmentResponse");
+	std::vector<Light> blocks;
+	EnvironmentBlockLights(environment, blockSize, blocks);
+	ComputeLightResponse(blocks.data(), (int)blocks.size(), gridSize, response, threadCount);
+}
+
+LightBudget ChooseLightBudget(IBLSampler& sampler, const LightResponse& reference, float tolerance,
+	std::vector<LightBudgetEntry>* entries)
+{
+	LightBudget budget;
+	budget.tolerance = tolerance;
+	budget.relaxationIterations = sampler.getRelaxationIterations();
+
+	LightResponse response;
+	for (int lightCount = 1; lightCount <= MAX_LIGHTS; lightCount *= 2) {
+		sampler.changeNumLights(lightCount);
+		const LightBlock* lights = sampler.getLights();
+		ComputeLightResponse(lights->lights, lights->numLights, reference.gridSize, response);
+
+		LightBudgetEntry entry;
+		entry.lightCount = lightCount;
+		entry.diffuseError = IrradianceError(response.diffuse, reference.diffuse);
+		entry.glossyError = IrradianceError(response.glossy, reference.glossy);
+		if (entries != nullptr) {
+			entries->push_back(entry);
+		}
+
+		bool withinTolerance = entry.diffuseError <= tolerance && entry.glossyError <= tolerance;
+		if (withinTolerance || lightCount == MAX_LIGHTS) {
+			budget.lightCount = lightCount;
+			budget.diffuseError = entry.diffuseError;
+			budget.glossyError = entry.glossyError;
+			budget.withinTolerance = withinTolerance;
+			break;
+		}
+	}
+	return budget;
+}
+
+std::string LightBudgetPath(const std::string& environmentPath)
+{
+	return environmentPath + LIGHT_BUDGET_EXTENSION;
+}
+
+bool SaveLightBudget(const std::string& path, const LightBudget& budget)
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "LightBudget: unable to open " << path << std::endl;
+		return false;
+	}
+	file << "lightCount " << budget.lightCount << "\n"
+		<< "relaxationIterations " << budget.relaxationIterations << "\n"
+		<< "tolerance " << budget.tolerance << "\n"
+		<< "diffuseError " << budget.diffuseError << "\n"
+		<< "glossyError " << budget.glossyError << "\n"
+		<< "withinTolerance " << (budget.withinTolerance ? 1 : 0) << "\n";
+	return true;
+}
+
+bool LoadLightBudget(const std::string& path, LightBudget& budget)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		return false;
+	}
+	LightBudget loaded;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string key;
+		if (!(stream >> key)) {
+			continue;
+		}
+		if (key == "lightCount") stream >> loaded.lightCount;
+		else if (key == "relaxationIterations") stream >> loaded.relaxationIterations;
+		else if (key == "tolerance") stream >> loaded.tolerance;
+		else if (key == "diffuseError") stream >> loaded.diffuseError;
+		else if (key == "glossyError") stream >> loaded.glossyError;
+		else if (key == "withinTolerance") stream >> loaded.withinTolerance;
+	}
+	if (loaded.lightCount < 1 || loaded.lightCount > MAX_LIGHTS) {
+		std::cerr << "LightBudget: no valid light count in " << path << std::endl;
+		return false;
+	}
+	budget = loaded;
+	return true;
+}
@@ -0,0 +1,72 @@
+// LightBudget.h
+#ifndef LIGHT_BUDGET_H
+#define LIGHT_BUDGET_H
+
+#include "typedefs.h"
+#include "Light.h"
+#include "Texture.h"
+#include "IBLSampler.h"
+#include <string>
+#include <vector>
+
+// Face size of the normal grid the responses are compared on, one normal per cubemap texel
+const int LIGHT_BUDGET_GRID_SIZE = 16;
+// Environment block size of the ground truth, every block is one light at its center (EnvironmentBlockLights)
+const int LIGHT_BUDGET_BLOCK_SIZE = 4;
+// Phong exponent of the glossy lobe around the reflection direction. glossy.frag uses Blinn-Phong
+// with 32, and a Blinn-Phong exponent is about four times the Phong one of the same lobe.
+const float LIGHT_BUDGET_GLOSSY_EXPONENT = 8.0f;
+// Largest relative RMS error of both responses the chosen light count may have. The glossy lobe
+// is the harder one, point lights only approach it once they are a few degrees apart.
+const float LIGHT_BUDGET_TOLERANCE = 0.2f;
+// The budget of an environment is stored next to it, e.g. Beach.hdr.lights
+const std::string LIGHT_BUDGET_EXTENSION = ".lights";
+
+// Diffuse and glossy response of distant lights over the normal grid, RGB per texel, face by face
+// like BakeIrradianceCubemap. Diffuse is the irradiance sum(color * max(dot(n, -position), 0)),
+// glossy is sum(color * max(dot(r, -position), 0)^LIGHT_BUDGET_GLOSSY_EXPONENT) for the normal as
+// the reflection direction r, so every grid direction is a view of the lobe.
+struct LightResponse
+{
+	int gridSize = 0;
+	std::vector<float> diffuse;
+	std::vector<float> glossy;
+};
+
+// The response of the lights, the grid normals are split across threadCount threads
+// (0: one per hardware thread)
+void ComputeLightResponse(const Light* lights, int lightCount, int gridSize, LightResponse& response, int threadCount = 0);
+// The ground truth, the response of every blockSize square of the environment
+void ComputeEnvironmentResponse(Texture* environment, int gridSize, int blockSize, LightResponse& response, int threadCount = 0);
+
+struct LightBudgetEntry
+{
+	int lightCount;
+	float diffuseError; // Relative RMS error of the luminance against the ground truth (IrradianceError)
+	float glossyError;
+};
+
+// The light count chosen for an environment, and what it was chosen with
+struct LightBudget
+{
+	int lightCount = 0;
+	int relaxationIterations = 0;
+	float tolerance = LIGHT_BUDGET_TOLERANCE;
+	float diffuseError = 0.0f;
+	float glossyError = 0.0f;
+	bool withinTolerance = false; // false: even MAX_LIGHTS lights miss the tolerance
+};
+
+// Extracts 1, 2, 4 ... MAX_LIGHTS lights with the sampler (the median cut only makes powers of two)
+// and compares their response with the reference. The smallest count whose diffuse and glossy
+// errors are both within tolerance is chosen, MAX_LIGHTS if none is. entries receives every count
+// that was tried. The sampler is left with the chosen count.
+LightBudget ChooseLightBudget(IBLSampler& sampler, const LightResponse& reference, float tolerance,
+	std::vector<LightBudgetEntry>* entries = nullptr);
+
+std::string LightBudgetPath(const std::string& environmentPath);
+// Plain "key value" lines, unknown keys are skipped when loading
+bool SaveLightBudget(const std::string& path, const LightBudget& budget);
+bool LoadLightBudget(const std::string& path, LightBudget& budget);
+
+#endif
@@ -0,0 +1,78 @@
+// MappedFile.cpp
+#include "MappedFile.h"
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: data(nullptr), size(0), mapped(false)
+{
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		return false;
+	}
+	size = info.st_size;
+	if (size == 0) {
+		// mmap can not map empty files, hand out an empty buffer instead
+		::close(fd);
+		fallbackBuffer.assign(1, '\0');
+		data = fallbackBuffer.data();
+		return true;
+	}
+	void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping keeps its own reference
+	if (address != MAP_FAILED) {
+		madvise(address, size, MADV_SEQUENTIAL);
+		data = (const char*)address;
+		mapped = true;
+		return true;
+	}
+#endif
+
+	// Fallback, read the whole file into memory
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		size = 0;
+		return false;
+	}
+	size = file.tellg();
+	file.seekg(0);
+	fallbackBuffer.resize(size + 1);
+	file.read(fallbackBuffer.data(), size);
+	data = fallbackBuffer.data();
+	return true;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+	if (mapped && data != nullptr) {
+		munmap((void*)data, size);
+	}
+#endif
+	fallbackBuffer.clear();
+	fallbackBuffer.shrink_to_fit();
+	data = nullptr;
+	size = 0;
+	mapped = false;
+}
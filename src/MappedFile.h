@@ -0,0 +1,31 @@
+// MappedFile.h
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Read-only view of a whole file, memory mapped where the platform allows it
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return data != nullptr; }
+	const char* getData() const { return data; }
+	size_t getSize() const { return size; }
+
+private:
+	const char* data;
+	size_t size;
+	bool mapped;
+	std::vector<char> fallbackBuffer; // Used when mmap is not available
+};
+
+#endif
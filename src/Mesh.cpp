@@ -29,6 +29,9 @@ Mesh::Mesh(std::vector<Vector3>& vertices, std::vector<Vector3>& normals, std::v
 
 	this->setupMesh();
 }
+Mesh::~Mesh() {
+	releaseMesh();
+}
 Mesh* Mesh::Clone() {
 	Mesh *newMesh = new Mesh();
 	newMesh->vertices = new std::vector<Vector3>(*vertices);
@@ -37,166 +40,131 @@ Mesh* Mesh::Clone() {
 	newMesh->triangles = new std::vector<Triangle>(*triangles);
 	newMesh->quads = new std::vector<Quad>(*quads);
 	newMesh->quadMesh = quadMesh;
+	if (m_dirty || !vertexRange.isValid()) {
+		newMesh->m_dirty = true; // Not processed yet, gets its own arena ranges on first draw
+		return newMesh;
+	}
+
+	// Already processed (or uploaded with UploadProcessed), the clone copies the uploaded ranges and LODs
+	GeometryArena* arena = GeometryArena::GetArena(VERTEX_FORMAT_PACKED);
+	if (!arena->duplicate(vertexRange, indexRange, newMesh->vertexRange, newMesh->indexRange)) {
+		std::cerr << "Mesh: geometry arena allocation failed" << std::endl;
+		return newMesh;
+	}
+	newMesh->baseVertex = newMesh->vertexRange.offset / arena->getStride();
+	newMesh->indexCount = indexCount;
+	newMesh->indexType = indexType;
+	newMesh->lods = lods;
+	newMesh->boundsMin = boundsMin;
+	newMesh->boundsMax = boundsMax;
     return newMesh;
 }
 
 void Mesh::UpdateMesh() {
 	this->setupMesh();
 }
-void Mesh::Draw() {
+void Mesh::Draw(int lod, int instanceCount) {
 	if (m_dirty) {
 		setupMesh();
 	}
-	glBindVertexArray(VAO);
-	assert(glGetError() == GL_NO_ERROR);
+	if (lods.empty()) {
+		return;
+	}
+	const MeshLod& level = lods[glm::clamp(lod, 0, (int)lods.size() - 1)];
+	GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
 
-	glDrawElements(GL_TRIANGLES, glIndices.size(), GL_UNSIGNED_INT, 0); // 3 indices starting at 0 -> 1 triangle
+	// Every mesh lives in the same arena, so the VAO stays bound between meshes
+	GeometryArena::GetArena(VERTEX_FORMAT_PACKED)->bind();
+	assert(glGetError() == GL_NO_ERROR);
 
-	glBindVertexArray(0);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType, BUFFER_OFFSET(indexRange.offset + level.indexOffset * indexSize),
+		instanceCount, baseVertex);
 
 	assert(glGetError() == GL_NO_ERROR);
 }
 void Mesh::setupMesh() {
 	m_dirty = false;
 
-	// Upload data to directly to GPU, without any processing
-	// Create VAO, VBO, EBO
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	// Bind VAO
-	glBindVertexArray(VAO);
-	
-	// Cache sizes
-	int verticesSize = vertices->size() * sizeof(Vector3);
-	int normalsSize = normals->size() * sizeof(Vector3);
-	int texturesSize = textures->size() * sizeof(Vector2);
-	int indicesSize = triangles->size() * 3 * sizeof(int); // Always render triangles
-
-	// Bind VBO
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, verticesSize + normalsSize + texturesSize, NULL, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, verticesSize, vertices->data());
-	glBufferSubData(GL_ARRAY_BUFFER, verticesSize, normalsSize, normals->data());
-	glBufferSubData(GL_ARRAY_BUFFER, verticesSize + normalsSize, texturesSize, textures->data());
-
-	// Bind EBO
-	std::vector<int> newIndices;
-	newIndices.reserve(triangles->size() * 3);
-	for (Triangle t : *triangles) {
-		for (int i = 0; i < 3; i++) {
-			newIndices.push_back(t.vIndex[i]);
-		}
+	// Meshes uploaded with UploadProcessed have nothing to re-process
+	if (vertices->empty()) {
+		std::cerr << "Mesh: no CPU side data to process" << std::endl;
+		return;
 	}
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, newIndices.data(), GL_DYNAMIC_DRAW);
-	
-	// Set vertex attributes
-	// Position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-	glEnableVertexAttribArray(0);
-	// Normal attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)(verticesSize));
-	glEnableVertexAttribArray(1);
-	// Texture attribute
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)(verticesSize + normalsSize));
-	glEnableVertexAttribArray(2);
-
-	// Unbind VAO
-	glBindVertexArray(0);
-	glIndices = std::vector<int>(newIndices.size());
-	for (int i = 0; i < newIndices.size(); ++i)
-	{
-		glIndices[i] = newIndices[i];
+
+	// Recycle the ranges of the previous upload
+	releaseMesh();
+
+	// Weld (v, vt, vn) tuples into interleaved compact vertices and optimize for the vertex cache
+	// Quads are split into two triangles each
+	const std::vector<Triangle>* faces = triangles;
+	std::vector<Triangle> quadTriangles;
+	if (!quads->empty()) {
+		quadTriangles.reserve(triangles->size() + quads->size() * 2);
+		quadTriangles.insert(quadTriangles.end(), triangles->begin(), triangles->end());
+		for (const Quad& q : *quads) {
+			for (int split = 0; split < 2; split++) {
+				Triangle t;
+				int corners[3] = { 0, split + 1, split + 2 };
+				for (int i = 0; i < 3; i++) {
+					t.vIndex[i] = q.vIndex[corners[i]];
+					t.tIndex[i] = q.tIndex[corners[i]];
+					t.nIndex[i] = q.nIndex[corners[i]];
+				}
+				quadTriangles.push_back(t);
+			}
+		}
+		faces = &quadTriangles;
 	}
 
-	// Unbind VBO and EBO
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	ProcessedMesh processed;
+	ProcessMesh(*vertices, *normals, *textures, *faces, processed, true);
+	CalculateBounds(processed, boundsMin, boundsMax);
 
-	assert(glGetError() == GL_NO_ERROR);
-	
-	// OLD CODE
-	// Create new vertices and normals
-	// std::vector<Vector3> newVertices;
-	// std::vector<Vector3> newNormals;
-	// std::vector<Vector2> newTextures;
-	// std::vector<int> newIndices;
-
-	// newVertices.reserve(triangles->size() * 3);
-	// newNormals.reserve(triangles->size() * 3);
-	// newTextures.reserve(triangles->size() * 3);
-	// newIndices.reserve(triangles->size() * 3);
-
-	// if (quadMesh) {
-	// 	for (Quad q : *quads) {
-	// 		for (int i = 0; i < 4; i++) {
-	// 			newVertices.push_back(vertices->at(q.vIndex[i]));
-	// 			newNormals.push_back(normals->at(q.nIndex[i]));
-	// 			newIndices.push_back(newIndices.size());
-	// 		}
-	// 	}
-	// }
-	// else {
-	// 	for (Triangle t : *triangles) {
-	// 		for (int i = 0; i < 3; i++) {
-	// 			newVertices.push_back(vertices->at(t.vIndex[i]));
-	// 			newNormals.push_back(normals->at(t.nIndex[i]));
-	// 			newIndices.push_back(newIndices.size());
-	// 		}
-	// 	}
-	// }
+	// 16-bit indices when every vertex fits
+	if (processed.indexType == GL_UNSIGNED_SHORT) {
+		std::vector<GLushort> shortIndices(processed.indices.begin(), processed.indices.end());
+		UploadProcessed(processed.vertices.data(), processed.vertices.size(), shortIndices.data(), shortIndices.size(), GL_UNSIGNED_SHORT, processed.lods);
+	}
+	else {
+		UploadProcessed(processed.vertices.data(), processed.vertices.size(), processed.indices.data(), processed.indices.size(), GL_UNSIGNED_INT, processed.lods);
+	}
+}
+bool Mesh::UploadProcessed(const PackedVertex* vertices, GLsizei vertexCount, const void* indices, GLsizei indexCount, GLenum indexType,
+	const std::vector<MeshLod>& lods) {
+	m_dirty = false;
+	releaseMesh();
 
-	// // Create VAO, VBO, EBO
-	// glGenVertexArrays(1, &VAO);	
-	// glGenBuffers(1, &VBO);
-	// glGenBuffers(1, &EBO);
-
-	// // Bind VAO
-	// glBindVertexArray(VAO);
-
-	// // Cache sizes
-	// int verticesSize = newVertices.size() * sizeof(Vector3);
-	// int normalsSize = newNormals.size() * sizeof(Vector3);
-	// int texturesSize = newTextures.size() * sizeof(Vector2);
-	// int indicesSize = newIndices.size() * sizeof(int);
-
-	// // Bind VBO
-	// glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	// glBufferData(GL_ARRAY_BUFFER, verticesSize + normalsSize + texturesSize, NULL, GL_STATIC_DRAW);
-	// glBufferSubData(GL_ARRAY_BUFFER, 0, verticesSize, newVertices.data());
-	// glBufferSubData(GL_ARRAY_BUFFER, verticesSize, normalsSize, newNormals.data());
-	// glBufferSubData(GL_ARRAY_BUFFER, verticesSize + normalsSize, texturesSize, newTextures.data());
-
-	// // Bind EBO
-	// glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	// glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, newIndices.data(), GL_DYNAMIC_DRAW);
-
-	// // Set vertex attributes
-	// // Position attribute
-	// glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-	// glEnableVertexAttribArray(0);
-	// // Normal attribute
-	// glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)(verticesSize));
-	// glEnableVertexAttribArray(1);
-	// // Texture attribute
-	// glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)(verticesSize + normalsSize));
-	// glEnableVertexAttribArray(2);
-
-	// // Unbind VAO
-	// glBindVertexArray(0);
-	// glIndices = std::vector<int>(newIndices.size());
-	// for (int i = 0; i < newIndices.size(); ++i)
-	// {
-	// 	glIndices[i] = newIndices[i];
-	// }
+	this->indexCount = indexCount;
+	this->indexType = indexType;
+	this->lods = lods;
+	if (this->lods.empty()) {
+		this->lods.push_back({ 0, (GLuint)indexCount, 0.0f });
+	}
+
+	// Suballocate vertex and index ranges in the shared arena
+	GeometryArena* arena = GeometryArena::GetArena(VERTEX_FORMAT_PACKED);
+	GLsizeiptr vertexBytes = (GLsizeiptr)vertexCount * sizeof(PackedVertex);
+	GLsizeiptr indexBytes = (GLsizeiptr)indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+	if (!arena->allocate(vertexBytes, indexBytes, vertexRange, indexRange)) {
+		std::cerr << "Mesh: geometry arena allocation failed" << std::endl;
+		this->indexCount = 0;
+		this->lods.clear();
+		return false;
+	}
+	baseVertex = vertexRange.offset / arena->getStride();
 
-	// // Unbind VBO and EBO
-	// glBindBuffer(GL_ARRAY_BUFFER, 0);
-	// glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	arena->uploadVertices(vertexRange, vertices);
+	arena->uploadIndices(indexRange, indices);
 
-	// assert(glGetError() == GL_NO_ERROR);
+	assert(glGetError() == GL_NO_ERROR);
+	return true;
+}
+void Mesh::releaseMesh() {
+	if (vertexRange.isValid() || indexRange.isValid()) {
+		GeometryArena::GetArena(VERTEX_FORMAT_PACKED)->free(vertexRange, indexRange);
+	}
+	indexCount = 0;
+	lods.clear();
 }
 
 void Mesh::DebugMeshInfo() {
@@ -5,6 +5,8 @@
 #include "typedefs.h"
 #include "ShaderProgram.h"
 #include "printExtensions.h"
+#include "MeshProcessor.h"
+#include "GeometryArena.h"
 #include <vector>
 #include <string>
 #include <iostream>
@@ -20,6 +22,7 @@ struct Vertex
 };
 struct Triangle
 {
+	Triangle() { }
 	Triangle(int v[], int t[], int n[]) {
 		vIndex[0] = v[0];
 		vIndex[1] = v[1];
@@ -68,6 +71,7 @@ struct Triangle
 };
 struct Quad
 {
+	Quad() { }
 	Quad(int v[], int t[], int n[]) {
 		vIndex[0] = v[0];
 		vIndex[1] = v[1];
@@ -140,21 +144,45 @@ public:
 	Mesh();
 	Mesh(std::vector<Vector3>& vertices, std::vector<Vector3>& normals, std::vector<Vector2>& textures, std::vector<Quad>& quads);
     Mesh(std::vector<Vector3>& vertices, std::vector<Vector3>& normals, std::vector<Vector2>& textures, std::vector<Triangle>& faces);
+	~Mesh();
 
 	Mesh* Clone();
 
 	void UpdateMesh();
-    void Draw();
+    void Draw(int lod = 0, int instanceCount = 1);
+
+	// Uploads already processed vertices and indices (e.g. straight from a mapped .mesh file).
+	// Such meshes keep no CPU side copy, so they can not be re-processed, a clone copies the uploaded ranges.
+	// lods index into the uploaded indices, an empty list means a single level covering all of them.
+	bool UploadProcessed(const PackedVertex* vertices, GLsizei vertexCount, const void* indices, GLsizei indexCount, GLenum indexType,
+		const std::vector<MeshLod>& lods = std::vector<MeshLod>());
+
+	int GetLodCount() const { return lods.size(); }
+	const MeshLod& GetLod(int lod) const { return lods[lod]; }
+
+	// Object space bounding box
+	Vector3 GetBoundsMin() const { return boundsMin; }
+	Vector3 GetBoundsMax() const { return boundsMax; }
+	void SetBounds(const Vector3& min, const Vector3& max) { boundsMin = min; boundsMax = max; }
 
 	void DebugMeshInfo();
 
 private:
-	std::vector<int> glIndices;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
 	bool m_dirty = false;
 
-    unsigned int VAO, VBO, EBO;
+	// Ranges in the shared geometry arena
+	ArenaRange vertexRange;
+	ArenaRange indexRange;
+	GLint baseVertex = 0;
+	std::vector<MeshLod> lods;
+
+	Vector3 boundsMin = Vector3(0.0f);
+	Vector3 boundsMax = Vector3(0.0f);
 
     void setupMesh();
+	void releaseMesh();
 };
 
 #endif
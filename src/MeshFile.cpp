@@ -0,0 +1,195 @@
+// MeshFile.cpp
+#include "MeshFile.h"
+#include "Mesh.h"
+#include "ObjParser.h"
+#include "GeometryArena.h"
+#include <fstream>
+
+namespace
+{
+	inline uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+	}
+
+	void writePadding(std::ofstream& file, uint64_t from, uint64_t to)
+	{
+		static const char zeros[MESH_FILE_ALIGNMENT] = { };
+		file.write(zeros, to - from);
+	}
+}
+
+bool WriteMeshFile(const char* path, const ProcessedMesh& mesh)
+{
+	MeshFileHeader header = { };
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.headerSize = sizeof(MeshFileHeader);
+	header.vertexFormat = VERTEX_FORMAT_PACKED;
+	header.vertexStride = sizeof(PackedVertex);
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	header.indexType = mesh.indexType;
+	header.lodCount = mesh.lods.empty() ? 1 : mesh.lods.size();
+
+	std::vector<MeshFileLod> lods(header.lodCount);
+	for (size_t i = 0; i < mesh.lods.size(); i++) {
+		lods[i] = { mesh.lods[i].indexOffset, mesh.lods[i].indexCount, mesh.lods[i].error, 0 };
+	}
+	if (mesh.lods.empty()) {
+		lods[0] = { 0, header.indexCount, 0.0f, 0 };
+	}
+	const uint64_t lodTableEnd = sizeof(MeshFileHeader) + lods.size() * sizeof(MeshFileLod);
+
+	Vector3 boundsMin, boundsMax;
+	CalculateBounds(mesh, boundsMin, boundsMax);
+	for (int i = 0; i < 3; i++) {
+		header.boundsMin[i] = boundsMin[i];
+		header.boundsMax[i] = boundsMax[i];
+	}
+
+	header.vertexOffset = alignOffset(lodTableEnd);
+	header.vertexSize = (uint64_t)header.vertexCount * sizeof(PackedVertex);
+	header.indexOffset = alignOffset(header.vertexOffset + header.vertexSize);
+	header.indexSize = (uint64_t)header.indexCount * mesh.getIndexSize();
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open file " << path << " for writing" << std::endl;
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)lods.data(), lods.size() * sizeof(MeshFileLod));
+	writePadding(file, lodTableEnd, header.vertexOffset);
+	file.write((const char*)mesh.vertices.data(), header.vertexSize);
+	writePadding(file, header.vertexOffset + header.vertexSize, header.indexOffset);
+
+	// Indices are stored narrowed, exactly as they are uploaded
+	if (mesh.indexType == GL_UNSIGNED_SHORT) {
+		std::vector<GLushort> shortIndices(mesh.indices.begin(), mesh.indices.end());
+		file.write((const char*)shortIndices.data(), header.indexSize);
+	}
+	else {
+		file.write((const char*)mesh.indices.data(), header.indexSize);
+	}
+
+	if (!file.good()) {
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OpenMeshFile(const char* path, MappedFile& file, MeshFileView& view)
+{
+	if (!file.open(path)) {
+		std::cerr << "Unable to open file " << path << std::endl;
+		return false;
+	}
+
+	const size_t fileSize = file.getSize();
+	if (fileSize < sizeof(MeshFileHeader)) {
+		std::cerr << "Invalid mesh file " << path << ": truncated header" << std::endl;
+		return false;
+	}
+
+	const MeshFileHeader* header = (const MeshFileHeader*)file.getData();
+	if (header->magic != MESH_FILE_MAGIC) {
+		std::cerr << "Invalid mesh file " << path << ": bad magic" << std::endl;
+		return false;
+	}
+	if (header->version != MESH_FILE_VERSION || header->headerSize != sizeof(MeshFileHeader)) {
+		std::cerr << "Mesh file " << path << " has version " << header->version << ", expected " << MESH_FILE_VERSION << std::endl;
+		return false;
+	}
+	if (header->vertexFormat != VERTEX_FORMAT_PACKED || header->vertexStride != sizeof(PackedVertex)) {
+		std::cerr << "Mesh file " << path << " has an unsupported vertex format" << std::endl;
+		return false;
+	}
+
+	GLsizei indexSize;
+	if (header->indexType == GL_UNSIGNED_SHORT) {
+		indexSize = sizeof(GLushort);
+	}
+	else if (header->indexType == GL_UNSIGNED_INT) {
+		indexSize = sizeof(GLuint);
+	}
+	else {
+		std::cerr << "Mesh file " << path << " has an unsupported index type" << std::endl;
+		return false;
+	}
+
+	if (header->lodCount == 0 || header->lodCount > MAX_MESH_LODS
+		|| fileSize < sizeof(MeshFileHeader) + (uint64_t)header->lodCount * sizeof(MeshFileLod)) {
+		std::cerr << "Invalid mesh file " << path << ": bad LOD table" << std::endl;
+		return false;
+	}
+	const MeshFileLod* lods = (const MeshFileLod*)(file.getData() + sizeof(MeshFileHeader));
+	for (uint32 i = 0; i < header->lodCount; i++) {
+		if (lods[i].indexCount == 0 || lods[i].indexCount % 3 != 0 || lods[i].indexOffset > header->indexCount
+			|| lods[i].indexCount > header->indexCount - lods[i].indexOffset) {
+			std::cerr << "Invalid mesh file " << path << ": LOD " << i << " is out of range" << std::endl;
+			return false;
+		}
+	}
+
+	// Blobs must match the counts, be aligned and lie inside the file
+	const uint64_t lodTableEnd = sizeof(MeshFileHeader) + (uint64_t)header->lodCount * sizeof(MeshFileLod);
+	bool sizesValid = header->vertexSize == (uint64_t)header->vertexCount * header->vertexStride
+		&& header->indexSize == (uint64_t)header->indexCount * indexSize
+		&& header->indexCount % 3 == 0;
+	bool offsetsValid = header->vertexOffset % MESH_FILE_ALIGNMENT == 0 && header->indexOffset % MESH_FILE_ALIGNMENT == 0
+		&& header->vertexOffset >= lodTableEnd && header->indexOffset >= lodTableEnd
+		&& header->vertexOffset <= fileSize && header->vertexSize <= fileSize - header->vertexOffset
+		&& header->indexOffset <= fileSize && header->indexSize <= fileSize - header->indexOffset;
+	if (!sizesValid || !offsetsValid) {
+		std::cerr << "Invalid mesh file " << path << ": corrupt or truncated data" << std::endl;
+		return false;
+	}
+
+	view.header = header;
+	view.lods = lods;
+	view.vertices = (const PackedVertex*)(file.getData() + header->vertexOffset);
+	view.indices = file.getData() + header->indexOffset;
+	return true;
+}
+
+Mesh* LoadMeshFile(const char* path)
+{
+	MappedFile file;
+	MeshFileView view;
+	if (!OpenMeshFile(path, file, view)) {
+		return nullptr;
+	}
+
+	const MeshFileHeader* header = view.header;
+	std::vector<MeshLod> lods(header->lodCount);
+	for (uint32 i = 0; i < header->lodCount; i++) {
+		lods[i] = { view.lods[i].indexOffset, view.lods[i].indexCount, view.lods[i].error };
+	}
+
+	Mesh* mesh = new Mesh();
+	if (!mesh->UploadProcessed(view.vertices, header->vertexCount, view.indices, header->indexCount, header->indexType, lods)) {
+		delete mesh;
+		return nullptr;
+	}
+	mesh->SetBounds(Vector3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]),
+		Vector3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]));
+	return mesh;
+}
+
+bool ConvertObjToMeshFile(const char* objPath, const char* meshPath)
+{
+	ObjData data;
+	if (!LoadObjData(objPath, data, true, true)) {
+		return false;
+	}
+	if (data.vertices.empty() || data.triangles.empty()) {
+		std::cerr << "Invalid or empty OBJ file " << objPath << std::endl;
+		return false;
+	}
+
+	ProcessedMesh processed;
+	ProcessMesh(data.vertices, data.normals, data.textures, data.triangles, processed);
+	return WriteMeshFile(meshPath, processed);
+}
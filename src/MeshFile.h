@@ -0,0 +1,70 @@
+// MeshFile.h
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include "typedefs.h"
+#include "MeshProcessor.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <GL/glew.h>
+
+class Mesh;
+
+// Binary mesh container (.mesh): a header and the LOD table followed by the vertex and index blobs in the
+// exact layout they are uploaded with, so loading is a map, a validation and two copies.
+// Everything is little endian.
+const uint32 MESH_FILE_MAGIC = 0x4853454D; // "MESH"
+const uint32 MESH_FILE_VERSION = 2; // 2: LOD table
+const uint32 MESH_FILE_ALIGNMENT = 16; // Blob offsets are multiples of this
+
+struct MeshFileHeader
+{
+	uint32 magic;
+	uint32 version;
+	uint32 headerSize;
+	uint32 vertexFormat; // VertexFormat
+	uint32 vertexStride;
+	uint32 vertexCount;
+	uint32 indexCount;
+	uint32 indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32 lodCount; // MeshFileLod entries right after the header
+	uint32 padding;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t vertexOffset;
+	uint64_t vertexSize;
+	uint64_t indexOffset;
+	uint64_t indexSize;
+};
+static_assert(sizeof(MeshFileHeader) == 96, "MeshFileHeader layout changed, bump MESH_FILE_VERSION");
+
+struct MeshFileLod
+{
+	uint32 indexOffset; // In indices
+	uint32 indexCount;
+	float error;
+	uint32 padding;
+};
+static_assert(sizeof(MeshFileLod) == 16, "MeshFileLod layout changed, bump MESH_FILE_VERSION");
+
+// Validated view into a mapped .mesh file, the pointers are valid while the MappedFile is open
+struct MeshFileView
+{
+	const MeshFileHeader* header = nullptr;
+	const MeshFileLod* lods = nullptr;
+	const PackedVertex* vertices = nullptr;
+	const void* indices = nullptr;
+};
+
+bool WriteMeshFile(const char* path, const ProcessedMesh& mesh);
+
+// Maps the file and checks the header against the file size and the current vertex layout
+bool OpenMeshFile(const char* path, MappedFile& file, MeshFileView& view);
+
+// Uploads a .mesh file straight from the mapping into the geometry arena
+Mesh* LoadMeshFile(const char* path);
+
+// Parses and processes an OBJ file the same way ParseObjFile does and writes the result
+bool ConvertObjToMeshFile(const char* objPath, const char* meshPath);
+
+#endif
@@ -0,0 +1,335 @@
+// MeshProcessor.cpp
+#include "MeshProcessor.h"
+#include "Mesh.h"
+#include "MeshSimplifier.h"
+#include "glm/gtc/packing.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+GLuint PackNormal(const Vector3& normal)
+{
+	float len = glm::length(normal);
+	Vector3 n = len > 0.0f ? normal / len : Vector3(0.0f);
+	return glm::packSnorm3x10_1x2(Vector4(n, 0.0f));
+}
+
+Vector3 UnpackNormal(GLuint packed)
+{
+	return Vector3(glm::unpackSnorm3x10_1x2(packed));
+}
+
+struct WeldKey
+{
+	GLuint v, t, n;
+	bool operator==(const WeldKey& other) const
+	{
+		return v == other.v && t == other.t && n == other.n;
+	}
+};
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& key) const
+	{
+		size_t h = key.v * 73856093u;
+		h ^= key.t * 19349663u + (h << 6) + (h >> 2);
+		h ^= key.n * 83492791u + (h << 6) + (h >> 2);
+		return h;
+	}
+};
+
+void WeldMesh(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<Vector2>& textures,
+	const std::vector<Triangle>& triangles, ProcessedMesh& out)
+{
+	const GLuint missing = ~0u;
+
+	out.vertices.clear();
+	out.indices.clear();
+	out.vertices.reserve(positions.size());
+	out.indices.reserve(triangles.size() * 3);
+
+	std::unordered_map<WeldKey, GLuint, WeldKeyHash> unique;
+	unique.reserve(positions.size() * 2);
+
+	for (const Triangle& t : triangles) {
+		for (int i = 0; i < 3; i++) {
+			GLuint v = t.vIndex[i];
+			if (v >= positions.size()) {
+				std::cerr << "Mesh: vertex index " << v << " out of range" << std::endl;
+				v = 0;
+			}
+			// Out of range attributes are missing, so they must not split vertices
+			WeldKey key = { v, t.tIndex[i] < textures.size() ? t.tIndex[i] : missing, t.nIndex[i] < normals.size() ? t.nIndex[i] : missing };
+
+			auto it = unique.find(key);
+			if (it != unique.end()) {
+				out.indices.push_back(it->second);
+				continue;
+			}
+
+			PackedVertex vertex;
+			vertex.position[0] = positions[v].x;
+			vertex.position[1] = positions[v].y;
+			vertex.position[2] = positions[v].z;
+			vertex.normal = PackNormal(key.n != missing ? normals[key.n] : Vector3(0.0f));
+			Vector2 uv = key.t != missing ? textures[key.t] : Vector2(0.0f);
+			vertex.texCoord[0] = glm::packHalf1x16(uv.x);
+			vertex.texCoord[1] = glm::packHalf1x16(uv.y);
+
+			GLuint index = out.vertices.size();
+			out.vertices.push_back(vertex);
+			unique.emplace(key, index);
+			out.indices.push_back(index);
+		}
+	}
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006)
+namespace
+{
+	const int FORSYTH_CACHE_SIZE = 32;
+	const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+	const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+	const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+	const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+	float forsythVertexScore(int cachePosition, int remainingTriangles)
+	{
+		if (remainingTriangles == 0) {
+			return -1.0f; // No triangle needs this vertex anymore
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				// The vertices of the last triangle get a fixed score, to avoid favouring one of them
+				score = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else {
+				const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				score = 1.0f - (cachePosition - 3) * scaler;
+				score = powf(score, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+
+		// Boost vertices with few remaining triangles, so lone triangles are not left behind
+		score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+		return score;
+	}
+}
+
+void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Build vertex -> triangle adjacency
+	std::vector<int> remaining(vertexCount, 0);
+	for (GLuint index : indices) {
+		remaining[index]++;
+	}
+	std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	}
+	std::vector<GLuint> adjacency(indices.size());
+	std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int i = 0; i < 3; i++) {
+			adjacency[fill[indices[t * 3 + i]]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<GLuint> output;
+	output.reserve(indices.size());
+
+	// LRU cache, with room for the three vertices being pushed in front of it
+	std::vector<GLuint> cache;
+	std::vector<GLuint> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	size_t scanPosition = 0; // Fallback linear scan when the cache has no candidates
+	long bestTriangle = -1;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		if (bestTriangle < 0) {
+			// Pick the best scoring triangle overall, this only happens when the cache runs dry
+			float bestScore = -1.0f;
+			for (size_t t = scanPosition; t < triangleCount; t++) {
+				if (!emitted[t] && triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+			while (scanPosition < triangleCount && emitted[scanPosition]) {
+				scanPosition++;
+			}
+		}
+
+		// Emit the triangle
+		emitted[bestTriangle] = true;
+		GLuint tri[3] = { indices[bestTriangle * 3], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2] };
+		output.insert(output.end(), tri, tri + 3);
+
+		// Remove the triangle from its vertices' adjacency lists
+		for (GLuint v : tri) {
+			GLuint* begin = &adjacency[adjacencyOffset[v]];
+			GLuint* end = begin + remaining[v];
+			GLuint* found = std::find(begin, end, (GLuint)bestTriangle);
+			*found = *(end - 1);
+			remaining[v]--;
+		}
+
+		// Push the triangle's vertices to the front of the cache
+		newCache.assign(tri, tri + 3);
+		for (GLuint v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				newCache.push_back(v);
+			}
+		}
+
+		// Vertices pushed out of the cache lose their cache score
+		for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+			GLuint v = newCache[i];
+			cachePosition[v] = -1;
+			float newScore = forsythVertexScore(-1, remaining[v]);
+			for (int j = 0; j < remaining[v]; j++) {
+				triangleScore[adjacency[adjacencyOffset[v] + j]] += newScore - vertexScore[v];
+			}
+			vertexScore[v] = newScore;
+		}
+		if (newCache.size() > FORSYTH_CACHE_SIZE) {
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		}
+		std::swap(cache, newCache);
+
+		// Update the scores of cached vertices and their triangles
+		for (size_t i = 0; i < cache.size(); i++) {
+			GLuint v = cache[i];
+			cachePosition[v] = i;
+			float newScore = forsythVertexScore(i, remaining[v]);
+			for (int j = 0; j < remaining[v]; j++) {
+				triangleScore[adjacency[adjacencyOffset[v] + j]] += newScore - vertexScore[v];
+			}
+			vertexScore[v] = newScore;
+		}
+
+		// The next triangle is the best scoring one that touches the cache
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (GLuint v : cache) {
+			for (int j = 0; j < remaining[v]; j++) {
+				GLuint t = adjacency[adjacencyOffset[v] + j];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+void OptimizeVertexFetch(ProcessedMesh& mesh)
+{
+	const GLuint unused = ~0u;
+	std::vector<GLuint> remap(mesh.vertices.size(), unused);
+	std::vector<PackedVertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	for (GLuint& index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = vertices.size();
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	// Vertices that no triangle references are dropped
+	mesh.vertices.swap(vertices);
+}
+
+float CalculateACMR(const std::vector<GLuint>& indices, size_t vertexCount, int cacheSize)
+{
+	if (indices.size() < 3) {
+		return 0.0f;
+	}
+
+	// FIFO cache simulation, timestamps tell if a vertex is still in the cache
+	std::vector<size_t> cacheTimestamp(vertexCount, 0);
+	size_t timestamp = cacheSize + 1;
+	size_t misses = 0;
+	for (GLuint index : indices) {
+		if (timestamp - cacheTimestamp[index] > (size_t)cacheSize) {
+			cacheTimestamp[index] = timestamp++;
+			misses++;
+		}
+	}
+	return (float)misses / (indices.size() / 3);
+}
+
+void CalculateBounds(const ProcessedMesh& mesh, Vector3& boundsMin, Vector3& boundsMax)
+{
+	if (mesh.vertices.empty()) {
+		boundsMin = boundsMax = Vector3(0.0f);
+		return;
+	}
+	boundsMin = Vector3(std::numeric_limits<float>::max());
+	boundsMax = Vector3(-std::numeric_limits<float>::max());
+	for (const PackedVertex& v : mesh.vertices) {
+		Vector3 position(v.position[0], v.position[1], v.position[2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+}
+
+void ProcessMesh(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<Vector2>& textures,
+	const std::vector<Triangle>& triangles, ProcessedMesh& out, bool verbose)
+{
+	WeldMesh(positions, normals, textures, triangles, out);
+	float acmrBefore = CalculateACMR(out.indices, out.vertices.size());
+
+	// Exporters often write strip-like orders already, keep them if the optimizer can not beat them
+	std::vector<GLuint> optimized = out.indices;
+	OptimizeVertexCache(optimized, out.vertices.size());
+	float acmrAfter = CalculateACMR(optimized, out.vertices.size());
+	if (acmrAfter < acmrBefore) {
+		out.indices.swap(optimized);
+	}
+	else {
+		acmrAfter = acmrBefore;
+	}
+	OptimizeVertexFetch(out);
+	BuildLodChain(out);
+
+	out.indexType = out.vertices.size() <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	if (verbose) {
+		std::cout << "Mesh processed: " << positions.size() << " positions -> " << out.vertices.size() << " vertices, "
+			<< out.lods[0].indexCount / 3 << " triangles, "
+			<< (out.indexType == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices, "
+			<< "ACMR " << std::setprecision(3) << acmrBefore << " -> " << acmrAfter << ", LODs";
+		for (const MeshLod& lod : out.lods) {
+			std::cout << " " << lod.indexCount / 3 << " (error " << lod.error << ")";
+		}
+		std::cout << std::endl;
+	}
+}
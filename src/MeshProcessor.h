@@ -0,0 +1,68 @@
+// MeshProcessor.h
+#ifndef MESH_PROCESSOR_H
+#define MESH_PROCESSOR_H
+
+#include "typedefs.h"
+#include <vector>
+#include <GL/glew.h>
+
+struct Triangle;
+
+// Compact interleaved vertex, this is the layout every mesh is uploaded with.
+// position: 3 x float, normal: GL_INT_2_10_10_10_REV (snorm), texCoord: 2 x half float
+struct PackedVertex
+{
+	GLfloat position[3];
+	GLuint normal;
+	GLushort texCoord[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must be tightly packed");
+
+// Level of detail: a range of the index buffer, every level shares the vertex buffer
+const int MAX_MESH_LODS = 4;
+struct MeshLod
+{
+	GLuint indexOffset; // In indices, not bytes
+	GLuint indexCount;
+	float error; // Simplification error in object space
+};
+
+// GPU-ready mesh data produced by the processing stage
+struct ProcessedMesh
+{
+	std::vector<PackedVertex> vertices;
+	std::vector<GLuint> indices; // Always 32-bit here, narrowed on upload. Holds every LOD back to back
+	std::vector<MeshLod> lods; // lods[0] is the full resolution mesh
+	GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT if every index fits in 16 bits
+
+	GLsizei getIndexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+};
+
+// Post-transform cache size used when reporting ACMR (FIFO, like most hardware)
+const int ACMR_CACHE_SIZE = 16;
+
+GLuint PackNormal(const Vector3& normal);
+Vector3 UnpackNormal(GLuint packed);
+
+// Welds unique (v, vt, vn) tuples into single vertices. Indices that are out of range
+// (e.g. no texture coordinates in the file) are treated as missing attributes.
+void WeldMesh(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<Vector2>& textures,
+	const std::vector<Triangle>& triangles, ProcessedMesh& out);
+
+// Reorders triangles for post-transform vertex cache locality (Forsyth's linear-speed algorithm)
+void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+// Reorders vertices in first-use order so vertex fetch follows the index stream
+void OptimizeVertexFetch(ProcessedMesh& mesh);
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO cache of the given size
+float CalculateACMR(const std::vector<GLuint>& indices, size_t vertexCount, int cacheSize = ACMR_CACHE_SIZE);
+
+// Axis aligned bounds of the vertex positions
+void CalculateBounds(const ProcessedMesh& mesh, Vector3& boundsMin, Vector3& boundsMax);
+
+// Runs the whole pipeline: weld, cache optimization, fetch optimization, LOD generation and index narrowing
+void ProcessMesh(const std::vector<Vector3>& positions, const std::vector<Vector3>& normals, const std::vector<Vector2>& textures,
+	const std::vector<Triangle>& triangles, ProcessedMesh& out, bool verbose = false);
+
+#endif
@@ -1,8 +1,23 @@
 #include "MeshRenderer.h"
+#include "ResourceRegistry.h"
+#include <cstring>
 
 MeshRenderer::MeshRenderer() {}
 
-MeshRenderer::~MeshRenderer() {}
+MeshRenderer::~MeshRenderer() {
+	delete irradianceMap;
+	ResourceRegistry::Get()->Release(RESOURCE_CPU, (uintptr_t)&irradianceTexels);
+	if (instanceBuffer != 0) {
+		ResourceRegistry::Get()->Release(RESOURCE_BUFFER, instanceBuffer);
+		ResourceRegistry::Get()->Release(RESOURCE_BUFFER, instanceMaterialBuffer);
+		glDeleteBuffers(1, &instanceBuffer);
+		glDeleteBuffers(1, &instanceMaterialBuffer);
+	}
+	if (materialsUBO != 0) {
+		ResourceRegistry::Get()->Release(RESOURCE_BUFFER, materialsUBO);
+		glDeleteBuffers(1, &materialsUBO);
+	}
+}
 
 void MeshRenderer::SetCubemap(Texture* cubemapTexture) {
 	this->cubemapTexture = cubemapTexture;
@@ -24,17 +39,135 @@ void MeshRenderer::SetExposure(float exposure) {
 	this->exposure = exposure;
 }
 
-void MeshRenderer::SetSpecularEnabled(bool enabled) {
-	this->specularEnabled = enabled;
-}
-
-void MeshRenderer::SetLights(std::vector<Light*>* lights) {
+void MeshRenderer::SetLights(const LightBlock* lights) {
 	this->lights = lights;
 	setupLightsUBO();
+	bakeIrradianceMap();
+}
+
+void MeshRenderer::SetEnvironmentRotation(const Quaternion& rotation) {
+	if (rotation == environmentRotation) {
+		return;
+	}
+	environmentRotation = rotation;
+	UpdateLightsUBO();
+}
+
+void MeshRenderer::bakeIrradianceMap() {
+	PROFILE_CPU_SCOPE("BakeIrradiance");
+
+	BakeIrradianceCubemap(*lights, IRRADIANCE_MAP_SIZE, irradianceTexels);
+	ambientLight = Vector3(0.0f);
+	for (int i = 0; i < lights->numLights; i++) {
+		ambientLight += lights->lights[i].color;
+	}
+
+	if (irradianceMap == nullptr) {
+		irradianceMap = Texture::CreateCubemap(IRRADIANCE_MAP_SIZE, IRRADIANCE_MAP_SIZE);
+		irradianceMap->setName("irradiance map");
+		ResourceRegistry::Get()->Track(RESOURCE_CPU, (uintptr_t)&irradianceTexels, "irradiance texels", irradianceTexels.size() * sizeof(float));
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap->getID());
+	size_t faceSize = (size_t)IRRADIANCE_MAP_SIZE * IRRADIANCE_MAP_SIZE * 3;
+	for (int face = 0; face < 6; face++) {
+		glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, IRRADIANCE_MAP_SIZE, IRRADIANCE_MAP_SIZE,
+			GL_RGB, GL_FLOAT, irradianceTexels.data() + face * faceSize);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	assert(glGetError() == GL_NO_ERROR);
 }
 
-void MeshRenderer::Draw(GameObject* gameObject) {
-	ShaderProgram* shader = gameObject->shader;
+void MeshRenderer::SetLodBias(float bias) {
+	this->lodBias = bias;
+}
+
+float MeshRenderer::GetScreenSize(GameObject* gameObject) {
+	// Bounding sphere of the mesh bounds in world space
+	Mesh* mesh = gameObject->mesh;
+	const Matrix4& model = gameObject->GetInstance().model;
+	// Longest axis of the world matrix, parents included
+	float scale = glm::max(glm::length(Vector3(model[0])), glm::max(glm::length(Vector3(model[1])), glm::length(Vector3(model[2]))));
+	Vector3 center = Vector3(model * Vector4((mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f, 1.0f));
+	float radius = glm::length(mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f * scale;
+
+	// Projected diameter as a fraction of the screen height
+	if (camera->getType() == ORTHOGRAPHIC) {
+		return radius / camera->getOrthoSize();
+	}
+	float distance = glm::length(center - camera->getPosition());
+	if (distance <= radius) {
+		return std::numeric_limits<float>::max();
+	}
+	return radius / (distance * tan(glm::radians(camera->getFieldOfView()) * 0.5));
+}
+
+int MeshRenderer::SelectLod(GameObject* gameObject) {
+	int lodCount = gameObject->mesh->GetLodCount();
+	int lod = glm::clamp(gameObject->lodLevel, 0, glm::max(lodCount - 1, 0));
+	float size = GetScreenSize(gameObject) * lodBias;
+
+	// Switch size of level i, below it level i is drawn
+	auto switchSize = [](int level) { return LOD_SCREEN_SIZE / (float)(1 << (level - 1)); };
+	while (lod > 0 && size > switchSize(lod) * (1.0f + LOD_HYSTERESIS)) {
+		lod--;
+	}
+	while (lod < lodCount - 1 && size < switchSize(lod + 1) * (1.0f - LOD_HYSTERESIS)) {
+		lod++;
+	}
+	gameObject->lodLevel = lod;
+	return lod;
+}
+
+void MeshRenderer::UploadInstances(const std::vector<InstanceTransform>& instances, const std::vector<GLint>& materialIndices) {
+	PROFILE_GPU_SCOPE("UploadInstances");
+	assert(materialIndices.size() == instances.size());
+
+	if (instanceBuffer == 0) {
+		glGenBuffers(1, &instanceBuffer);
+		glGenBuffers(1, &instanceMaterialBuffer);
+	}
+	// A new store every frame, so the driver never waits on draws still reading the last one
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceTransform), instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceMaterialBuffer);
+	glBufferData(GL_ARRAY_BUFFER, materialIndices.size() * sizeof(GLint), materialIndices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	ResourceRegistry::Get()->Track(RESOURCE_BUFFER, instanceBuffer, "instance transforms", instances.size() * sizeof(InstanceTransform));
+	ResourceRegistry::Get()->Track(RESOURCE_BUFFER, instanceMaterialBuffer, "instance materials", materialIndices.size() * sizeof(GLint));
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+// GL 3.3 has no base instance, so the attributes point at the first instance instead
+void MeshRenderer::bindInstances(int firstInstance) {
+	GeometryArena::GetArena(VERTEX_FORMAT_PACKED)->bind();
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	GLsizei stride = sizeof(InstanceTransform);
+	size_t base = (size_t)firstInstance * sizeof(InstanceTransform);
+	for (GLuint column = 0; column < 4; column++) {
+		GLuint location = INSTANCE_MODEL_LOCATION + column;
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(InstanceTransform, model) + column * sizeof(Vector4)));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+	for (GLuint column = 0; column < 3; column++) {
+		GLuint location = INSTANCE_NORMAL_LOCATION + column;
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(InstanceTransform, normal) + column * sizeof(Vector4)));
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceMaterialBuffer);
+	glVertexAttribIPointer(INSTANCE_MATERIAL_LOCATION, 1, GL_INT, sizeof(GLint), (void *)((size_t)firstInstance * sizeof(GLint)));
+	glVertexAttribDivisor(INSTANCE_MATERIAL_LOCATION, 1);
+	glEnableVertexAttribArray(INSTANCE_MATERIAL_LOCATION);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshRenderer::Draw(GameObject* gameObject, int lod, int firstInstance, int instanceCount, ShaderProgram* shader) {
+	PROFILE_GPU_SCOPE("DrawObject");
+
+	if (shader == nullptr) {
+		shader = gameObject->shader;
+	}
 	if (shader == nullptr)
 	{
 		std::cerr << "No shader attached to the game object " << gameObject->name << std::endl;
@@ -49,9 +182,28 @@ void MeshRenderer::Draw(GameObject* gameObject) {
     // Set the sampler
     glBindSampler(cubemapTexture->getTextureUnit(), sampler);
 
+	// Bind the irradiance map
+	glActiveTexture(GL_TEXTURE0 + IRRADIANCE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap->getID());
+	shader->setSamplerCube("irradianceMap", IRRADIANCE_TEXTURE_UNIT);
+	shader->setVec3("ambientLight", ambientLight);
+	glActiveTexture(GL_TEXTURE0 + cubemapTexture->getTextureUnit());
+
 	// Set the exposure
 	shader->setFloat("exposure", this->exposure);
-	shader->setBool("specularEnabled", this->specularEnabled);
+
+	// World directions to the unrotated environment (cubemap and irradiance map)
+	Matrix3 worldToEnvironment = glm::mat3_cast(glm::inverse(environmentRotation));
+	shader->setMat3("worldToEnvironment", worldToEnvironment);
+
+	// Reflections, a probe's cubemap is rendered in world space and is looked up as it is
+	Texture* reflectionMap = gameObject->reflectionMap != nullptr ? gameObject->reflectionMap : cubemapTexture;
+	glActiveTexture(GL_TEXTURE0 + REFLECTION_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, reflectionMap->getID());
+	glBindSampler(REFLECTION_TEXTURE_UNIT, sampler);
+	shader->setSamplerCube("reflectionMap", REFLECTION_TEXTURE_UNIT);
+	shader->setMat3("worldToReflection", reflectionMap == cubemapTexture ? worldToEnvironment : Matrix3(1.0f));
+	glActiveTexture(GL_TEXTURE0 + cubemapTexture->getTextureUnit());
 	
 	// Bind the camera UBO
 	GLuint cameraUBOIndex = glGetUniformBlockIndex(shader->getID(), "CameraMatrices");
@@ -62,14 +214,25 @@ void MeshRenderer::Draw(GameObject* gameObject) {
 	GLuint lightsUBOIndex = glGetUniformBlockIndex(shader->getID(), "Lights");
 	glUniformBlockBinding(shader->getID(), lightsUBOIndex, 0);
 	assert(glGetError() == GL_NO_ERROR);
-	
-	// Set the model matrix
-	shader->setMat4("model", gameObject->getModelingMatrix());
 
-	gameObject->mesh->Draw();
+	// Bind the materials UBO, shaders that ignore the material have no such block
+	GLuint materialsUBOIndex = glGetUniformBlockIndex(shader->getID(), "Materials");
+	if (materialsUBOIndex != GL_INVALID_INDEX) {
+		glUniformBlockBinding(shader->getID(), materialsUBOIndex, 2);
+	}
+	
+	bindInstances(firstInstance);
+	gameObject->mesh->Draw(lod, instanceCount);
 
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
     glBindSampler(cubemapTexture->getTextureUnit(), 0);
+	glActiveTexture(GL_TEXTURE0 + IRRADIANCE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	// A probe's cubemap must not stay bound while its own faces are drawn
+	glActiveTexture(GL_TEXTURE0 + REFLECTION_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glBindSampler(REFLECTION_TEXTURE_UNIT, 0);
+	glActiveTexture(GL_TEXTURE0 + cubemapTexture->getTextureUnit());
 
 	shader->unuse();
 }
@@ -83,11 +246,16 @@ void MeshRenderer::setupCameraUBO() {
 			vec3 eyePos;
 		};
 	*/
-	glGenBuffers(1, &cameraUBO);
+	if (cameraUBO == 0) {
+		glGenBuffers(1, &cameraUBO);
+		ResourceRegistry::Get()->Track(RESOURCE_BUFFER, cameraUBO, "camera UBO", sizeof(__camera));
+	}
 	UpdateCameraUBO(); 
 }
 
 void MeshRenderer::UpdateCameraUBO() {
+	PROFILE_GPU_SCOPE("UploadCamera");
+
 	cameraData.view = *camera->getViewMatrix();
 	cameraData.projection = *camera->getProjectionMatrix();
 	cameraData.eyePos = camera->getPosition();
@@ -102,39 +270,68 @@ void MeshRenderer::UpdateCameraUBO() {
 
 void MeshRenderer::setupLightsUBO()
 {
-	/*
-		layout (std140, binding = 0) uniform Lights
-		{
-			Light lightSources[MAX_LIGHTS];
-			int numLights;
-		};
-	*/
-	glGenBuffers(1, &lightsUBO);
+	if (lightsUBO == 0) { // SetLights runs every frame of an environment sequence
+		glGenBuffers(1, &lightsUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		ResourceRegistry::Get()->Track(RESOURCE_BUFFER, lightsUBO, "lights UBO", sizeof(LightBlock));
+	}
 	UpdateLightsUBO();
 }
 
 void MeshRenderer::UpdateLightsUBO() {
+	PROFILE_GPU_SCOPE("UploadLights");
+
+	// The lights are stored in the block layout, only the used ones are copied. The shaders
+	// never read past numLights, so the rest of the buffer is invalidated.
+	size_t size = lights->usedSize();
+	glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO); // Bind buffer
+	LightBlock* block = (LightBlock*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	assert(block != nullptr);
+	memcpy(block, lights, size);
+	// The sampler's lights stay in environment space, a turned environment turns their directions
+	if (environmentRotation != Quaternion(1.0f, 0.0f, 0.0f, 0.0f)) {
+		Matrix3 rotation = glm::mat3_cast(environmentRotation);
+		for (int i = 0; i < lights->numLights; i++) {
+			block->lights[i].position = rotation * lights->lights[i].position;
+		}
+	}
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, lightsUBO); // Bind buffer to binding point 0
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0); // Unbind buffer
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+void MeshRenderer::UpdateMaterialsUBO(const std::vector<Material*>& materials) {
+	PROFILE_GPU_SCOPE("UploadMaterials");
+	assert(materials.size() <= MAX_MATERIALS);
+
 	/*
-		layout (std140, binding = 0) uniform Lights
+		layout (std140) uniform Materials
 		{
-			Light lightSources[MAX_LIGHTS];
-			int numLights;
+			Material materials[MAX_MATERIALS];
 		};
 	*/
-	lightsData = __lights(); 
-	lightsData.numLights = lights->size();
-	for (int i = 0; i < lights->size(); i++) {
-		Light* light = lights->at(i);
-		lightsData.lightSources[i].position = light->position;
-		lightsData.lightSources[i].color = light->color;
-		lightsData.lightSources[i].intensity = light->intensity;
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material* material = materials[i] != nullptr ? materials[i] : &defaultMaterial;
+		materialsData.materials[i].ambient = material->ambient;
+		materialsData.materials[i].shininess = material->shininess;
+		materialsData.materials[i].diffuse = material->diffuse;
+		materialsData.materials[i].specular = material->specular;
 	}
 
-	int size = sizeof(__lights);
-	glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO); // Bind buffer
-	glBufferData(GL_UNIFORM_BUFFER, size, &lightsData, GL_STATIC_DRAW); // Set buffer data
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, lightsUBO); // Bind buffer to binding point 0
+	if (materialsUBO == 0) {
+		glGenBuffers(1, &materialsUBO);
+		ResourceRegistry::Get()->Track(RESOURCE_BUFFER, materialsUBO, "materials UBO", sizeof(__materials));
+	}
+	// A fresh store of the full block size, only the materials in use are written
+	glBindBuffer(GL_UNIFORM_BUFFER, materialsUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(__materials), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(__material), materialsData.materials);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 2, materialsUBO);
 
-	glBindBuffer(GL_UNIFORM_BUFFER, 0); // Unbind buffer
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	assert(glGetError() == GL_NO_ERROR);
 }
\ No newline at end of file
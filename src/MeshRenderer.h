@@ -10,25 +10,32 @@
 #include "utils.h"
 #include "Texture.h"
 #include "printExtensions.h"
+#include "Profiler.h"
+#include "IrradianceMap.h"
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <limits>
 
-// Lights: binding = 0
+// Lights: binding = 0 (LightBlock, Light.h)
 // Camera: binding = 1
-const int MAX_LIGHTS = 256;
-struct __light {
-	Vector3 position;
-	int padding;
-	Vector3 color;
-	float intensity;
-};
-struct __lights {
-	int numLights;
-	int padding[3];
-    __light lightSources[MAX_LIGHTS]; // Assuming MAX_LIGHTS is defined
-};
+// Materials: binding = 2
+// Distinct materials per frame, 48 bytes each, well inside the 16 KB every GL 3.3 UBO can hold
+const int MAX_MATERIALS = 256;
+// LOD selection: level i is used below LOD_SCREEN_SIZE / 2^(i-1) of the screen height,
+// and a level only changes once the size is LOD_HYSTERESIS past the switch point. The size
+// is the one of the bounding box, the demo sphere at the default camera is 0.6 (level 1).
+const float LOD_SCREEN_SIZE = 0.75f;
+const float LOD_HYSTERESIS = 0.1f;
+// The environment cubemap uses the unit of its texture (0)
+const int IRRADIANCE_TEXTURE_UNIT = 1;
+const int REFLECTION_TEXTURE_UNIT = 2; // The object's reflection probe, or the environment again
+// Per instance attributes of lit.vert, the model matrix takes 4 locations and the normal matrix 3
+const GLuint INSTANCE_MODEL_LOCATION = 3;
+const GLuint INSTANCE_NORMAL_LOCATION = 7;
+const GLuint INSTANCE_MATERIAL_LOCATION = 10; // Index into the Materials block
+
 struct __camera {
 	Matrix4 view;
 	Matrix4 projection;
@@ -42,6 +49,9 @@ struct __material{
 	Vector3 specular;
 	float padding2;
 };
+struct __materials {
+	__material materials[MAX_MATERIALS];
+};
 
 class MeshRenderer {
 public:
@@ -50,33 +60,63 @@ public:
 
 	void SetCubemap(Texture* cubemapTexture);
 	void SetExposure(float exposure);
-	void SetSpecularEnabled(bool enabled);
-	void SetLights(std::vector<Light*>* lights);
+	float GetExposure() const { return exposure; }
+	// The lights stay owned by the caller (IBLSampler), also rebakes the irradiance map
+	void SetLights(const LightBlock* lights);
+	// Turns the environment lighting: the lights are rotated on upload, the cubemap and the
+	// irradiance map are looked up with the inverse rotation. Nothing is re-extracted or rebaked.
+	void SetEnvironmentRotation(const Quaternion& rotation);
 	void SetCamera(Camera* camera);
-	void Draw(GameObject* gameObject);
+	Camera* GetCamera() const { return camera; }
+	void SetLodBias(float bias); // > 1 keeps finer levels longer
+	float GetLodBias() const { return lodBias; }
+
+	// Replaces the instance buffers, draws then pick a range of them. materialIndices has one
+	// entry per transform, indexing the materials of the last UpdateMaterialsUBO call.
+	void UploadInstances(const std::vector<InstanceTransform>& instances, const std::vector<GLint>& materialIndices);
+	// instanceCount copies of the object's mesh with the transforms at firstInstance onwards.
+	// shader replaces the object's one when given (e.g. a permutation without tone mapping).
+	void Draw(GameObject* gameObject, int lod, int firstInstance = 0, int instanceCount = 1, ShaderProgram* shader = nullptr);
+
+	int SelectLod(GameObject* gameObject);
+	float GetScreenSize(GameObject* gameObject);
 
 	void UpdateCameraUBO();
 	void UpdateLightsUBO();
+	void UpdateMaterialsUBO(const std::vector<Material*>& materials); // nullptr is the default material
 
 private:
 	GLvoid* cameraDataPtr;
-	GLuint cameraUBO;
+	GLuint cameraUBO = 0;
 	__camera cameraData;
 	Camera* camera;
 	
 	Texture* cubemapTexture;
 	GLuint sampler;
 
-	GLvoid* lightsDataPtr;
-	GLuint lightsUBO;
-	__lights lightsData;
-	std::vector<Light*>* lights;
+	GLuint lightsUBO = 0;
+	const LightBlock* lights;
+	Quaternion environmentRotation = Quaternion(1.0f, 0.0f, 0.0f, 0.0f);
+
+	GLuint materialsUBO = 0;
+	__materials materialsData;
+	Material defaultMaterial;
+
+	// Diffuse term of the lights, baked whenever they change (IRRADIANCE_MAP_SIZE per face)
+	Texture* irradianceMap = nullptr;
+	std::vector<float> irradianceTexels;
+	Vector3 ambientLight = Vector3(0.0f); // Sum of the light colors, the ambient term of lit.frag
 
 	float exposure;
-	bool specularEnabled;
+	float lodBias = 1.0f;
+
+	GLuint instanceBuffer = 0;
+	GLuint instanceMaterialBuffer = 0;
 	
 	void setupCameraUBO();
 	void setupLightsUBO();
+	void bakeIrradianceMap();
+	void bindInstances(int firstInstance);
 };
 
 #endif
\ No newline at end of file
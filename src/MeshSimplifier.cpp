@@ -0,0 +1,325 @@
+// MeshSimplifier.cpp
+#include "MeshSimplifier.h"
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	// Symmetric 4x4 error quadric, only the upper triangle is stored
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+		double weight = 0;
+
+		void addPlane(const glm::dvec3& n, double d, double weight)
+		{
+			a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+			a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+			a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+			a33 += weight * d * d;
+			this->weight += weight;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+		}
+
+		// Weighted mean of the squared distances of p to the accumulated planes
+		double evaluate(const glm::dvec3& p) const
+		{
+			if (weight <= 0.0) {
+				return 0.0;
+			}
+			double x = p.x, y = p.y, z = p.z;
+			double error = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+				+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+				+ a22 * z * z + 2 * a23 * z
+				+ a33;
+			return fabs(error) / weight;
+		}
+	};
+
+	struct Collapse
+	{
+		GLuint from, to;
+		double error;
+	};
+
+	struct PositionKey
+	{
+		GLuint bits[3];
+		bool operator==(const PositionKey& other) const
+		{
+			return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+		}
+	};
+
+	inline glm::dvec3 positionOf(const PackedVertex& v)
+	{
+		return glm::dvec3(v.position[0], v.position[1], v.position[2]);
+	}
+
+	inline unsigned long long edgeKey(GLuint a, GLuint b)
+	{
+		if (a > b) {
+			std::swap(a, b);
+		}
+		return ((unsigned long long)a << 32) | b;
+	}
+}
+
+float SimplifyMesh(const std::vector<PackedVertex>& vertices, const std::vector<GLuint>& indices,
+	size_t targetIndexCount, float maxError, std::vector<GLuint>& out)
+{
+	out = indices;
+	const size_t vertexCount = vertices.size();
+	if (out.size() <= targetIndexCount || vertexCount == 0) {
+		return 0.0f;
+	}
+
+	// Vertices that only differ in their attributes share a position id
+	std::vector<GLuint> positionId(vertexCount);
+	std::vector<GLuint> positionUsers(vertexCount, 0);
+	{
+		std::unordered_map<PositionKey, GLuint, PositionKeyHash> unique;
+		unique.reserve(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			PositionKey key;
+			memcpy(key.bits, vertices[i].position, sizeof(key.bits));
+			positionId[i] = unique.emplace(key, (GLuint)i).first->second;
+			positionUsers[positionId[i]]++;
+		}
+	}
+
+	// Seams and open or non-manifold edges are locked in place
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<unsigned long long, int> edgeUses;
+		edgeUses.reserve(out.size());
+		for (size_t i = 0; i < out.size(); i += 3) {
+			for (int e = 0; e < 3; e++) {
+				edgeUses[edgeKey(positionId[out[i + e]], positionId[out[i + (e + 1) % 3]])]++;
+			}
+		}
+		for (size_t i = 0; i < out.size(); i += 3) {
+			for (int e = 0; e < 3; e++) {
+				GLuint a = out[i + e], b = out[i + (e + 1) % 3];
+				if (edgeUses[edgeKey(positionId[a], positionId[b])] != 2) {
+					locked[a] = locked[b] = true;
+				}
+			}
+		}
+		for (size_t i = 0; i < vertexCount; i++) {
+			if (positionUsers[positionId[i]] > 1) {
+				locked[i] = true;
+			}
+		}
+	}
+
+	// Area weighted plane quadrics, accumulated per position
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < out.size(); i += 3) {
+		glm::dvec3 p0 = positionOf(vertices[out[i]]);
+		glm::dvec3 p1 = positionOf(vertices[out[i + 1]]);
+		glm::dvec3 p2 = positionOf(vertices[out[i + 2]]);
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double area = glm::length(normal);
+		if (area <= 0.0) {
+			continue;
+		}
+		normal /= area;
+		double d = -glm::dot(normal, p0);
+		for (int c = 0; c < 3; c++) {
+			quadrics[positionId[out[i + c]]].addPlane(normal, d, area * 0.5);
+		}
+	}
+
+	const double errorLimit = (double)maxError * maxError;
+	double resultError = 0.0;
+
+	std::vector<GLuint> triangleOffsets(vertexCount + 1);
+	std::vector<GLuint> vertexTriangles;
+	std::vector<GLuint> collapseTarget(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+	std::vector<GLuint> fromNeighbours, toNeighbours;
+
+	while (out.size() > targetIndexCount) {
+		const size_t triangleCount = out.size() / 3;
+
+		// Vertex -> triangle adjacency of the current index buffer
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (GLuint index : out) {
+			triangleOffsets[index + 1]++;
+		}
+		for (size_t i = 0; i < vertexCount; i++) {
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+		vertexTriangles.resize(out.size());
+		{
+			std::vector<GLuint> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < out.size(); i++) {
+				vertexTriangles[cursor[out[i]]++] = i / 3;
+			}
+		}
+
+		// Every half edge leaving an unlocked vertex is a candidate
+		collapses.clear();
+		for (size_t i = 0; i < out.size(); i += 3) {
+			for (int e = 0; e < 3; e++) {
+				GLuint a = out[i + e], b = out[i + (e + 1) % 3];
+				Quadric q = quadrics[positionId[a]];
+				q.add(quadrics[positionId[b]]);
+				if (!locked[a]) {
+					collapses.push_back({ a, b, q.evaluate(positionOf(vertices[b])) });
+				}
+				if (!locked[b]) {
+					collapses.push_back({ b, a, q.evaluate(positionOf(vertices[a])) });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+		// Apply the cheapest independent collapses, each one usually removes two triangles
+		for (size_t i = 0; i < vertexCount; i++) {
+			collapseTarget[i] = i;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+		size_t trianglesToRemove = (out.size() - targetIndexCount) / 3;
+		size_t trianglesRemoved = 0;
+		size_t applied = 0;
+		for (const Collapse& collapse : collapses) {
+			if (trianglesRemoved >= trianglesToRemove || collapse.error > errorLimit) {
+				break;
+			}
+			GLuint from = collapse.from, to = collapse.to;
+			if (touched[from] || touched[to]) {
+				continue;
+			}
+
+			// Link condition: an interior edge has exactly two common neighbours
+			fromNeighbours.clear();
+			toNeighbours.clear();
+			for (GLuint t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+				for (int c = 0; c < 3; c++) {
+					fromNeighbours.push_back(positionId[out[vertexTriangles[t] * 3 + c]]);
+				}
+			}
+			for (GLuint t = triangleOffsets[to]; t < triangleOffsets[to + 1]; t++) {
+				for (int c = 0; c < 3; c++) {
+					toNeighbours.push_back(positionId[out[vertexTriangles[t] * 3 + c]]);
+				}
+			}
+			std::sort(fromNeighbours.begin(), fromNeighbours.end());
+			fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+			std::sort(toNeighbours.begin(), toNeighbours.end());
+			toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+			size_t common = 0;
+			for (size_t a = 0, b = 0; a < fromNeighbours.size() && b < toNeighbours.size();) {
+				if (fromNeighbours[a] < toNeighbours[b]) a++;
+				else if (fromNeighbours[a] > toNeighbours[b]) b++;
+				else { common++; a++; b++; }
+			}
+			if (common != 4) { // The two endpoints themselves and the two opposite vertices
+				continue;
+			}
+
+			// Reject collapses that flip a remaining triangle
+			bool flips = false;
+			size_t removed = 0;
+			glm::dvec3 target = positionOf(vertices[to]);
+			for (GLuint t = triangleOffsets[from]; t < triangleOffsets[from + 1] && !flips; t++) {
+				const GLuint* triangle = &out[vertexTriangles[t] * 3];
+				if (positionId[triangle[0]] == positionId[to] || positionId[triangle[1]] == positionId[to] || positionId[triangle[2]] == positionId[to]) {
+					removed++;
+					continue;
+				}
+				glm::dvec3 p[3], q[3];
+				for (int c = 0; c < 3; c++) {
+					p[c] = positionOf(vertices[triangle[c]]);
+					q[c] = triangle[c] == from ? target : p[c];
+				}
+				glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0.0;
+			}
+			if (flips) {
+				continue;
+			}
+
+			collapseTarget[from] = to;
+			quadrics[positionId[to]].add(quadrics[positionId[from]]);
+			for (GLuint t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++) {
+				for (int c = 0; c < 3; c++) {
+					touched[out[vertexTriangles[t] * 3 + c]] = true;
+				}
+			}
+			resultError = std::max(resultError, collapse.error);
+			trianglesRemoved += removed;
+			applied++;
+		}
+		if (applied == 0) {
+			break;
+		}
+
+		// Rewrite the indices and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < triangleCount; i++) {
+			GLuint a = collapseTarget[out[i * 3]], b = collapseTarget[out[i * 3 + 1]], c = collapseTarget[out[i * 3 + 2]];
+			if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[a] == positionId[c]) {
+				continue;
+			}
+			out[write++] = a;
+			out[write++] = b;
+			out[write++] = c;
+		}
+		out.resize(write);
+	}
+
+	return (float)sqrt(resultError);
+}
+
+void BuildLodChain(ProcessedMesh& mesh)
+{
+	mesh.lods.clear();
+	mesh.lods.push_back({ 0, (GLuint)mesh.indices.size(), 0.0f });
+
+	Vector3 boundsMin, boundsMax;
+	CalculateBounds(mesh, boundsMin, boundsMax);
+	float diagonal = glm::length(boundsMax - boundsMin);
+
+	std::vector<GLuint> previous(mesh.indices), simplified;
+	float errorBudget = LOD_BASE_ERROR * diagonal;
+	while (mesh.lods.size() < MAX_MESH_LODS && previous.size() / 3 > LOD_MIN_TRIANGLES) {
+		size_t target = (size_t)(previous.size() / 3 * LOD_TRIANGLE_RATIO) * 3;
+		float error = SimplifyMesh(mesh.vertices, previous, target, errorBudget, simplified);
+		if (simplified.size() < 3 || simplified.size() > previous.size() * LOD_MIN_REDUCTION) {
+			break;
+		}
+		OptimizeVertexCache(simplified, mesh.vertices.size());
+
+		// Errors of consecutive levels add up, each level is simplified from the previous one
+		mesh.lods.push_back({ (GLuint)mesh.indices.size(), (GLuint)simplified.size(), mesh.lods.back().error + error });
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		previous.swap(simplified);
+		errorBudget *= 2.0f;
+	}
+}
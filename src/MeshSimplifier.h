@@ -0,0 +1,28 @@
+// MeshSimplifier.h
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "typedefs.h"
+#include "MeshProcessor.h"
+#include <vector>
+#include <GL/glew.h>
+
+// Quadric error metric edge collapse simplification (Garland & Heckbert).
+// Vertices are collapsed onto one of their neighbours instead of an optimal position, so every
+// level of detail keeps indexing the original vertex buffer and only needs its own index range.
+// Border vertices and attribute seams (several vertices sharing a position) never move.
+// Returns the resulting error as a distance in object space.
+float SimplifyMesh(const std::vector<PackedVertex>& vertices, const std::vector<GLuint>& indices,
+	size_t targetIndexCount, float maxError, std::vector<GLuint>& out);
+
+// LOD chain parameters: every level targets half the triangles of the previous one,
+// with an error budget relative to the bounding box diagonal that doubles per level
+const float LOD_TRIANGLE_RATIO = 0.5f;
+const float LOD_BASE_ERROR = 0.01f;
+const size_t LOD_MIN_TRIANGLES = 32;
+const float LOD_MIN_REDUCTION = 0.85f; // Stop once a level keeps more than this fraction of the previous one
+
+// Fills mesh.lods from mesh.indices (which must hold only LOD 0) and appends the coarser levels
+void BuildLodChain(ProcessedMesh& mesh);
+
+#endif
@@ -0,0 +1,454 @@
+// ObjParser.cpp
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+	enum ObjLineType
+	{
+		OBJ_LINE_OTHER,
+		OBJ_LINE_VERTEX,
+		OBJ_LINE_TEXTURE,
+		OBJ_LINE_NORMAL,
+		OBJ_LINE_FACE,
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		// Filled by the counting pass
+		size_t vertexCount = 0, textureCount = 0, normalCount = 0, triangleCount = 0, quadCount = 0;
+		// Where this chunk writes in the shared arrays (prefix sums of the counts)
+		size_t vertexOffset = 0, textureOffset = 0, normalOffset = 0, triangleOffset = 0, quadOffset = 0;
+		// Filled by the parsing pass, faces can be dropped if they turn out malformed
+		size_t trianglesWritten = 0, quadsWritten = 0;
+		size_t skippedLines = 0;
+	};
+
+	struct ObjCorner
+	{
+		GLuint v, t, n;
+	};
+
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* lineEnd(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline : end;
+	}
+
+	// Classifies the line and moves p past the keyword
+	inline ObjLineType classifyLine(const char*& p, const char* end)
+	{
+		p = skipSpaces(p, end);
+		if (end - p < 2) {
+			return OBJ_LINE_OTHER;
+		}
+		if (p[0] == 'v') {
+			if (isSpace(p[1])) {
+				p += 2;
+				return OBJ_LINE_VERTEX;
+			}
+			if (end - p >= 3 && isSpace(p[2])) {
+				if (p[1] == 't') {
+					p += 3;
+					return OBJ_LINE_TEXTURE;
+				}
+				if (p[1] == 'n') {
+					p += 3;
+					return OBJ_LINE_NORMAL;
+				}
+			}
+		}
+		else if (p[0] == 'f' && isSpace(p[1])) {
+			p += 2;
+			return OBJ_LINE_FACE;
+		}
+		return OBJ_LINE_OTHER;
+	}
+
+	inline bool parseFloat(const char*& p, const char* end, float& value)
+	{
+		p = skipSpaces(p, end);
+		if (p < end && *p == '+') {
+			p++; // from_chars does not accept a leading plus
+		}
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc()) {
+			return false;
+		}
+		p = result.ptr;
+		return true;
+	}
+
+	inline bool parseIndex(const char*& p, const char* end, long& value)
+	{
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc() || value == 0) {
+			return false;
+		}
+		p = result.ptr;
+		return true;
+	}
+
+	// 1-based or negative (relative) OBJ index to 0-based
+	inline GLuint resolveIndex(long index, size_t currentCount)
+	{
+		return index > 0 ? (GLuint)(index - 1) : (GLuint)(currentCount + index);
+	}
+
+	inline int countFaceCorners(const char* p, const char* end)
+	{
+		int corners = 0;
+		while (true) {
+			p = skipSpaces(p, end);
+			if (p >= end) {
+				break;
+			}
+			corners++;
+			while (p < end && !isSpace(*p)) {
+				p++;
+			}
+		}
+		return corners;
+	}
+
+	inline bool keepAsQuad(bool useTriangles, int corners)
+	{
+		return !useTriangles && corners == 4;
+	}
+
+	void countChunk(ObjChunk& chunk, bool useTriangles)
+	{
+		const char* p = chunk.begin;
+		while (p < chunk.end) {
+			const char* end = lineEnd(p, chunk.end);
+			switch (classifyLine(p, end)) {
+				case OBJ_LINE_VERTEX: chunk.vertexCount++; break;
+				case OBJ_LINE_TEXTURE: chunk.textureCount++; break;
+				case OBJ_LINE_NORMAL: chunk.normalCount++; break;
+				case OBJ_LINE_FACE: {
+					int corners = countFaceCorners(p, end);
+					if (keepAsQuad(useTriangles, corners)) {
+						chunk.quadCount++;
+					}
+					else if (corners >= 3) {
+						chunk.triangleCount += corners - 2;
+					}
+					break;
+				}
+				default: break;
+			}
+			p = end + 1;
+		}
+	}
+
+	inline void emitTriangle(ObjData& data, ObjChunk& chunk, const ObjCorner& a, const ObjCorner& b, const ObjCorner& c)
+	{
+		Triangle& triangle = data.triangles[chunk.triangleOffset + chunk.trianglesWritten++];
+		triangle.vIndex[0] = a.v; triangle.vIndex[1] = b.v; triangle.vIndex[2] = c.v;
+		triangle.tIndex[0] = a.t; triangle.tIndex[1] = b.t; triangle.tIndex[2] = c.t;
+		triangle.nIndex[0] = a.n; triangle.nIndex[1] = b.n; triangle.nIndex[2] = c.n;
+	}
+
+	void parseChunk(ObjData& data, ObjChunk& chunk, bool useTriangles)
+	{
+		size_t vertexCount = 0, textureCount = 0, normalCount = 0;
+
+		const char* p = chunk.begin;
+		while (p < chunk.end) {
+			const char* end = lineEnd(p, chunk.end);
+			switch (classifyLine(p, end)) {
+				case OBJ_LINE_VERTEX: {
+					// Always written, so the preallocated slot count matches the counting pass
+					Vector3& vertex = data.vertices[chunk.vertexOffset + vertexCount++];
+					vertex = Vector3(0.0f);
+					if (!parseFloat(p, end, vertex.x) || !parseFloat(p, end, vertex.y) || !parseFloat(p, end, vertex.z)) {
+						chunk.skippedLines++;
+					}
+					break;
+				}
+				case OBJ_LINE_TEXTURE: {
+					Vector2& texture = data.textures[chunk.textureOffset + textureCount++];
+					texture = Vector2(0.0f);
+					if (!parseFloat(p, end, texture.x) || !parseFloat(p, end, texture.y)) {
+						chunk.skippedLines++;
+					}
+					break;
+				}
+				case OBJ_LINE_NORMAL: {
+					Vector3& normal = data.normals[chunk.normalOffset + normalCount++];
+					normal = Vector3(0.0f);
+					if (!parseFloat(p, end, normal.x) || !parseFloat(p, end, normal.y) || !parseFloat(p, end, normal.z)) {
+						chunk.skippedLines++;
+					}
+					break;
+				}
+				case OBJ_LINE_FACE: {
+					// Relative indices refer to the elements defined so far in the whole file
+					size_t currentVertices = chunk.vertexOffset + vertexCount;
+					size_t currentTextures = chunk.textureOffset + textureCount;
+					size_t currentNormals = chunk.normalOffset + normalCount;
+
+					// The first four corners are held back until we know if the face is a quad
+					ObjCorner corners[4];
+					int cornerCount = 0;
+					size_t trianglesBefore = chunk.trianglesWritten;
+					bool valid = true;
+					while (valid) {
+						p = skipSpaces(p, end);
+						if (p >= end) {
+							break;
+						}
+
+						ObjCorner corner = { 0, OBJ_MISSING_INDEX, OBJ_MISSING_INDEX };
+						long index;
+						valid = parseIndex(p, end, index);
+						corner.v = resolveIndex(index, currentVertices);
+						if (valid && p < end && *p == '/') {
+							p++;
+							if (p < end && *p != '/') { // v/vt
+								valid = parseIndex(p, end, index);
+								corner.t = resolveIndex(index, currentTextures);
+							}
+							if (valid && p < end && *p == '/') { // v//vn or v/vt/vn
+								p++;
+								valid = parseIndex(p, end, index);
+								corner.n = resolveIndex(index, currentNormals);
+							}
+						}
+						if (valid && p < end && !isSpace(*p)) {
+							valid = false;
+						}
+						if (!valid) {
+							break;
+						}
+
+						if (cornerCount < 4) {
+							corners[cornerCount] = corner;
+						}
+						cornerCount++;
+
+						// Five or more corners, this is a polygon: flush the held back corners and keep fanning
+						if (cornerCount == 5) {
+							emitTriangle(data, chunk, corners[0], corners[1], corners[2]);
+							emitTriangle(data, chunk, corners[0], corners[2], corners[3]);
+						}
+						if (cornerCount >= 5) {
+							emitTriangle(data, chunk, corners[0], corners[3], corner);
+							corners[3] = corner;
+						}
+					}
+
+					if (!valid || cornerCount < 3) {
+						chunk.trianglesWritten = trianglesBefore;
+						chunk.skippedLines++;
+					}
+					else if (keepAsQuad(useTriangles, cornerCount)) {
+						Quad& quad = data.quads[chunk.quadOffset + chunk.quadsWritten++];
+						for (int i = 0; i < 4; i++) {
+							quad.vIndex[i] = corners[i].v;
+							quad.tIndex[i] = corners[i].t;
+							quad.nIndex[i] = corners[i].n;
+						}
+					}
+					else if (cornerCount <= 4) {
+						emitTriangle(data, chunk, corners[0], corners[1], corners[2]);
+						if (cornerCount == 4) {
+							emitTriangle(data, chunk, corners[0], corners[2], corners[3]);
+						}
+					}
+					break;
+				}
+				default: break;
+			}
+			p = end + 1;
+		}
+	}
+
+	// Moves each chunk's written faces next to the previous chunk's, when malformed faces left gaps
+	template <typename T>
+	size_t compactFaces(std::vector<T>& faces, std::vector<ObjChunk>& chunks, size_t ObjChunk::*offset, size_t ObjChunk::*written)
+	{
+		size_t count = 0;
+		for (ObjChunk& chunk : chunks) {
+			if (chunk.*offset != count) {
+				std::copy(faces.begin() + chunk.*offset, faces.begin() + chunk.*offset + chunk.*written, faces.begin() + count);
+			}
+			count += chunk.*written;
+		}
+		faces.resize(count);
+		return count;
+	}
+
+	// Area weighted smooth normals, one per position. replace drops the normals of the file,
+	// otherwise they are kept and only the corners without vn get the generated ones.
+	void generateNormals(ObjData& data, bool replace)
+	{
+		std::vector<Vector3> smooth(data.vertices.size(), Vector3(0.0f));
+		auto accumulate = [&data, &smooth](GLuint a, GLuint b, GLuint c) {
+			if (a >= data.vertices.size() || b >= data.vertices.size() || c >= data.vertices.size()) {
+				return;
+			}
+			Vector3 faceNormal = glm::cross(data.vertices[b] - data.vertices[a], data.vertices[c] - data.vertices[a]);
+			smooth[a] += faceNormal;
+			smooth[b] += faceNormal;
+			smooth[c] += faceNormal;
+		};
+		for (const Triangle& t : data.triangles) {
+			accumulate(t.vIndex[0], t.vIndex[1], t.vIndex[2]);
+		}
+		for (const Quad& q : data.quads) {
+			accumulate(q.vIndex[0], q.vIndex[1], q.vIndex[2]);
+			accumulate(q.vIndex[0], q.vIndex[2], q.vIndex[3]);
+		}
+		for (Vector3& normal : smooth) {
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : Vector3(0.0f, 1.0f, 0.0f);
+		}
+
+		// The generated normals follow the ones of the file, indexed like the positions
+		GLuint base = replace ? 0 : (GLuint)data.normals.size();
+		if (replace) {
+			data.normals = std::move(smooth);
+		}
+		else {
+			data.normals.insert(data.normals.end(), smooth.begin(), smooth.end());
+		}
+		auto assign = [replace, base](const GLuint* v, GLuint* n, int corners) {
+			for (int i = 0; i < corners; i++) {
+				if (replace || n[i] == OBJ_MISSING_INDEX) {
+					n[i] = base + v[i];
+				}
+			}
+		};
+		for (Triangle& t : data.triangles) {
+			assign(t.vIndex, t.nIndex, 3);
+		}
+		for (Quad& q : data.quads) {
+			assign(q.vIndex, q.nIndex, 4);
+		}
+		data.generatedNormals = true;
+	}
+}
+
+bool LoadObjData(const char* path, ObjData& data, bool useTriangles, bool withNormals, int threadCount)
+{
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cerr << "Unable to open file " << path << std::endl;
+		return false;
+	}
+	const char* begin = file.getData();
+	const char* end = begin + file.getSize();
+
+	if (threadCount <= 0) {
+		size_t bySize = file.getSize() / OBJ_MIN_CHUNK_SIZE;
+		size_t byHardware = std::max(1u, std::thread::hardware_concurrency());
+		threadCount = (int)std::max<size_t>(1, std::min(bySize, byHardware));
+	}
+
+	// Split at line boundaries
+	std::vector<ObjChunk> chunks(threadCount);
+	const char* chunkBegin = begin;
+	for (int i = 0; i < threadCount; i++) {
+		const char* chunkEnd = i == threadCount - 1 ? end : begin + file.getSize() * (i + 1) / threadCount;
+		if (chunkEnd < chunkBegin) {
+			chunkEnd = chunkBegin;
+		}
+		if (chunkEnd < end) {
+			chunkEnd = lineEnd(chunkEnd, end);
+			chunkEnd = chunkEnd < end ? chunkEnd + 1 : end;
+		}
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	auto runChunks = [&chunks](auto&& function) {
+		if (chunks.size() == 1) {
+			function(chunks[0]);
+			return;
+		}
+		std::vector<std::thread> threads;
+		threads.reserve(chunks.size());
+		for (ObjChunk& chunk : chunks) {
+			threads.emplace_back([&function, &chunk]() { function(chunk); });
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	};
+
+	// Pass 1: count, so every array is allocated exactly once
+	runChunks([useTriangles](ObjChunk& chunk) { countChunk(chunk, useTriangles); });
+
+	size_t vertexCount = 0, textureCount = 0, normalCount = 0, triangleCount = 0, quadCount = 0;
+	for (ObjChunk& chunk : chunks) {
+		chunk.vertexOffset = vertexCount;
+		chunk.textureOffset = textureCount;
+		chunk.normalOffset = normalCount;
+		chunk.triangleOffset = triangleCount;
+		chunk.quadOffset = quadCount;
+		vertexCount += chunk.vertexCount;
+		textureCount += chunk.textureCount;
+		normalCount += chunk.normalCount;
+		triangleCount += chunk.triangleCount;
+		quadCount += chunk.quadCount;
+	}
+	data.vertices.resize(vertexCount);
+	data.textures.resize(textureCount);
+	data.normals.resize(normalCount);
+	data.triangles.resize(triangleCount);
+	data.quads.resize(quadCount);
+
+	// Pass 2: parse in place
+	runChunks([&data, useTriangles](ObjChunk& chunk) { parseChunk(data, chunk, useTriangles); });
+
+	data.skippedLines = 0;
+	for (const ObjChunk& chunk : chunks) {
+		data.skippedLines += chunk.skippedLines;
+	}
+	compactFaces(data.triangles, chunks, &ObjChunk::triangleOffset, &ObjChunk::trianglesWritten);
+	compactFaces(data.quads, chunks, &ObjChunk::quadOffset, &ObjChunk::quadsWritten);
+
+	if (data.skippedLines > 0) {
+		std::cerr << "OBJ " << path << ": skipped " << data.skippedLines << " malformed lines" << std::endl;
+	}
+
+	// Files without vn get generated normals, faces without vn in files with them get their own
+	bool replaceNormals = !withNormals || data.normals.empty();
+	bool missingNormals = replaceNormals;
+	for (size_t i = 0; i < data.triangles.size() && !missingNormals; i++) {
+		const GLuint* n = data.triangles[i].nIndex;
+		missingNormals = n[0] == OBJ_MISSING_INDEX || n[1] == OBJ_MISSING_INDEX || n[2] == OBJ_MISSING_INDEX;
+	}
+	for (size_t i = 0; i < data.quads.size() && !missingNormals; i++) {
+		const GLuint* n = data.quads[i].nIndex;
+		missingNormals = std::find(n, n + 4, OBJ_MISSING_INDEX) != n + 4;
+	}
+	data.generatedNormals = false;
+	if (missingNormals) {
+		generateNormals(data, replaceNormals);
+	}
+
+	return true;
+}
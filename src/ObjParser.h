@@ -0,0 +1,36 @@
+// ObjParser.h
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include "typedefs.h"
+#include "Mesh.h"
+#include <vector>
+
+// Marks a missing vt/vn reference in Triangle/Quad indices
+const GLuint OBJ_MISSING_INDEX = ~0u;
+
+// Files smaller than this are parsed on the calling thread
+const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+// Raw OBJ contents, faces reference the arrays with 0-based indices
+struct ObjData
+{
+	std::vector<Vector3> vertices;
+	std::vector<Vector2> textures;
+	std::vector<Vector3> normals;
+	std::vector<Triangle> triangles;
+	std::vector<Quad> quads;
+	size_t skippedLines = 0; // Malformed or degenerate lines
+	bool generatedNormals = false;
+};
+
+// Memory maps the file and parses it with std::from_chars. Large files are split into
+// chunks at line boundaries and parsed on multiple threads: a counting pass sizes every
+// array up front, so the parsing pass writes in place without allocating per line.
+// Faces may be v, v/vt, v//vn or v/vt/vn, polygons are fan triangulated. When useTriangles is false,
+// quads are kept in the quads array. Smooth normals are generated if the file has none or withNormals is false,
+// and for the faces without vn of a file that has some.
+// threadCount == 0 picks the number of threads from the file size and hardware.
+bool LoadObjData(const char* path, ObjData& data, bool useTriangles = true, bool withNormals = true, int threadCount = 0);
+
+#endif
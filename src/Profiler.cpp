@@ -0,0 +1,186 @@
+// Profiler.cpp
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+
+// Weight of the newest frame in the rolling pass averages
+static const double PASS_STATS_SMOOTHING = 0.1;
+
+Profiler* Profiler::instance = nullptr;
+
+Profiler* Profiler::Get()
+{
+	if (instance == nullptr) {
+		instance = new Profiler();
+	}
+	return instance;
+}
+
+Profiler::Profiler()
+	: epoch(std::chrono::steady_clock::now())
+{
+	frameTimes.reserve(PROFILER_FRAME_HISTORY);
+}
+
+double Profiler::now() const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::BeginFrame()
+{
+	double time = now();
+	if (frameStart >= 0.0) {
+		double frameMilliseconds = (time - frameStart) / 1000.0;
+		if (frameTimes.size() < PROFILER_FRAME_HISTORY) {
+			frameTimes.push_back(frameMilliseconds);
+		}
+		else {
+			frameTimes[frameTimeCursor] = frameMilliseconds;
+		}
+		frameTimeCursor = (frameTimeCursor + 1) % PROFILER_FRAME_HISTORY;
+
+		if (captureFramesLeft > 0) {
+			captureEvents.push_back({ "Frame", false, frameStart, time - frameStart });
+			if (--captureFramesLeft == 0) {
+				writeCapture();
+			}
+		}
+	}
+	frameStart = time;
+	frameIndex++;
+
+	// This slot was last used PROFILER_FRAME_LATENCY frames ago, its queries are (almost always) done
+	collectQueries(frames[frameIndex % PROFILER_FRAME_LATENCY]);
+}
+
+void Profiler::BeginCpuScope(const char* name)
+{
+	scopeStack.push_back({ name, now(), false });
+}
+
+void Profiler::EndCpuScope()
+{
+	assert(!scopeStack.empty());
+	OpenScope scope = scopeStack.back();
+	scopeStack.pop_back();
+	if (scope.gpu) {
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuScopeOpen = false;
+	}
+	recordCpu(scope.name, scope.start, now());
+}
+
+void Profiler::BeginGpuScope(const char* name)
+{
+	OpenScope scope = { name, now(), false };
+	if (!gpuScopeOpen) {
+		FrameQueries& frame = frames[frameIndex % PROFILER_FRAME_LATENCY];
+		if (frame.pending.size() == frame.pool.size()) {
+			GLuint query;
+			glGenQueries(1, &query);
+			frame.pool.push_back(query);
+		}
+		GLuint query = frame.pool[frame.pending.size()];
+		frame.pending.push_back({ name, scope.start, query });
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		scope.gpu = true;
+		gpuScopeOpen = true;
+	}
+	scopeStack.push_back(scope);
+}
+
+void Profiler::EndGpuScope()
+{
+	EndCpuScope();
+}
+
+void Profiler::recordCpu(const char* name, double start, double end)
+{
+	ProfilerPassStats& stats = passStats[name];
+	stats.cpuMilliseconds += PASS_STATS_SMOOTHING * ((end - start) / 1000.0 - stats.cpuMilliseconds);
+	stats.calls++;
+	if (captureFramesLeft > 0) {
+		captureEvents.push_back({ name, false, start, end - start });
+	}
+}
+
+void Profiler::collectQueries(FrameQueries& frame)
+{
+	for (const PendingQuery& pending : frame.pending) {
+		GLint available = 0;
+		glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			continue; // Dropped instead of waiting, the query object is simply reused
+		}
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &nanoseconds);
+
+		ProfilerPassStats& stats = passStats[pending.name];
+		stats.gpuMilliseconds += PASS_STATS_SMOOTHING * (nanoseconds / 1.0e6 - stats.gpuMilliseconds);
+		if (captureFramesLeft > 0) {
+			// TIME_ELAPSED has no start timestamp, GPU events are placed at their CPU submission time
+			captureEvents.push_back({ pending.name, true, pending.cpuStart, nanoseconds / 1000.0 });
+		}
+	}
+	frame.pending.clear();
+}
+
+double Profiler::GetFrameTimePercentile(double p) const
+{
+	if (frameTimes.empty()) {
+		return 0.0;
+	}
+	std::vector<double> sorted(frameTimes);
+	size_t index = std::min(sorted.size() - 1, (size_t)(p / 100.0 * sorted.size()));
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+void Profiler::PrintPassStats() const
+{
+	std::cout << std::fixed << std::setprecision(3)
+		<< "Frame time p50 " << GetFrameTimePercentile(50) << " ms, p95 " << GetFrameTimePercentile(95)
+		<< " ms, p99 " << GetFrameTimePercentile(99) << " ms" << std::endl;
+	for (const auto& pass : passStats) {
+		std::cout << "  " << std::left << std::setw(24) << pass.first << std::right
+			<< " cpu " << std::setw(8) << pass.second.cpuMilliseconds << " ms"
+			<< "  gpu " << std::setw(8) << pass.second.gpuMilliseconds << " ms" << std::endl;
+	}
+}
+
+void Profiler::StartCapture(const std::string& path, int frameCount)
+{
+	capturePath = path;
+	captureFramesLeft = frameCount;
+	captureEvents.clear();
+	std::cout << "Profiler: capturing " << frameCount << " frames" << std::endl;
+}
+
+void Profiler::writeCapture()
+{
+	std::ofstream file(capturePath);
+	if (!file.is_open()) {
+		std::cerr << "Profiler: unable to open " << capturePath << std::endl;
+		return;
+	}
+
+	// Chrome trace event format, complete ("X") events in microseconds
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	for (const ProfilerEvent& event : captureEvents) {
+		file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+			<< ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+	}
+	file << "\n]}\n";
+
+	std::cout << "Profiler: wrote " << captureEvents.size() << " events to " << capturePath << std::endl;
+	captureEvents.clear();
+	PrintPassStats();
+}
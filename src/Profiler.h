@@ -0,0 +1,126 @@
+// Profiler.h
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "typedefs.h"
+#include <GL/glew.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+
+// GPU results are read back this many frames later, so the queries never stall the pipeline
+const int PROFILER_FRAME_LATENCY = 2;
+// Frame times kept for the rolling percentiles
+const int PROFILER_FRAME_HISTORY = 240;
+// Frames recorded by one Chrome trace capture
+const int PROFILER_DEFAULT_CAPTURE_FRAMES = 120;
+
+struct ProfilerEvent
+{
+	const char* name;
+	bool gpu;
+	double start; // Microseconds since the profiler was created
+	double duration; // Microseconds
+};
+
+// Rolling per-pass statistics, averaged per call
+struct ProfilerPassStats
+{
+	double cpuMilliseconds = 0.0;
+	double gpuMilliseconds = 0.0;
+	int calls = 0;
+};
+
+// Frame profiler: CPU scope timers plus GL_TIME_ELAPSED queries around GPU passes.
+// The query pools are double buffered per frame (PROFILER_FRAME_LATENCY), results are only read
+// once GL_QUERY_RESULT_AVAILABLE says so. GL_TIME_ELAPSED queries can not nest, so GPU scopes
+// opened inside another GPU scope are only timed on the CPU.
+// Scope names must be string literals (or otherwise outlive the profiler).
+class Profiler
+{
+public:
+	static Profiler* Get();
+
+	void BeginFrame();
+
+	void BeginCpuScope(const char* name);
+	void EndCpuScope();
+	void BeginGpuScope(const char* name);
+	void EndGpuScope();
+
+	// Records the next frameCount frames and writes them as Chrome trace JSON (chrome://tracing, Perfetto)
+	void StartCapture(const std::string& path, int frameCount = PROFILER_DEFAULT_CAPTURE_FRAMES);
+	bool IsCapturing() const { return captureFramesLeft > 0; }
+
+	// Frame time percentile over the last PROFILER_FRAME_HISTORY frames, p in [0, 100]
+	double GetFrameTimePercentile(double p) const;
+	const std::map<std::string, ProfilerPassStats>& GetPassStats() const { return passStats; }
+	void PrintPassStats() const;
+
+private:
+	Profiler();
+
+	struct OpenScope
+	{
+		const char* name;
+		double start;
+		bool gpu; // Owns the running GL_TIME_ELAPSED query
+	};
+	struct PendingQuery
+	{
+		const char* name;
+		double cpuStart;
+		GLuint query;
+	};
+	struct FrameQueries
+	{
+		std::vector<GLuint> pool;
+		std::vector<PendingQuery> pending;
+	};
+
+	std::chrono::steady_clock::time_point epoch;
+	long long frameIndex = 0;
+	double frameStart = -1.0;
+
+	std::vector<OpenScope> scopeStack;
+	bool gpuScopeOpen = false;
+	FrameQueries frames[PROFILER_FRAME_LATENCY];
+
+	std::vector<double> frameTimes; // Ring buffer, milliseconds
+	size_t frameTimeCursor = 0;
+
+	std::map<std::string, ProfilerPassStats> passStats;
+
+	std::string capturePath;
+	int captureFramesLeft = 0;
+	std::vector<ProfilerEvent> captureEvents;
+
+	static Profiler* instance;
+
+	double now() const;
+	void collectQueries(FrameQueries& frame);
+	void recordCpu(const char* name, double start, double end);
+	void writeCapture();
+};
+
+// RAII helpers, e.g. PROFILE_GPU_SCOPE("Skybox");
+class ProfileCpuScope
+{
+public:
+	ProfileCpuScope(const char* name) { Profiler::Get()->BeginCpuScope(name); }
+	~ProfileCpuScope() { Profiler::Get()->EndCpuScope(); }
+};
+class ProfileGpuScope
+{
+public:
+	ProfileGpuScope(const char* name) { Profiler::Get()->BeginGpuScope(name); }
+	~ProfileGpuScope() { Profiler::Get()->EndGpuScope(); }
+};
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+#define PROFILE_CPU_SCOPE(name) ProfileCpuScope PROFILER_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfileGpuScope PROFILER_CONCAT(profileScope, __LINE__)(name)
+
+#endif
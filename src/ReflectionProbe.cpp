@@ -0,0 +1,101 @@
+// ReflectionProbe.cpp
+#include "ReflectionProbe.h"
+#include <algorithm>
+
+ReflectionProbe::ReflectionProbe(GameObject* owner, int size)
+	: owner(owner)
+{
+	assert(owner != nullptr);
+	// Half floats are color renderable everywhere, RGB32F is not
+	cubemap = Texture::CreateCubemap(size, size, GL_RGBA16F);
+	cubemap->setName("reflection probe");
+	framebuffer = Framebuffer::CreateCubemapFaceFramebuffer(cubemap);
+}
+
+ReflectionProbe::~ReflectionProbe()
+{
+	delete framebuffer;
+	delete cubemap;
+}
+
+Vector3 ReflectionProbe::GetPosition() const
+{
+	return Vector3(owner->GetInstance().model[3]);
+}
+
+void ReflectionProbe::BindFace(int face)
+{
+	framebuffer->attachCubemapFace(face);
+	glViewport(0, 0, framebuffer->getWidth(), framebuffer->getHeight());
+}
+
+void ReflectionProbe::SetupFaceCamera(int face, Camera& camera) const
+{
+	// Forward and up of +X, -X, +Y, -Y, +Z, -Z. The faces are stored with t going down, hence
+	// the up vectors pointing to -y (and to +-z for the y faces).
+	static const Vector3 forwards[6] = {
+		Vector3(1, 0, 0), Vector3(-1, 0, 0), Vector3(0, 1, 0), Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1)
+	};
+	static const Vector3 ups[6] = {
+		Vector3(0, -1, 0), Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1), Vector3(0, -1, 0), Vector3(0, -1, 0)
+	};
+	Vector3 forward = forwards[face];
+	Vector3 up = ups[face];
+
+	camera.setType(PERSPECTIVE);
+	camera.setFieldOfView(90.0);
+	camera.setAspectRatio(1.0);
+	camera.setNearPlane(REFLECTION_PROBE_NEAR_PLANE);
+	camera.setFarPlane(REFLECTION_PROBE_FAR_PLANE);
+	camera.setPosition(GetPosition());
+	// The camera looks down its -z
+	camera.setRotation(glm::quat_cast(Matrix3(glm::cross(forward, up), up, -forward)));
+}
+
+void ReflectionProbe::Invalidate()
+{
+	for (int face = 0; face < 6; face++) {
+		if (!stale[face]) {
+			staleFrames[face] = 0;
+		}
+		stale[face] = true;
+	}
+}
+
+void ReflectionProbe::AddMotion(float motion)
+{
+	this->motion = std::max(this->motion, motion);
+	Invalidate();
+}
+
+void ReflectionProbe::FaceUpdated(int face)
+{
+	stale[face] = false;
+	staleFrames[face] = 0;
+	drawnFaces |= 1 << face;
+	bool complete = true;
+	for (int i = 0; i < 6; i++) {
+		complete = complete && !stale[i];
+	}
+	if (complete) {
+		motion = 0.0f;
+	}
+}
+
+void ReflectionProbe::Age()
+{
+	for (int face = 0; face < 6; face++) {
+		if (stale[face]) {
+			staleFrames[face]++;
+		}
+	}
+}
+
+float ReflectionProbe::GetFacePriority(int face, const Vector3& viewerPosition) const
+{
+	if (!stale[face]) {
+		return 0.0f;
+	}
+	float distance = glm::length(GetPosition() - viewerPosition);
+	return (staleFrames[face] + 1) * (1.0f + motion) / (1.0f + distance);
+}
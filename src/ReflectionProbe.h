@@ -0,0 +1,65 @@
+// ReflectionProbe.h
+#ifndef REFLECTION_PROBE_H
+#define REFLECTION_PROBE_H
+
+#include "typedefs.h"
+#include "GameObject.h"
+#include "Camera.h"
+#include "Texture.h"
+#include "Framebuffer.h"
+
+const int REFLECTION_PROBE_SIZE = 256; // Face resolution
+const float REFLECTION_PROBE_NEAR_PLANE = 0.05f;
+const float REFLECTION_PROBE_FAR_PLANE = 100.0f;
+// Faces re-rendered per frame at most, fewer when the GPU budget does not fit them
+const int REFLECTION_PROBE_MAX_FACES_PER_FRAME = 2;
+const float REFLECTION_PROBE_BUDGET_MS = 1.0f;
+// Exposure change in stops that invalidates every face (0.15 is about 10%). Auto exposure follows
+// the view, so it needs a larger move before the faces are redrawn at once.
+const float REFLECTION_PROBE_EXPOSURE_STOPS = 0.15f;
+const float REFLECTION_PROBE_AUTO_EXPOSURE_STOPS = 1.0f;
+
+// The scene around a reflective object, rendered from the object's origin into a linear HDR
+// cubemap with the object itself left out. MIRROR, GLASS and GLOSSY look reflections up in it
+// instead of the environment, so reflective objects see each other.
+//
+// Faces go stale when something moves or the environment changes, FrameRenderer then redraws the
+// stalest, most important ones a few at a time (see GetFacePriority).
+class ReflectionProbe {
+public:
+	ReflectionProbe(GameObject* owner, int size = REFLECTION_PROBE_SIZE);
+	~ReflectionProbe();
+
+	GameObject* GetOwner() const { return owner; }
+	Texture* GetCubemap() const { return cubemap; }
+	Vector3 GetPosition() const;
+	bool IsReady() const { return drawnFaces == 0x3F; } // Every face was drawn at least once
+
+	// Binds the framebuffer with the face attached and sets the viewport to it
+	void BindFace(int face);
+	// Camera at the probe looking through the face, in the GL cubemap face orientation
+	void SetupFaceCamera(int face, Camera& camera) const;
+
+	// Every face has to be redrawn, e.g. the environment changed
+	void Invalidate();
+	// Something moved, the largest motion since the probe was last complete weighs its faces higher
+	void AddMotion(float motion);
+	void FaceUpdated(int face);
+	// Once per frame, stale faces get older
+	void Age();
+
+	// 0 for an up to date face. Otherwise grows with the frames the face has been stale and the
+	// motion around the probe, and shrinks with the probe's distance to the viewer.
+	float GetFacePriority(int face, const Vector3& viewerPosition) const;
+
+private:
+	GameObject* owner;
+	Texture* cubemap;
+	Framebuffer* framebuffer;
+	bool stale[6] = { true, true, true, true, true, true };
+	int staleFrames[6] = {};
+	float motion = 0.0f;
+	int drawnFaces = 0; // Bit per face
+};
+
+#endif
@@ -0,0 +1,170 @@
+// ResourceRegistry.cpp
+#include "ResourceRegistry.h"
+#include "utils.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	const char* typeName(ResourceType type)
+	{
+		switch (type) {
+			case RESOURCE_TEXTURE: return "texture";
+			case RESOURCE_RENDERBUFFER: return "renderbuffer";
+			case RESOURCE_BUFFER: return "buffer";
+			case RESOURCE_CPU: return "cpu";
+		}
+		return "unknown";
+	}
+
+	double megabytes(size_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+ResourceRegistry* ResourceRegistry::Get()
+{
+	// Initialized once even when the first call comes from a decoding thread
+	static ResourceRegistry* instance = new ResourceRegistry();
+	return instance;
+}
+
+void ResourceRegistry::Track(ResourceType type, uintptr_t id, const std::string& name, size_t bytes, bool transient)
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	records[std::make_pair(type, id)] = { name, bytes, transient };
+}
+
+void ResourceRegistry::Release(ResourceType type, uintptr_t id)
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	records.erase(std::make_pair(type, id));
+}
+
+void ResourceRegistry::SetTransient(ResourceType type, uintptr_t id, bool transient)
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	auto found = records.find(std::make_pair(type, id));
+	if (found != records.end()) {
+		found->second.transient = transient;
+	}
+}
+
+size_t ResourceRegistry::GetTotalBytes(ResourceType type) const
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	return totalBytes(type);
+}
+
+size_t ResourceRegistry::GetGpuBytes() const
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	return gpuBytes();
+}
+
+size_t ResourceRegistry::GetTransientBytes() const
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	return transientBytes();
+}
+
+size_t ResourceRegistry::totalBytes(ResourceType type) const
+{
+	size_t total = 0;
+	for (const auto& record : records) {
+		if (record.first.first == type) {
+			total += record.second.bytes;
+		}
+	}
+	return total;
+}
+
+size_t ResourceRegistry::gpuBytes() const
+{
+	return totalBytes(RESOURCE_TEXTURE) + totalBytes(RESOURCE_RENDERBUFFER) + totalBytes(RESOURCE_BUFFER);
+}
+
+size_t ResourceRegistry::transientBytes() const
+{
+	size_t total = 0;
+	for (const auto& record : records) {
+		if (record.second.transient) {
+			total += record.second.bytes;
+		}
+	}
+	return total;
+}
+
+void ResourceRegistry::PrintReport(std::ostream& out) const
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	std::vector<std::pair<std::pair<ResourceType, uintptr_t>, ResourceRecord>> sorted(records.begin(), records.end());
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+		return a.second.bytes > b.second.bytes;
+	});
+
+	std::ios_base::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(2);
+	out << "Memory: GPU " << megabytes(gpuBytes()) << " MB, CPU " << megabytes(totalBytes(RESOURCE_CPU))
+		<< " MB, transient " << megabytes(transientBytes()) << " MB" << std::endl;
+	for (ResourceType type : { RESOURCE_TEXTURE, RESOURCE_RENDERBUFFER, RESOURCE_BUFFER, RESOURCE_CPU }) {
+		out << "  " << std::left << std::setw(13) << typeName(type) << std::right << std::setw(10) << megabytes(totalBytes(type)) << " MB" << std::endl;
+	}
+	for (const auto& record : sorted) {
+		out << "  " << std::setw(10) << megabytes(record.second.bytes) << " MB  " << std::left << std::setw(13)
+			<< typeName(record.first.first) << std::right << record.second.name
+			<< (record.second.transient ? " (transient)" : "") << std::endl;
+	}
+	out.flags(flags);
+}
+
+void ResourceRegistry::WriteJson(const std::string& path) const
+{
+	std::lock_guard<std::mutex> lock(recordsMutex);
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		std::cerr << "ResourceRegistry: unable to open " << path << std::endl;
+		return;
+	}
+	file << "{\n\"gpuBytes\": " << gpuBytes() << ",\n\"cpuBytes\": " << totalBytes(RESOURCE_CPU)
+		<< ",\n\"transientBytes\": " << transientBytes() << ",\n\"resources\": [\n";
+	size_t i = 0;
+	for (const auto& record : records) {
+		file << "  {\"type\": \"" << typeName(record.first.first) << "\", \"name\": \"" << EscapeJson(record.second.name)
+			<< "\", \"bytes\": " << record.second.bytes << ", \"transient\": " << (record.second.transient ? "true" : "false") << "}"
+			<< (++i < records.size() ? ",\n" : "\n");
+	}
+	file << "]\n}\n";
+	std::cout << "Memory report written to " << path << std::endl;
+}
+
+size_t ResourceRegistry::TextureBytes(GLenum internalFormat, int width, int height, int layers, bool mipmapped)
+{
+	size_t texelBytes;
+	switch (internalFormat) {
+		case GL_R32F: texelBytes = 4; break;
+		case GL_RGB32F: texelBytes = 12; break;
+		case GL_RGBA32F: texelBytes = 16; break;
+		case GL_RGB16F: texelBytes = 6; break;
+		case GL_RGBA16F: texelBytes = 8; break;
+		case GL_RED: texelBytes = 1; break;
+		case GL_RG: texelBytes = 2; break;
+		case GL_RGB: case GL_RGB8: texelBytes = 3; break;
+		case GL_DEPTH_COMPONENT24: case GL_DEPTH24_STENCIL8: texelBytes = 4; break;
+		default: texelBytes = 4; break; // GL_RGBA, GL_RGBA8 and the rest
+	}
+	size_t texels = 0;
+	while (true) {
+		texels += (size_t)width * height;
+		if (!mipmapped || (width == 1 && height == 1)) {
+			break;
+		}
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return texels * texelBytes * layers;
+}
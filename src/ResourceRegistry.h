@@ -0,0 +1,66 @@
+// ResourceRegistry.h
+#ifndef RESOURCE_REGISTRY_H
+#define RESOURCE_REGISTRY_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+
+enum ResourceType
+{
+	RESOURCE_TEXTURE,
+	RESOURCE_RENDERBUFFER,
+	RESOURCE_BUFFER,
+	RESOURCE_CPU, // Pixels, tables and other arrays in system memory
+};
+
+struct ResourceRecord
+{
+	std::string name;
+	size_t bytes;
+	bool transient; // Bake-only input, released once the consumer is done with it
+};
+
+// Byte size of every GPU object and large CPU array that is alive, for the live memory report.
+// The owners record their resources where they allocate them and remove them where they free them:
+// GL objects by type and name (id), CPU arrays by their address. Sizes are what the data needs,
+// drivers may pad or compress. Textures are also created on the frame decoding threads of an
+// environment sequence, so every call takes the lock.
+class ResourceRegistry
+{
+public:
+	static ResourceRegistry* Get();
+
+	// Adds the resource or replaces its record (e.g. a buffer that grew)
+	void Track(ResourceType type, uintptr_t id, const std::string& name, size_t bytes, bool transient = false);
+	void Release(ResourceType type, uintptr_t id);
+	void SetTransient(ResourceType type, uintptr_t id, bool transient);
+
+	size_t GetTotalBytes(ResourceType type) const;
+	size_t GetGpuBytes() const; // Textures, renderbuffers and buffers
+	size_t GetTransientBytes() const;
+
+	// Totals per type and every resource, largest first
+	void PrintReport(std::ostream& out) const;
+	void WriteJson(const std::string& path) const;
+
+	// Bytes of a texture with the given internal format, mip levels included when mipmapped
+	static size_t TextureBytes(GLenum internalFormat, int width, int height, int layers = 1, bool mipmapped = false);
+
+private:
+	ResourceRegistry() {}
+
+	std::map<std::pair<ResourceType, uintptr_t>, ResourceRecord> records;
+	mutable std::mutex recordsMutex;
+
+	// Callers hold recordsMutex
+	size_t totalBytes(ResourceType type) const;
+	size_t gpuBytes() const;
+	size_t transientBytes() const;
+};
+
+#endif
@@ -0,0 +1,131 @@
+// ShaderCache.cpp
+#include "ShaderCache.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	// "SPB1", bumped when the file layout changes
+	const uint32_t SHADER_CACHE_MAGIC = 0x31425053;
+
+	// FNV-1a
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	uint64_t hashString(uint64_t hash, const char* text)
+	{
+		// The terminator separates the strings, so "ab"+"c" and "a"+"bc" differ
+		return hashBytes(hash, text, text != nullptr ? strlen(text) + 1 : 0);
+	}
+
+	std::string cachePath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return std::string(SHADER_CACHE_DIRECTORY) + "/" + name;
+	}
+}
+
+bool IsShaderCacheSupported()
+{
+	static int supported = -1;
+	if (supported < 0) {
+		GLint formatCount = 0;
+		if (GLEW_ARB_get_program_binary) {
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		}
+		supported = formatCount > 0 ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+ShaderCacheStats& GetShaderCacheStats()
+{
+	static ShaderCacheStats stats;
+	return stats;
+}
+
+uint64_t ShaderCacheKey(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+	hash = hashString(hash, vertexSource.c_str());
+	hash = hashString(hash, fragmentSource.c_str());
+	return hash;
+}
+
+bool LoadProgramBinary(GLuint program, uint64_t key)
+{
+	if (!IsShaderCacheSupported()) {
+		return false;
+	}
+	std::ifstream file(cachePath(key), std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	uint32_t magic = 0;
+	GLenum format = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&format, sizeof(format));
+	if (!file.good() || magic != SHADER_CACHE_MAGIC) {
+		return false;
+	}
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (binary.empty()) {
+		return false;
+	}
+
+	// The driver may reject a binary it wrote itself (e.g. after a driver update with the same
+	// version string), the program is compiled from source then
+	glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	while (glGetError() != GL_NO_ERROR) {}
+	return linked == GL_TRUE;
+}
+
+void SaveProgramBinary(GLuint program, uint64_t key)
+{
+	if (!IsShaderCacheSupported()) {
+		return;
+	}
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+	// Written next to the final name and renamed, a reader never sees half a file
+	std::string path = cachePath(key);
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "Shader cache: unable to write " << temporaryPath << std::endl;
+			return;
+		}
+		file.write((const char*)&SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC));
+		file.write((const char*)&format, sizeof(format));
+		file.write(binary.data(), length);
+	}
+	std::filesystem::rename(temporaryPath, path, error);
+}
@@ -0,0 +1,31 @@
+// ShaderCache.h
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "typedefs.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+// Linked program binaries are kept here, relative to the working directory like the other assets
+const char* const SHADER_CACHE_DIRECTORY = "shader_cache";
+
+struct ShaderCacheStats
+{
+	int hits = 0; // Programs loaded with glProgramBinary
+	int misses = 0; // Programs compiled from source
+};
+
+// Hash of the preprocessed sources and the driver (vendor, renderer, version). A driver update
+// changes the key, so stale binaries are never offered to glProgramBinary.
+uint64_t ShaderCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+
+// False when there is no usable binary for the key, the program has to be compiled then
+bool LoadProgramBinary(GLuint program, uint64_t key);
+// Call after a successful link of a program created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+void SaveProgramBinary(GLuint program, uint64_t key);
+
+bool IsShaderCacheSupported();
+ShaderCacheStats& GetShaderCacheStats();
+
+#endif
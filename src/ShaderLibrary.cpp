@@ -0,0 +1,56 @@
+// ShaderLibrary.cpp
+#include "ShaderLibrary.h"
+#include "Profiler.h"
+
+ShaderLibrary* ShaderLibrary::GetShared()
+{
+	// Never deleted, the programs outlive the GL context otherwise
+	static ShaderLibrary* library = new ShaderLibrary();
+	return library;
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	for (auto& entry : programs) {
+		delete entry.second;
+	}
+}
+
+ShaderProgram* ShaderLibrary::Get(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines)
+{
+	std::string key = makeKey(vertexPath, fragmentPath, defines);
+	auto it = programs.find(key);
+	if (it != programs.end()) {
+		return it->second;
+	}
+
+	PROFILE_CPU_SCOPE("CompileShader");
+	ShaderProgram* program = new ShaderProgram(vertexPath.c_str(), fragmentPath.c_str(), defines);
+	programs[key] = program;
+	std::cout << "Compiled shader permutation " << key << std::endl;
+	return program;
+}
+
+ShaderProgram* ShaderLibrary::GetDefault()
+{
+	return Get(DEFAULT_VERTEX_SHADER, DEFAULT_FRAGMENT_SHADER);
+}
+
+int ShaderLibrary::LightCountBucket(int lightCount)
+{
+	int bucket = 1;
+	while (bucket < lightCount && bucket < MAX_LIGHT_COUNT_BUCKET) {
+		bucket *= 2;
+	}
+	return bucket;
+}
+
+// "vertex|fragment|NAME=VALUE;NAME=VALUE;", defines in the order they are given
+std::string ShaderLibrary::makeKey(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines)
+{
+	std::string key = vertexPath + "|" + fragmentPath + "|";
+	for (const auto& define : defines) {
+		key += define.first + "=" + define.second + ";";
+	}
+	return key;
+}
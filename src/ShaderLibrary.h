@@ -0,0 +1,38 @@
+// ShaderLibrary.h
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include "typedefs.h"
+#include "ShaderProgram.h"
+#include <map>
+#include <string>
+
+// Light loops are unrolled up to the bucket, so the light count is rounded up to one of
+// 1, 2, 4 ... MAX_LIGHT_COUNT_BUCKET instead of compiling a program for every count
+const int MAX_LIGHT_COUNT_BUCKET = 128;
+
+const std::string DEFAULT_VERTEX_SHADER = "shaders/lit.vert";
+const std::string DEFAULT_FRAGMENT_SHADER = "shaders/lit.frag";
+
+// Compiled shader permutations, looked up by their source files and defines.
+// A permutation is compiled the first time it is requested and kept until the library is deleted,
+// so switching back and forth between variants only costs a map lookup.
+class ShaderLibrary {
+public:
+	// The library main and GameObject share, so every program is compiled once
+	static ShaderLibrary* GetShared();
+	~ShaderLibrary();
+
+	ShaderProgram* Get(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines = ShaderDefines());
+	// Plain lit program of objects created without one
+	ShaderProgram* GetDefault();
+
+	static int LightCountBucket(int lightCount);
+
+private:
+	std::map<std::string, ShaderProgram*> programs;
+
+	static std::string makeKey(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines);
+};
+
+#endif
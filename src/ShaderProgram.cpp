@@ -1,103 +1,160 @@
 // ShaderProgram.cpp
 #include "ShaderProgram.h"
+#include "Profiler.h"
 
-ShaderProgram* ShaderProgram::getDefaultShader() {
-    const std::string DEFAULT_VERTEX_SHADER = "shaders/lit.vert";
-    const std::string DEFAULT_FRAGMENT_SHADER = "shaders/lit.frag";
-    static ShaderProgram* defaultShader = new ShaderProgram(DEFAULT_VERTEX_SHADER.c_str(), DEFAULT_FRAGMENT_SHADER.c_str());
-    return defaultShader;
+bool ShaderProgram::expandIncludes(const std::string& path, std::string& source, std::vector<std::string>& files) {
+    for (const std::string& file : files) {
+        if (file == path) {
+            return true; // Already included
+        }
+    }
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return false;
+    }
+    int fileIndex = files.size();
+    files.push_back(path);
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+
+    if (fileIndex != 0) {
+        source += "#line 1 " + std::to_string(fileIndex) + "\n";
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+            size_t open = line.find('"', start);
+            size_t close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos) {
+                std::cout << "ERROR::SHADER::INVALID_INCLUDE " << path << ":" << lineNumber << std::endl;
+                return false;
+            }
+            if (!expandIncludes(directory + line.substr(open + 1, close - open - 1), source, files)) {
+                return false;
+            }
+            source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            continue;
+        }
+        source += line + "\n";
+    }
+    return true;
 }
 
-ShaderProgram::ShaderProgram(const char* vertexPath, const char* fragmentPath) {
+bool ShaderProgram::preprocess(const std::string& path, const ShaderDefines& defines, std::string& source, std::vector<std::string>& files) {
+    source.clear();
+    files.clear();
+    if (!expandIncludes(path, source, files)) {
+        return false;
+    }
+
+    // Defines go right after #version, which may follow comments
+    size_t version = source.find("#version");
+    size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version) + 1;
+    int versionLine = std::count(source.begin(), source.begin() + insertAt, '\n');
+    std::string defineLines;
+    for (const auto& define : defines) {
+        defineLines += "#define " + define.first + " " + define.second + "\n";
+    }
+    if (!defineLines.empty()) {
+        defineLines += "#line " + std::to_string(versionLine + 1) + " 0\n";
+        source.insert(insertAt, defineLines);
+    }
+    return true;
+}
+
+ShaderProgram::ShaderProgram(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines) {
     std::string vertexCode;
     std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-
-    // vShaderFile.open(vertexPath);
-    // fShaderFile.open(fragmentPath);
-    // std::stringstream vShaderStream, fShaderStream;
-    // vShaderStream << vShaderFile.rdbuf();
-    // fShaderStream << fShaderFile.rdbuf();
-    // vShaderFile.close();
-    // fShaderFile.close();
-    // vertexCode = vShaderStream.str();
-    // fragmentCode = fShaderStream.str();	
-
-    try {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        vShaderFile.close();
-        fShaderFile.close();
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();	
-    } catch(std::ifstream::failure& e) {
+    std::vector<std::string> vertexFiles, fragmentFiles;
+    if (!preprocess(vertexPath, defines, vertexCode, vertexFiles) || !preprocess(fragmentPath, defines, fragmentCode, fragmentFiles)) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << vertexPath << " " << fragmentPath << std::endl;
-        std::cout << e.what() << std::endl;
         assert(false);
     }
+    // Let the driver compile on as many threads as it likes, the link is only checked on first use
+    static bool parallelCompileEnabled = false;
+    if (!parallelCompileEnabled) {
+        parallelCompileEnabled = true;
+        if (GLEW_KHR_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+    }
+
+    ID = glCreateProgram();
+    cacheKey = ShaderCacheKey(vertexCode, fragmentCode);
+    if (LoadProgramBinary(ID, cacheKey)) {
+        GetShaderCacheStats().hits++;
+        return;
+    }
+    GetShaderCacheStats().misses++;
+
+    // Compiler messages are prefixed with the file index of the #line directives
+    auto describeFiles = [](const std::vector<std::string>& files) {
+        std::string description;
+        for (size_t i = 0; i < files.size(); i++) {
+            description += " " + std::to_string(i) + ":" + files[i];
+        }
+        return description;
+    };
+    vertexDescription = "VERTEX" + describeFiles(vertexFiles);
+    fragmentDescription = "FRAGMENT" + describeFiles(fragmentFiles);
+
     const char* vShaderCode = vertexCode.c_str();
     const char * fShaderCode = fragmentCode.c_str();
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
+    pendingVertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pendingVertex, 1, &vShaderCode, NULL);
+    glCompileShader(pendingVertex);
+    pendingFragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pendingFragment, 1, &fShaderCode, NULL);
+    glCompileShader(pendingFragment);
+    glAttachShader(ID, pendingVertex);
+    glAttachShader(ID, pendingFragment);
+    if (IsShaderCacheSupported()) {
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-
-    // Clear memory
-    vertexCode.clear();
-    fragmentCode.clear();
+    linkPending = true;
 
     assert(glGetError() == GL_NO_ERROR);
 }
 
-void ShaderProgram::AddGeometryShader(const char* geometryPath) {
-    std::string geometryCode;
-    std::ifstream gShaderFile;
-    gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        gShaderFile.open(geometryPath);
-        std::stringstream gShaderStream;
-        gShaderStream << gShaderFile.rdbuf();
-        gShaderFile.close();
-        geometryCode = gShaderStream.str();
-    } catch(std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        assert(false);
-    }
-    const char* gShaderCode = geometryCode.c_str();
-    unsigned int geometry;
-    int success;
-    char infoLog[512];
-    geometry = glCreateShader(GL_GEOMETRY_SHADER);
-    glShaderSource(geometry, 1, &gShaderCode, NULL);
-    glCompileShader(geometry);
-    checkCompileErrors(geometry, "GEOMETRY");
-    glAttachShader(ID, geometry);
-    glLinkProgram(ID);
+ShaderProgram::~ShaderProgram() {
+    glDeleteShader(pendingVertex);
+    glDeleteShader(pendingFragment);
+    glDeleteProgram(ID);
+}
+
+void ShaderProgram::finishLink() {
+    PROFILE_CPU_SCOPE("FinishShaderLink");
+
+    // Blocks until the driver is done with the compile and link
+    checkCompileErrors(pendingVertex, vertexDescription);
+    checkCompileErrors(pendingFragment, fragmentDescription);
     checkCompileErrors(ID, "PROGRAM");
-    glDeleteShader(geometry);
+    glDetachShader(ID, pendingVertex);
+    glDetachShader(ID, pendingFragment);
+    glDeleteShader(pendingVertex);
+    glDeleteShader(pendingFragment);
+    pendingVertex = pendingFragment = 0;
+    linkPending = false;
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+    if (linked == GL_TRUE) {
+        SaveProgramBinary(ID, cacheKey);
+    }
+    assert(glGetError() == GL_NO_ERROR);
 }
 
 void ShaderProgram::use() {
+    if (linkPending) {
+        finishLink();
+    }
     glUseProgram(ID);
 }
 void ShaderProgram::unuse() { 
@@ -8,16 +8,28 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <utility>
+#include <algorithm>
 
 #include "typedefs.h"
 #include "printExtensions.h"
+#include "ShaderCache.h"
+
+// (name, value) pairs, injected as #define lines right after #version
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
 
 class ShaderProgram {
 public:
-    static ShaderProgram* getDefaultShader();
-    // Constructor reads and builds the shader
-    ShaderProgram(const char* vertexPath, const char* fragmentPath);
-    void AddGeometryShader(const char* geometryPath);
+    // Reads the file and expands #include "path" (relative to the including file, every file at most once).
+    // #line directives number the files in the order of the files vector for the compiler messages.
+    static bool preprocess(const std::string& path, const ShaderDefines& defines, std::string& source, std::vector<std::string>& files);
+
+    // Constructor reads the shader and loads it from the program binary cache, or issues the compile
+    // and link without waiting for them. The errors are checked by the first use(), until then the
+    // driver is free to compile in the background (KHR_parallel_shader_compile).
+    ShaderProgram(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines());
+    ~ShaderProgram();
     // Use/activate the shader
     void use();
     void unuse();
@@ -51,6 +63,14 @@ public:
 
 private:
     unsigned int ID;
+    // Set while the link result has not been checked yet
+    bool linkPending = false;
+    GLuint pendingVertex = 0, pendingFragment = 0;
+    std::string vertexDescription, fragmentDescription;
+    uint64_t cacheKey = 0;
+
+    void finishLink();
+    static bool expandIncludes(const std::string& path, std::string& source, std::vector<std::string>& files);
     void checkCompileErrors(GLuint shader, std::string type);
     int getUniformLocation(const std::string &name) const;
 };
@@ -0,0 +1,156 @@
+// Simulation.cpp
+#include "Simulation.h"
+#include <glm/gtc/quaternion.hpp>
+
+namespace
+{
+	// std::atomic<float>::fetch_add is C++20
+	void atomicAdd(std::atomic<float>& value, float delta)
+	{
+		float expected = value.load(std::memory_order_relaxed);
+		while (!value.compare_exchange_weak(expected, expected + delta, std::memory_order_relaxed)) {
+		}
+	}
+
+	// Moves the position on a sphere centered around the origin
+	Vector3 orbit(const Vector3& position, float yaw, float pitch)
+	{
+		float radius = glm::length(position);
+		float theta = atan2(position.z, position.x) + yaw;
+		float phi = acos(position.y / radius) + pitch;
+		phi = glm::clamp(phi, SIMULATION_MIN_PITCH, glm::pi<float>() - SIMULATION_MIN_PITCH);
+
+		return Vector3(radius * sin(phi) * cos(theta), radius * cos(phi), radius * sin(phi) * sin(theta));
+	}
+
+	SimulationSnapshot initialSnapshot(const SimulationState& state)
+	{
+		SimulationSnapshot snapshot;
+		snapshot.previous = state;
+		snapshot.current = state;
+		snapshot.tickTime = std::chrono::steady_clock::now();
+		return snapshot;
+	}
+}
+
+Simulation::Simulation(const SimulationState& initialState)
+	: state(initialState), snapshots(initialSnapshot(initialState))
+{
+}
+
+Simulation::~Simulation()
+{
+	Stop();
+}
+
+void Simulation::Start()
+{
+	if (running.exchange(true)) {
+		return;
+	}
+	thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::Stop()
+{
+	if (!running.exchange(false)) {
+		return;
+	}
+	thread.join();
+}
+
+void Simulation::SetRotationDirection(int direction)
+{
+	rotationDirection.store(direction, std::memory_order_relaxed);
+}
+
+void Simulation::AddCameraRotation(float yaw, float pitch)
+{
+	atomicAdd(pendingYaw, yaw);
+	atomicAdd(pendingPitch, pitch);
+}
+
+void Simulation::SetEnvironmentRotationDirection(int direction)
+{
+	environmentRotationDirection.store(direction, std::memory_order_relaxed);
+}
+
+void Simulation::run()
+{
+	const std::chrono::nanoseconds tickDuration(1000000000 / SIMULATION_TICK_RATE);
+	const float deltaTime = 1.0f / SIMULATION_TICK_RATE;
+
+	long long tickIndex = 0;
+	auto nextTick = std::chrono::steady_clock::now();
+	while (running.load(std::memory_order_relaxed)) {
+		SimulationState previous = state;
+		tick(deltaTime);
+		tickIndex++;
+
+		SimulationSnapshot& snapshot = snapshots.GetWriteBuffer();
+		snapshot.previous = previous;
+		snapshot.current = state;
+		snapshot.tickTime = std::chrono::steady_clock::now();
+		snapshot.tick = tickIndex;
+		snapshots.Publish();
+
+		// Fixed rate, a late tick is not followed by a burst of catch-up ticks
+		nextTick += tickDuration;
+		auto now = std::chrono::steady_clock::now();
+		if (nextTick < now) {
+			nextTick = now;
+		}
+		std::this_thread::sleep_until(nextTick);
+	}
+}
+
+void Simulation::tick(float deltaTime)
+{
+	float yaw = pendingYaw.exchange(0.0f, std::memory_order_relaxed);
+	float pitch = pendingPitch.exchange(0.0f, std::memory_order_relaxed);
+
+	// Keyboard orbit rotates the sphere along with the camera
+	int direction = rotationDirection.load(std::memory_order_relaxed);
+	if (direction != 0) {
+		float angle = SIMULATION_ORBIT_SPEED * deltaTime * direction;
+		yaw += angle;
+		state.sphereRotation = glm::rotate(state.sphereRotation, angle, Vector3(0.0f, 1.0f, 0.0f));
+	}
+
+	if (yaw != 0.0f || pitch != 0.0f) {
+		state.cameraPosition = orbit(state.cameraPosition, yaw, pitch);
+	}
+
+	// Wrapped to [-pi, pi], GetInterpolatedState takes the short way across the wrap
+	int environmentDirection = environmentRotationDirection.load(std::memory_order_relaxed);
+	if (environmentDirection != 0) {
+		float environmentYaw = state.environmentYaw + SIMULATION_ENVIRONMENT_SPEED * deltaTime * environmentDirection;
+		state.environmentYaw = atan2(sin(environmentYaw), cos(environmentYaw));
+	}
+}
+
+SimulationState Simulation::GetInterpolatedState()
+{
+	snapshots.Update();
+	const SimulationSnapshot& snapshot = snapshots.GetReadBuffer();
+
+	// Show the previous -> current step over the tick that follows it
+	float tickSeconds = 1.0f / SIMULATION_TICK_RATE;
+	float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.tickTime).count();
+	float alpha = glm::clamp(elapsed / tickSeconds, 0.0f, 1.0f);
+
+	// Interpolate along the orbit, a straight line would pull the camera inwards
+	const SimulationState& from = snapshot.previous;
+	const SimulationState& to = snapshot.current;
+	SimulationState interpolated;
+	float radius = glm::mix(glm::length(from.cameraPosition), glm::length(to.cameraPosition), alpha);
+	interpolated.cameraPosition = glm::normalize(glm::mix(from.cameraPosition, to.cameraPosition, alpha)) * radius;
+	// slerp between equal rotations is not exact, a sphere at rest would count as moved every frame
+	interpolated.sphereRotation = from.sphereRotation == to.sphereRotation ? to.sphereRotation
+		: glm::slerp(from.sphereRotation, to.sphereRotation, alpha);
+	// Shortest way round, the step across the wrap is a tiny negative one
+	float environmentStep = to.environmentYaw - from.environmentYaw;
+	environmentStep = atan2(sin(environmentStep), cos(environmentStep));
+	interpolated.environmentYaw = from.environmentYaw + environmentStep * alpha;
+	return interpolated;
+}
@@ -0,0 +1,69 @@
+// Simulation.h
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "typedefs.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+const int SIMULATION_TICK_RATE = 120; // Ticks per second
+const float SIMULATION_ORBIT_SPEED = 0.6f; // Radians per second while A or D is held
+const float SIMULATION_MIN_PITCH = 0.1f; // Keeps the orbit away from the poles
+const float SIMULATION_ENVIRONMENT_SPEED = 0.3f; // Radians per second while Z or X is held
+
+// Everything the simulation owns, the render thread only sees copies
+struct SimulationState
+{
+	Vector3 cameraPosition = Vector3(0.0f, 0.0f, 5.0f);
+	Quaternion sphereRotation = Quaternion(1.0f, 0.0f, 0.0f, 0.0f);
+	float environmentYaw = 0.0f; // Turntable rotation of the environment around +Y, radians
+};
+
+// Immutable once published: the last two ticks, so the renderer can interpolate between them
+struct SimulationSnapshot
+{
+	SimulationState previous;
+	SimulationState current;
+	std::chrono::steady_clock::time_point tickTime; // When current was simulated
+	long long tick = 0;
+};
+
+// Runs the camera orbit and object transforms on its own thread at SIMULATION_TICK_RATE,
+// independent of the frame rate. Input arrives through atomics, snapshots leave through a
+// TripleBuffer, so the simulation and the render thread never block each other.
+// The Profiler is not thread safe, so ticks are not profiled.
+class Simulation {
+public:
+	Simulation(const SimulationState& initialState);
+	~Simulation();
+
+	void Start();
+	void Stop();
+
+	// Input, callable from any thread
+	void SetRotationDirection(int direction); // -1 left, 0 none, 1 right
+	void AddCameraRotation(float yaw, float pitch); // Radians, applied on the next tick
+	void SetEnvironmentRotationDirection(int direction); // -1, 0 or 1
+
+	// Render thread: the state one tick behind the simulation, interpolated to the current time
+	SimulationState GetInterpolatedState();
+
+private:
+	std::thread thread;
+	std::atomic<bool> running { false };
+
+	std::atomic<int> rotationDirection { 0 };
+	std::atomic<int> environmentRotationDirection { 0 };
+	std::atomic<float> pendingYaw { 0.0f };
+	std::atomic<float> pendingPitch { 0.0f };
+
+	SimulationState state; // Simulation thread only
+	TripleBuffer<SimulationSnapshot> snapshots;
+
+	void run();
+	void tick(float deltaTime);
+};
+
+#endif
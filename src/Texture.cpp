@@ -1,18 +1,26 @@
 #include "Texture.h"    
+#include "ResourceRegistry.h"
+#include <algorithm>
 
-Texture* Texture::CreateCubemap(GLuint width, GLuint height) {
+// The one stb_image implementation of the program, the tools and the benchmarks link it too
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+Texture* Texture::CreateCubemap(GLuint width, GLuint height, GLenum internalFormat) {
     Texture* texture = new Texture();
     texture->width = width;
     texture->height = height;
     texture->target = GL_TEXTURE_CUBE_MAP;
     texture->format = GL_RGB;
+    texture->internalFormat = internalFormat;
+    texture->name = "cubemap";
 
     glGenTextures(1, &texture->id);
     texture->setTextureUnit(0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, texture->id);
     for (int i = 0; i < 6; i++) {
         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                     0, GL_RGB32F, width, height, 
+                     0, internalFormat, width, height, 
                      0, GL_RGBA, GL_FLOAT, nullptr);
     }
 
@@ -22,28 +30,63 @@ Texture* Texture::CreateCubemap(GLuint width, GLuint height) {
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+    texture->trackMemory();
+    return texture;
+}
+
+Texture* Texture::CreateRenderTexture(GLuint width, GLuint height, GLenum internalFormat) {
+    Texture* texture = new Texture();
+    texture->width = width;
+    texture->height = height;
+    texture->target = GL_TEXTURE_2D;
+    texture->format = GL_RGBA;
+    texture->channels = 4;
+    texture->internalFormat = internalFormat;
+    texture->name = "render texture";
+
+    glGenTextures(1, &texture->id);
+    texture->setTextureUnit(0);
+    glBindTexture(GL_TEXTURE_2D, texture->id);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    texture->trackMemory();
     return texture;
 }
 
 Texture::Texture() 
-    : id(0), width(0), height(0), channels(0) 
+    : id(0), width(0), height(0), channels(0), hdriData(nullptr), data(nullptr),
+      internalFormat(GL_RGBA8), mipmapped(false), transient(false)
 {
 }
 
-Texture::Texture(const std::string& path, bool isHDR)
-    : id(0), width(0), height(0), channels(0)
+Texture::Texture(const std::string& path, bool isHDR, bool upload)
+    : id(0), width(0), height(0), channels(0), hdriData(nullptr), data(nullptr),
+      internalFormat(GL_RGBA8), mipmapped(false), transient(false)
 {
     if (isHDR) {
-        loadHDR(path);
+        loadHDR(path, upload);
     }
     else {
-        load(path);
+        load(path, upload);
+    }
+    target = GL_TEXTURE_2D;
+    current_unit = 0;
+    name = path;
+    mipmapped = upload;
+    trackMemory();
+    if (!upload) {
+        // CPU side pixels only, no GL context needed
+        return;
     }
     assert(id != 0);
     assert(glGetError() == GL_NO_ERROR);
 
-    target = GL_TEXTURE_2D;
-    current_unit = 0;
     setWrap(GL_REPEAT);
     // Set filtering parameters
     glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -54,13 +97,35 @@ Texture::Texture(const std::string& path, bool isHDR)
     unbind();
 }
 
+Texture::Texture(GLuint width, GLuint height, GLuint channels, const float* pixels)
+    : id(0), width(width), height(height), channels(channels), hdriData(nullptr), data(nullptr),
+      name("pixels"), internalFormat(GL_RGBA8), mipmapped(false), transient(false)
+{
+    target = GL_TEXTURE_2D;
+    format = channels == 4 ? GL_RGBA : GL_RGB;
+    current_unit = 0;
+    hdriData = new float[width * height * channels];
+    std::copy(pixels, pixels + width * height * channels, hdriData);
+    trackMemory();
+}
+
 Texture::~Texture() {
-    glDeleteTextures(1, &id);
+    releaseGLTexture();
+    if (hdriData != nullptr) {
+        ResourceRegistry::Get()->Release(RESOURCE_CPU, (uintptr_t)hdriData);
+    }
+    if (data != nullptr) {
+        ResourceRegistry::Get()->Release(RESOURCE_CPU, (uintptr_t)data);
+    }
+    delete[] hdriData;
+    delete[] data;
 }
 
-void Texture::load(const std::string& path) {
-    glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
+void Texture::load(const std::string& path, bool upload) {
+    if (upload) {
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+    }
 
     stbi_set_flip_vertically_on_load(true);
     int width, height, channels;
@@ -87,8 +152,11 @@ void Texture::load(const std::string& path) {
             std::cout << "Unsupported number of channels: " << channels << std::endl;
         }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        if (upload) {
+            internalFormat = format;
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
     }
     else {
         std::cout << "Failed to load texture: " << path << std::endl;
@@ -102,9 +170,11 @@ void Texture::load(const std::string& path) {
     stbi_image_free(data);
 }
 
-void Texture::loadHDR(const std::string& path) {
-    glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_2D, id);
+void Texture::loadHDR(const std::string& path, bool upload) {
+    if (upload) {
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+    }
 
     int width, height, channels;
     float* data = stbi_loadf(path.c_str(), &width, &height, &channels, 0);
@@ -130,9 +200,12 @@ void Texture::loadHDR(const std::string& path) {
             std::cout << "Unsupported number of channels: " << channels << std::endl;
         }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, format, GL_FLOAT, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        assert(glGetError() == GL_NO_ERROR);
+        if (upload) {
+            internalFormat = GL_RGB32F;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, format, GL_FLOAT, data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            assert(glGetError() == GL_NO_ERROR);
+        }
     }
     else {
         std::cout << "Failed to load texture: " << path << std::endl;
@@ -146,6 +219,62 @@ void Texture::loadHDR(const std::string& path) {
     stbi_image_free(data);
 }
 
+void Texture::uploadHDR(const float* pixels) {
+    assert(id != 0 && target == GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_FLOAT, pixels);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    assert(glGetError() == GL_NO_ERROR);
+}
+
+void Texture::generateMipmap() {
+    assert(id != 0);
+    glBindTexture(target, id);
+    glGenerateMipmap(target);
+    glBindTexture(target, 0);
+    if (!mipmapped) {
+        mipmapped = true;
+        trackMemory();
+    }
+}
+
+void Texture::setName(const std::string& name) {
+    this->name = name;
+    trackMemory();
+}
+
+void Texture::setTransient(bool transient) {
+    this->transient = transient;
+    if (id != 0) {
+        ResourceRegistry::Get()->SetTransient(RESOURCE_TEXTURE, id, transient);
+    }
+}
+
+void Texture::releaseGLTexture() {
+    if (id != 0) {
+        ResourceRegistry::Get()->Release(RESOURCE_TEXTURE, id);
+        glDeleteTextures(1, &id);
+        id = 0;
+    }
+}
+
+void Texture::trackMemory() {
+    std::string size = " " + std::to_string(width) + "x" + std::to_string(height);
+    if (id != 0) {
+        int layers = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+        size_t bytes = ResourceRegistry::TextureBytes(internalFormat, width, height, layers, mipmapped);
+        ResourceRegistry::Get()->Track(RESOURCE_TEXTURE, id, name + size, bytes, transient);
+    }
+    size_t pixels = (size_t)width * height * channels;
+    if (hdriData != nullptr) {
+        ResourceRegistry::Get()->Track(RESOURCE_CPU, (uintptr_t)hdriData, name + size + " HDR pixels", pixels * sizeof(float));
+    }
+    if (data != nullptr) {
+        ResourceRegistry::Get()->Track(RESOURCE_CPU, (uintptr_t)data, name + size + " pixels", pixels);
+    }
+}
+
 void Texture::bind() {
     glBindTexture(target, id);
 }
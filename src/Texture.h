@@ -9,23 +9,40 @@
 #include <vector>
 #include <string>
 
-#include "stb_image.h"
-
 class Texture {
 public:
-    static Texture* CreateCubemap(GLuint width, GLuint height);
+    static Texture* CreateCubemap(GLuint width, GLuint height, GLenum internalFormat = GL_RGB32F);
+    // Empty 2D texture to render into, without mipmaps, nearest filtering and clamped to the edge
+    static Texture* CreateRenderTexture(GLuint width, GLuint height, GLenum internalFormat);
 
     Texture();
-    Texture(const std::string& path, bool isHDR);
+    // upload = false only decodes the pixels for CPU side use (getPixel), without a GL texture
+    Texture(const std::string& path, bool isHDR, bool upload = true);
+    // CPU side HDR pixels (e.g. generated ones), copied, no GL texture
+    Texture(GLuint width, GLuint height, GLuint channels, const float* pixels);
     ~Texture();
 
     void bind();
     void unbind();
     void setTextureUnit(GLuint unit);
     void setWrap(GLenum wrap);
+    // Replaces the pixels of the uploaded HDR texture with ones of the same size and channels,
+    // then rebuilds the mipmaps. The CPU side copy is left as it was.
+    void uploadHDR(const float* pixels);
+    // Rebuilds the mipmaps of the GL texture from its level 0
+    void generateMipmap();
+
+    // Name in the memory report (ResourceRegistry), loaded textures go by their path
+    void setName(const std::string& name);
+    // Transient textures are only inputs of a bake, the baking class releases their GL texture once done
+    void setTransient(bool transient);
+    bool isTransient() const { return transient; }
+    // Deletes the GL texture, the CPU side pixels stay for getPixel
+    void releaseGLTexture();
 
     Vector3 getPixel(GLuint x, GLuint y);
     Vector3 getMaximumPixel();
+    const float* getHDRData() const { return hdriData; }
 
     GLuint getID() const { return id; }
     GLuint getWidth() const { return width; }
@@ -47,8 +64,15 @@ private:
     float* hdriData; // HDR data
     unsigned char* data; // LDR data
 
-    void load(const std::string& path);
-    void loadHDR(const std::string& path);
+    // Memory report
+    std::string name;
+    GLenum internalFormat; // Of the GL texture
+    bool mipmapped;
+    bool transient;
+
+    void load(const std::string& path, bool upload);
+    void loadHDR(const std::string& path, bool upload);
+    void trackMemory(); // Records the GL texture and the CPU side pixels in the ResourceRegistry
 };
 
 
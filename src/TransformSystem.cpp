@@ -0,0 +1,290 @@
+// TransformSystem.cpp
+#include "TransformSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+TransformSystem* TransformSystem::Get()
+{
+	static TransformSystem system;
+	return &system;
+}
+
+TransformHandle TransformSystem::Create(TransformHandle parent)
+{
+	if (freeHandles.empty()) {
+		grow();
+	}
+	TransformHandle handle = freeHandles.back();
+	freeHandles.pop_back();
+	count++;
+
+	parents[handle] = INVALID_TRANSFORM;
+	SetPosition(handle, Vector3(0.0f));
+	SetRotation(handle, Quaternion(1.0f, 0.0f, 0.0f, 0.0f));
+	SetScale(handle, Vector3(1.0f));
+	SetParent(handle, parent);
+	return handle;
+}
+
+void TransformSystem::Destroy(TransformHandle handle)
+{
+	assert(handle >= 0 && handle < (int)parents.size());
+	SetParent(handle, INVALID_TRANSFORM);
+	std::vector<TransformHandle> orphans;
+	for (TransformHandle child : children) {
+		if (parents[child] == handle) {
+			orphans.push_back(child);
+		}
+	}
+	for (TransformHandle orphan : orphans) {
+		SetParent(orphan, INVALID_TRANSFORM);
+	}
+	dirty[handle / TRANSFORM_BLOCK_SIZE] &= ~(1ULL << (handle % TRANSFORM_BLOCK_SIZE));
+	freeHandles.push_back(handle);
+	count--;
+}
+
+// Adds a block of free handles, the arrays always hold whole blocks
+void TransformSystem::grow()
+{
+	size_t oldCapacity = parents.size();
+	size_t newCapacity = std::max<size_t>(TRANSFORM_BLOCK_SIZE, oldCapacity * 2);
+
+	blocks.resize(newCapacity / TRANSFORM_BLOCK_SIZE, TransformBlock());
+	parents.resize(newCapacity, INVALID_TRANSFORM);
+	instances.resize(newCapacity, InstanceTransform{ Matrix4(1.0f), { Vector4(1, 0, 0, 0), Vector4(0, 1, 0, 0), Vector4(0, 0, 1, 0) } });
+	dirty.resize(newCapacity / TRANSFORM_BLOCK_SIZE, 0);
+	changed.resize(newCapacity / TRANSFORM_BLOCK_SIZE, 0);
+
+	// Lowest handles are handed out first
+	for (size_t handle = newCapacity; handle-- > oldCapacity;) {
+		freeHandles.push_back((TransformHandle)handle);
+	}
+}
+
+void TransformSystem::markDirty(TransformHandle handle)
+{
+	dirty[handle / TRANSFORM_BLOCK_SIZE] |= 1ULL << (handle % TRANSFORM_BLOCK_SIZE);
+	anyDirty = true;
+}
+
+void TransformSystem::SetPosition(TransformHandle handle, const Vector3& position)
+{
+	// Storing the same value again keeps the transform clean, a static scene never counts as moved
+	if (GetPosition(handle) == position) {
+		return;
+	}
+	TransformBlock& block = blocks[handle / TRANSFORM_BLOCK_SIZE];
+	int lane = handle % TRANSFORM_BLOCK_SIZE;
+	block.position[0][lane] = position.x;
+	block.position[1][lane] = position.y;
+	block.position[2][lane] = position.z;
+	markDirty(handle);
+}
+
+void TransformSystem::SetRotation(TransformHandle handle, const Quaternion& rotation)
+{
+	if (GetRotation(handle) == rotation) {
+		return;
+	}
+	TransformBlock& block = blocks[handle / TRANSFORM_BLOCK_SIZE];
+	int lane = handle % TRANSFORM_BLOCK_SIZE;
+	block.rotation[0][lane] = rotation.x;
+	block.rotation[1][lane] = rotation.y;
+	block.rotation[2][lane] = rotation.z;
+	block.rotation[3][lane] = rotation.w;
+	markDirty(handle);
+}
+
+void TransformSystem::SetScale(TransformHandle handle, const Vector3& scale)
+{
+	if (GetScale(handle) == scale) {
+		return;
+	}
+	TransformBlock& block = blocks[handle / TRANSFORM_BLOCK_SIZE];
+	int lane = handle % TRANSFORM_BLOCK_SIZE;
+	block.scale[0][lane] = scale.x;
+	block.scale[1][lane] = scale.y;
+	block.scale[2][lane] = scale.z;
+	markDirty(handle);
+}
+
+void TransformSystem::SetParent(TransformHandle handle, TransformHandle parent)
+{
+	if (parents[handle] == parent) {
+		return;
+	}
+	// A transform can not end up below itself
+	for (TransformHandle ancestor = parent; ancestor != INVALID_TRANSFORM; ancestor = parents[ancestor]) {
+		assert(ancestor != handle);
+	}
+
+	if (parents[handle] != INVALID_TRANSFORM) {
+		children.erase(std::remove(children.begin(), children.end(), handle), children.end());
+	}
+	if (parent != INVALID_TRANSFORM) {
+		children.push_back(handle);
+	}
+	parents[handle] = parent;
+	hierarchyDirty = true;
+	markDirty(handle);
+}
+
+Vector3 TransformSystem::GetPosition(TransformHandle handle) const
+{
+	const TransformBlock& block = blocks[handle / TRANSFORM_BLOCK_SIZE];
+	int lane = handle % TRANSFORM_BLOCK_SIZE;
+	return Vector3(block.position[0][lane], block.position[1][lane], block.position[2][lane]);
+}
+
+Quaternion TransformSystem::GetRotation(TransformHandle handle) const
+{
+	const TransformBlock& block = blocks[handle / TRANSFORM_BLOCK_SIZE];
+	int lane = handle % TRANSFORM_BLOCK_SIZE;
+	return Quaternion(block.rotation[3][lane], block.rotation[0][lane], block.rotation[1][lane], block.rotation[2][lane]);
+}
+
+Vector3 TransformSystem::GetScale(TransformHandle handle) const
+{
+	const TransformBlock& block = blocks[handle / TRANSFORM_BLOCK_SIZE];
+	int lane = handle % TRANSFORM_BLOCK_SIZE;
+	return Vector3(block.scale[0][lane], block.scale[1][lane], block.scale[2][lane]);
+}
+
+// Parents have to be composed before their children, so children are ordered by depth
+void TransformSystem::sortChildren()
+{
+	hierarchyDirty = false;
+	std::vector<std::pair<int, TransformHandle>> depths;
+	depths.reserve(children.size());
+	for (TransformHandle child : children) {
+		int depth = 0;
+		for (TransformHandle ancestor = parents[child]; ancestor != INVALID_TRANSFORM; ancestor = parents[ancestor]) {
+			depth++;
+		}
+		depths.emplace_back(depth, child);
+	}
+	std::sort(depths.begin(), depths.end());
+	for (size_t i = 0; i < depths.size(); i++) {
+		children[i] = depths[i].second;
+	}
+}
+
+// Every lane of the block is computed, free or clean ones included. No branches and no
+// gathers, so the loop becomes straight SIMD code.
+void TransformSystem::updateLocalBlock(TransformBlock& block)
+{
+	// The translation column is the position
+	memcpy(block.affine[3], block.position[0], sizeof(block.position[0]));
+	memcpy(block.affine[7], block.position[1], sizeof(block.position[1]));
+	memcpy(block.affine[11], block.position[2], sizeof(block.position[2]));
+
+	for (int i = 0; i < TRANSFORM_BLOCK_SIZE; i++) {
+		float x = block.rotation[0][i], y = block.rotation[1][i], z = block.rotation[2][i], w = block.rotation[3][i];
+		float sx = block.scale[0][i], sy = block.scale[1][i], sz = block.scale[2][i];
+		float xx = x * x, yy = y * y, zz = z * z;
+		float xy = x * y, xz = x * z, yz = y * z;
+		float wx = w * x, wy = w * y, wz = w * z;
+
+		// Rotation matrix, row major (same as glm::mat4_cast)
+		float r00 = 1.0f - 2.0f * (yy + zz), r01 = 2.0f * (xy - wz), r02 = 2.0f * (xz + wy);
+		float r10 = 2.0f * (xy + wz), r11 = 1.0f - 2.0f * (xx + zz), r12 = 2.0f * (yz - wx);
+		float r20 = 2.0f * (xz - wy), r21 = 2.0f * (yz + wx), r22 = 1.0f - 2.0f * (xx + yy);
+
+		// scale * rotate, the rows are scaled
+		float (&a)[12][TRANSFORM_BLOCK_SIZE] = block.affine;
+		a[0][i] = sx * r00; a[1][i] = sx * r01; a[2][i] = sx * r02;
+		a[4][i] = sy * r10; a[5][i] = sy * r11; a[6][i] = sy * r12;
+		a[8][i] = sz * r20; a[9][i] = sz * r21; a[10][i] = sz * r22;
+
+		// (scale * rotate)^-T = scale^-1 * rotate. A zero scale has no inverse here either, just like
+		// inverse(model) in the shader had none; guarding it would keep the loop from vectorizing.
+		float ix = 1.0f / sx;
+		float iy = 1.0f / sy;
+		float iz = 1.0f / sz;
+		float (&n)[9][TRANSFORM_BLOCK_SIZE] = block.normal;
+		n[0][i] = ix * r00; n[1][i] = ix * r01; n[2][i] = ix * r02;
+		n[3][i] = iy * r10; n[4][i] = iy * r11; n[5][i] = iy * r12;
+		n[6][i] = iz * r20; n[7][i] = iz * r21; n[8][i] = iz * r22;
+	}
+}
+
+void TransformSystem::Update()
+{
+	PROFILE_CPU_SCOPE("UpdateTransforms");
+
+	if (!anyDirty) {
+		// Nothing moved, only the flags of the last Update need clearing, and only once
+		if (anyChanged) {
+			std::fill(changed.begin(), changed.end(), 0);
+			anyChanged = false;
+		}
+		return;
+	}
+	anyDirty = false;
+	anyChanged = true;
+	if (hierarchyDirty) {
+		sortChildren();
+	}
+
+	// Local matrices of every block with a dirty transform
+	for (size_t block = 0; block < dirty.size(); block++) {
+		if (dirty[block] != 0) {
+			updateLocalBlock(blocks[block]);
+		}
+	}
+
+	auto localMatrix = [this](TransformHandle h) {
+		const float (&a)[12][TRANSFORM_BLOCK_SIZE] = blocks[h / TRANSFORM_BLOCK_SIZE].affine;
+		int i = h % TRANSFORM_BLOCK_SIZE;
+		// glm is column major, [column][row]
+		return Matrix4(
+			a[0][i], a[4][i], a[8][i], 0.0f,
+			a[1][i], a[5][i], a[9][i], 0.0f,
+			a[2][i], a[6][i], a[10][i], 0.0f,
+			a[3][i], a[7][i], a[11][i], 1.0f);
+	};
+	auto localNormalColumn = [this](TransformHandle h, int column) {
+		const float (&n)[9][TRANSFORM_BLOCK_SIZE] = blocks[h / TRANSFORM_BLOCK_SIZE].normal;
+		int i = h % TRANSFORM_BLOCK_SIZE;
+		return Vector4(n[column][i], n[3 + column][i], n[6 + column][i], 0.0f);
+	};
+
+	// Roots: the world matrix is the local one
+	for (size_t block = 0; block < dirty.size(); block++) {
+		uint64_t bits = dirty[block];
+		while (bits != 0) {
+			TransformHandle handle = block * TRANSFORM_BLOCK_SIZE + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if (parents[handle] != INVALID_TRANSFORM) {
+				continue;
+			}
+			InstanceTransform& instance = instances[handle];
+			instance.model = localMatrix(handle);
+			for (int column = 0; column < 3; column++) {
+				instance.normal[column] = localNormalColumn(handle, column);
+			}
+		}
+		changed[block] = dirty[block]; // Overwrites the flags of the last Update
+	}
+
+	// Children, parents first. The inverse transpose of a product is the product of the inverse transposes.
+	for (TransformHandle handle : children) {
+		TransformHandle parent = parents[handle];
+		if (!HasChanged(handle) && !HasChanged(parent)) {
+			continue;
+		}
+		const InstanceTransform& parentInstance = instances[parent];
+		InstanceTransform& instance = instances[handle];
+		instance.model = parentInstance.model * localMatrix(handle);
+		Matrix3 parentNormal(Vector3(parentInstance.normal[0]), Vector3(parentInstance.normal[1]), Vector3(parentInstance.normal[2]));
+		for (int column = 0; column < 3; column++) {
+			instance.normal[column] = Vector4(parentNormal * Vector3(localNormalColumn(handle, column)), 0.0f);
+		}
+		changed[handle / TRANSFORM_BLOCK_SIZE] |= 1ULL << (handle % TRANSFORM_BLOCK_SIZE);
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+}
@@ -0,0 +1,93 @@
+// TransformSystem.h
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include "typedefs.h"
+#include <cstdint>
+#include <vector>
+
+typedef int TransformHandle;
+const TransformHandle INVALID_TRANSFORM = -1;
+
+// Transforms are updated in blocks of this many, one word of the dirty bitsets
+const int TRANSFORM_BLOCK_SIZE = 64;
+
+// What the vertex shader reads per instance (lit.vert locations 3-9)
+struct InstanceTransform
+{
+	Matrix4 model;
+	Vector4 normal[3]; // Columns of transpose(inverse(mat3(model))), w unused
+};
+
+// Position, rotation and scale of every object in structure of arrays form, in blocks of
+// TRANSFORM_BLOCK_SIZE transforms. Setters only flag the transform dirty, Update() then rebuilds
+// the local matrices of the dirty blocks in one branchless loop over the block's arrays
+// (vectorized by the compiler at -O3) and composes the world matrices, parents before children.
+// Model and normal matrices end up next to each other in one contiguous array, ready to be
+// copied into the instance buffer.
+//
+// The local transform is translate * scale * rotate like GameObject always did, so the normal
+// matrix is scale^-1 * rotate and never needs a general inverse. Rotations must be unit quaternions.
+class TransformSystem {
+public:
+	// The system the game objects live in
+	static TransformSystem* Get();
+
+	TransformHandle Create(TransformHandle parent = INVALID_TRANSFORM);
+	void Destroy(TransformHandle handle); // Children become roots
+
+	void SetPosition(TransformHandle handle, const Vector3& position);
+	void SetRotation(TransformHandle handle, const Quaternion& rotation);
+	void SetScale(TransformHandle handle, const Vector3& scale);
+	void SetParent(TransformHandle handle, TransformHandle parent);
+
+	Vector3 GetPosition(TransformHandle handle) const;
+	Quaternion GetRotation(TransformHandle handle) const;
+	Vector3 GetScale(TransformHandle handle) const;
+	TransformHandle GetParent(TransformHandle handle) const { return parents[handle]; }
+
+	// Recomputes everything that changed since the last call
+	void Update();
+	bool IsDirty() const { return anyDirty; }
+
+	// World space, valid after Update()
+	const InstanceTransform& GetInstance(TransformHandle handle) const { return instances[handle]; }
+	const Matrix4& GetWorldMatrix(TransformHandle handle) const { return instances[handle].model; }
+	// True when the world matrix changed in the last Update()
+	bool HasChanged(TransformHandle handle) const { return (changed[handle / TRANSFORM_BLOCK_SIZE] >> (handle % TRANSFORM_BLOCK_SIZE)) & 1; }
+
+	int GetCount() const { return count; }
+
+private:
+	// One array per component. Inputs and outputs of a block are members of the same struct,
+	// so the compiler can see they never overlap.
+	struct TransformBlock
+	{
+		float position[3][TRANSFORM_BLOCK_SIZE];
+		float rotation[4][TRANSFORM_BLOCK_SIZE]; // x, y, z, w
+		float scale[3][TRANSFORM_BLOCK_SIZE];
+		// Local matrices written by updateLocalBlock, row major
+		float affine[12][TRANSFORM_BLOCK_SIZE]; // 3x4, translation in the last column
+		float normal[9][TRANSFORM_BLOCK_SIZE]; // 3x3
+	};
+
+	std::vector<TransformBlock> blocks;
+	std::vector<TransformHandle> parents;
+	std::vector<InstanceTransform> instances;
+	std::vector<uint64_t> dirty; // Local transform changed, one bit per handle
+	std::vector<uint64_t> changed; // World matrix changed in the last Update
+	bool anyDirty = false;
+	bool anyChanged = false; // Some bit of changed is set
+
+	std::vector<TransformHandle> freeHandles;
+	std::vector<TransformHandle> children; // Every handle with a parent, shallower ones first
+	bool hierarchyDirty = false;
+	int count = 0;
+
+	void grow();
+	void markDirty(TransformHandle handle);
+	static void updateLocalBlock(TransformBlock& block);
+	void sortChildren();
+};
+
+#endif
@@ -0,0 +1,51 @@
+// TripleBuffer.h
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free single producer, single consumer handoff of the latest value.
+// The writer fills its private slot and publishes it by swapping it with the shared slot,
+// the reader swaps the shared slot with its own slot when something new was published.
+// Neither side ever waits, the reader always sees a complete value (possibly skipping some).
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer(const T& initial = T())
+	{
+		for (T& buffer : buffers) {
+			buffer = initial;
+		}
+	}
+
+	// Writer thread
+	T& GetWriteBuffer() { return buffers[writeIndex]; }
+	void Publish()
+	{
+		int previous = shared.exchange(writeIndex | NEW_DATA_BIT, std::memory_order_acq_rel);
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	// Reader thread, returns true if a newer value was picked up
+	bool Update()
+	{
+		if ((shared.load(std::memory_order_relaxed) & NEW_DATA_BIT) == 0) {
+			return false;
+		}
+		int previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & INDEX_MASK;
+		return true;
+	}
+	const T& GetReadBuffer() const { return buffers[readIndex]; }
+
+private:
+	static const int INDEX_MASK = 3;
+	static const int NEW_DATA_BIT = 4;
+
+	T buffers[3];
+	int writeIndex = 0;
+	std::atomic<int> shared { 1 };
+	int readIndex = 2;
+};
+
+#endif
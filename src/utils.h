@@ -5,6 +5,8 @@
 #include "GameObject.h"
 #include "ShaderProgram.h"
 #include "Mesh.h"
+#include "ObjParser.h"
+#include "MeshFile.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -13,11 +15,27 @@
 #include <iomanip>
 #include <cassert>
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
 
 Mesh* ParseObjFile(const char* path, bool useTriangles, bool withNormals = false);
+// Loads the .mesh file next to an OBJ file if it is up to date, otherwise parses the OBJ file
+Mesh* LoadMesh(const char* objPath);
 void CheckGLError(const char* file, int line);
 Quaternion utilsLookAt(Vector3 position, Vector3 target, Vector3 up);
 Quaternion utilsFromAxisAngle(Vector3 axis, double angle);
 Vector3 utilsRotatePointAroundAxis(Vector3 point, Vector3 axis, double angle);
+// Quotes and backslashes escaped, for the names written into the JSON reports
+std::string EscapeJson(const std::string& text);
+
+// Wall time of one call, used by LoadMesh, the benchmarks and the tools
+template <typename F>
+double TimeMilliseconds(F&& function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+// LightBudget.cpp
+// Chooses the light count of every environment map: compares the diffuse and glossy response of
+// 1, 2, 4 ... lights with the environment's own and stores the smallest count within the
+// tolerance next to the map (map.hdr.lights), where main picks it up.
+//
+// Usage: ./tools/lightBudget [--tolerance 0.2] [--relaxation 4] [file.hdr ...]
+//        (defaults to every HDR file in hdr_equirectengular_maps/)
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <vector>
+
+#include "LightBudget.h"
+
+int main(int argc, char** argv)
+{
+	float tolerance = LIGHT_BUDGET_TOLERANCE;
+	int relaxationIterations = IBL_RELAXATION_ITERATIONS;
+	std::vector<std::filesystem::path> hdrPaths;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			tolerance = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--relaxation") == 0 && i + 1 < argc) {
+			relaxationIterations = atoi(argv[++i]);
+		}
+		else {
+			hdrPaths.push_back(argv[i]);
+		}
+	}
+	if (tolerance <= 0.0f) {
+		std::cerr << "--tolerance needs a positive relative error" << std::endl;
+		return 1;
+	}
+	if (hdrPaths.empty()) {
+		for (const auto& entry : std::filesystem::directory_iterator("hdr_equirectengular_maps")) {
+			if (entry.path().extension() == ".hdr") {
+				hdrPaths.push_back(entry.path());
+			}
+		}
+	}
+
+	int failures = 0;
+	for (const std::filesystem::path& hdrPath : hdrPaths) {
+		Texture texture(hdrPath.string(), true, false);
+		if (texture.getWidth() == 0 || texture.getHeight() == 0) {
+			std::cerr << "Failed to load " << hdrPath.string() << std::endl;
+			failures++;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		LightResponse reference;
+		ComputeEnvironmentResponse(&texture, LIGHT_BUDGET_GRID_SIZE, LIGHT_BUDGET_BLOCK_SIZE, reference);
+		auto referenceEnd = std::chrono::steady_clock::now();
+		IBLSampler sampler(&texture, 1, relaxationIterations);
+		std::vector<LightBudgetEntry> entries;
+		LightBudget budget = ChooseLightBudget(sampler, reference, tolerance, &entries);
+		auto end = std::chrono::steady_clock::now();
+
+		std::cout << hdrPath.string() << " (" << texture.getWidth() << "x" << texture.getHeight() << "), ground truth "
+			<< std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(referenceEnd - start).count()
+			<< " ms, light counts " << std::chrono::duration<double, std::milli>(end - referenceEnd).count() << " ms" << std::endl;
+		std::cout << "  lights   diffuse    glossy" << std::endl;
+		std::cout << std::setprecision(4);
+		for (const LightBudgetEntry& entry : entries) {
+			std::cout << "  " << std::setw(6) << entry.lightCount << std::setw(10) << entry.diffuseError
+				<< std::setw(10) << entry.glossyError << std::endl;
+		}
+		std::cout << "  " << budget.lightCount << " lights"
+			<< (budget.withinTolerance ? " within " : ", none within ") << tolerance << std::endl;
+
+		std::string budgetPath = LightBudgetPath(hdrPath.string());
+		if (!SaveLightBudget(budgetPath, budget)) {
+			failures++;
+			continue;
+		}
+		std::cout << "  written to " << budgetPath << std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+// MeshConverter.cpp
+// Converts OBJ files into .mesh files next to them and compares the CPU cost of loading both.
+//
+// Usage: ./tools/meshConverter [file.obj ...]   (defaults to every OBJ file in obj/)
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <vector>
+
+#include "MeshFile.h"
+#include "ObjParser.h"
+#include "utils.h"
+
+int main(int argc, char** argv)
+{
+	std::vector<std::filesystem::path> objPaths;
+	for (int i = 1; i < argc; i++) {
+		objPaths.push_back(argv[i]);
+	}
+	if (objPaths.empty()) {
+		for (const auto& entry : std::filesystem::directory_iterator("obj")) {
+			if (entry.path().extension() == ".obj") {
+				objPaths.push_back(entry.path());
+			}
+		}
+	}
+
+	int failures = 0;
+	for (const std::filesystem::path& objPath : objPaths) {
+		std::filesystem::path meshPath = std::filesystem::path(objPath).replace_extension(".mesh");
+		if (!ConvertObjToMeshFile(objPath.string().c_str(), meshPath.string().c_str())) {
+			std::cerr << "Failed to convert " << objPath.string() << std::endl;
+			failures++;
+			continue;
+		}
+
+		// What the two load paths do before touching GL: parse + process vs map + validate + copy out
+		double objMilliseconds = TimeMilliseconds([&]() {
+			ObjData data;
+			LoadObjData(objPath.string().c_str(), data, true, true);
+			ProcessedMesh processed;
+			ProcessMesh(data.vertices, data.normals, data.textures, data.triangles, processed);
+		});
+		bool valid = false;
+		double meshMilliseconds = TimeMilliseconds([&]() {
+			MappedFile file;
+			MeshFileView view;
+			valid = OpenMeshFile(meshPath.string().c_str(), file, view);
+			if (valid) {
+				std::vector<char> staging(view.header->vertexSize + view.header->indexSize);
+				memcpy(staging.data(), view.vertices, view.header->vertexSize);
+				memcpy(staging.data() + view.header->vertexSize, view.indices, view.header->indexSize);
+			}
+		});
+		if (!valid) {
+			failures++;
+			continue;
+		}
+
+		std::cout << std::left << std::setw(20) << objPath.string() << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(10) << std::filesystem::file_size(objPath) / 1024.0 << " KB ->"
+			<< std::setw(10) << std::filesystem::file_size(meshPath) / 1024.0 << " KB"
+			<< std::setprecision(3)
+			<< "   obj " << std::setw(9) << objMilliseconds << " ms"
+			<< "   mesh " << std::setw(9) << meshMilliseconds << " ms" << std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}